@@ -0,0 +1,115 @@
+#include "mpi_advance.h"
+#include <mpi.h>
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <assert.h>
+#include <vector>
+
+// Times setup (init + free) of the persistent neighbor alltoallv on a
+// banded halo : each rank exchanges 'halo' values with the 'band'
+// ranks before and after it
+// Usage : neighbor_setup [halo] [band]
+int main(int argc, char* argv[])
+{
+    MPI_Init(&argc, &argv);
+
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    int halo = 100000;
+    int band = 4;
+    if (argc > 1) halo = atoi(argv[1]);
+    if (argc > 2) band = atoi(argv[2]);
+    int n_iter = 10;
+    double t0, tfinal;
+
+    std::vector<int> procs;
+    for (int p = rank - band; p <= rank + band; p++)
+        if (p != rank && p >= 0 && p < num_procs)
+            procs.push_back(p);
+    int n_msgs = procs.size();
+
+    // Rank p sends the values it owns, global indices p*halo to (p+1)*halo
+    std::vector<int> counts(n_msgs, halo);
+    std::vector<int> displs(n_msgs+1);
+    std::vector<long> global_send_idx((long)n_msgs*halo);
+    std::vector<long> global_recv_idx((long)n_msgs*halo);
+    std::vector<double> send_vals((long)n_msgs*halo);
+    std::vector<double> recv_vals((long)n_msgs*halo);
+    displs[0] = 0;
+    for (int i = 0; i < n_msgs; i++)
+    {
+        displs[i+1] = displs[i] + halo;
+        for (int j = 0; j < halo; j++)
+        {
+            global_send_idx[(long)i*halo + j] = (long)rank*halo + j;
+            global_recv_idx[(long)i*halo + j] = (long)procs[i]*halo + j;
+            send_vals[(long)i*halo + j] = rank*halo + j;
+        }
+    }
+
+    MPIX_Comm* neighbor_comm;
+    MPIX_Request* neighbor_request;
+    MPI_Status status;
+    MPIX_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            n_msgs, procs.data(), MPI_UNWEIGHTED,
+            n_msgs, procs.data(), MPI_UNWEIGHTED,
+            MPI_INFO_NULL, 0, &neighbor_comm);
+
+    if (rank == 0) printf("Halo %d, Band %d\n", halo, band);
+
+    // Time Standard Setup
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    for (int k = 0; k < n_iter; k++)
+    {
+        MPIX_Neighbor_alltoallv_init(send_vals.data(), counts.data(), displs.data(),
+                MPI_DOUBLE, recv_vals.data(), counts.data(), displs.data(), MPI_DOUBLE,
+                neighbor_comm, MPI_INFO_NULL, &neighbor_request);
+        MPIX_Request_free(neighbor_request);
+    }
+    tfinal = (MPI_Wtime() - t0) / n_iter;
+    MPI_Reduce(&tfinal, &t0, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) printf("Standard Setup Time %e\n", t0);
+
+    // Time Locality-Aware Setup
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    for (int k = 0; k < n_iter; k++)
+    {
+        MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), counts.data(), 
+                displs.data(), global_send_idx.data(), MPI_DOUBLE, recv_vals.data(), 
+                counts.data(), displs.data(), global_recv_idx.data(), MPI_DOUBLE,
+                neighbor_comm, MPI_INFO_NULL, &neighbor_request);
+        MPIX_Request_free(neighbor_request);
+    }
+    tfinal = (MPI_Wtime() - t0) / n_iter;
+    MPI_Reduce(&tfinal, &t0, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) printf("Locality-Aware Setup Time %e\n", t0);
+
+    // Check the exchange once
+    MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), counts.data(), 
+            displs.data(), global_send_idx.data(), MPI_DOUBLE, recv_vals.data(), 
+            counts.data(), displs.data(), global_recv_idx.data(), MPI_DOUBLE,
+            neighbor_comm, MPI_INFO_NULL, &neighbor_request);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (long j = 0; j < (long)n_msgs*halo; j++)
+    {
+        if (fabs(recv_vals[j] - global_recv_idx[j]) > 1e-10)
+        {
+            fprintf(stderr, "Rank %d, idx %ld, recv %e, expected %ld\n",
+                    rank, j, recv_vals[j], global_recv_idx[j]);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+            return 1;
+        }
+    }
+
+    MPIX_Comm_free(neighbor_comm);
+
+    MPI_Finalize();
+    return 0;
+}
@@ -77,7 +77,7 @@ int allgather_bruck(const void* sendbuf,
         size = stride*recvcount;
 
         MPI_Isend(recv_buffer, size, recvtype, send_proc, tag, comm, &(requests[0]));
-        MPI_Irecv(recv_buffer + size*recv_size, size, recvtype, recv_proc, tag, comm, &(requests[1]));
+        MPI_Irecv(recv_buffer + (MPI_Aint)size*recv_size, size, recvtype, recv_proc, tag, comm, &(requests[1]));
         MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
 
         stride *= 2;
@@ -107,7 +107,7 @@ int allgather_p2p(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
 
     for (int i = 0; i < num_procs; i++)
     {
-        MPI_Irecv(&(recv_buffer[i*recvcount*recv_size]), 
+        MPI_Irecv(&(recv_buffer[(MPI_Aint)i*recvcount*recv_size]), 
                 recvcount, recvtype, i, tag, comm, &(requests[i]));
         MPI_Isend(sendbuf, sendcount, sendtype, i, tag, comm, &(requests[num_procs+i]));
     }
@@ -141,7 +141,7 @@ int allgather_ring(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
     int pos = rank*recvcount;
     for (int i = 0; i < recvcount*recv_size; i++)
     {
-        recv_buffer[pos*recv_size+i] = send_buffer[i];
+        recv_buffer[(MPI_Aint)pos*recv_size+i] = send_buffer[i];
     }
     int next_pos = pos+recvcount;
     if (next_pos >= num_procs*recvcount) next_pos = 0;
@@ -151,13 +151,13 @@ int allgather_ring(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
     {
         if (rank % 2)
         {
-            MPI_Send(&(recv_buffer[pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
-            MPI_Recv(&(recv_buffer[next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
+            MPI_Send(&(recv_buffer[(MPI_Aint)pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
+            MPI_Recv(&(recv_buffer[(MPI_Aint)next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
         }
         else
         {
-            MPI_Recv(&(recv_buffer[next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
-            MPI_Send(&(recv_buffer[pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
+            MPI_Recv(&(recv_buffer[(MPI_Aint)next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
+            MPI_Send(&(recv_buffer[(MPI_Aint)pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
         }
         pos = next_pos;
         next_pos += recvcount;
@@ -219,7 +219,7 @@ int allgather_loc_p2p(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
     // Put at beginning of recvbuf so other data is contiguous
     pos = local_node * PPN * recvcount;
     PMPI_Allgather(sendbuf, sendcount, sendtype,
-            &(recv_buffer[pos*recv_size]), recvcount, recvtype, comm->local_comm);
+            &(recv_buffer[(MPI_Aint)pos*recv_size]), recvcount, recvtype, comm->local_comm);
 
     // Exchange Inter-Node Messages
     // Local rank exchanges data with nodes in list
@@ -230,8 +230,8 @@ int allgather_loc_p2p(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
         proc = node*PPN+local_idx;
         int node_pos = node * PPN * recvcount;
         //printf("Rank %d exchanging with %d\n", rank, proc);
-        MPI_Isend(&(recv_buffer[pos*recv_size]), recvcount*PPN, recvtype, proc, tag, comm->global_comm, &(nonlocal_requests[node-start])); 
-        MPI_Irecv(&(recv_buffer[node_pos*recv_size]), recvcount*PPN, recvtype, proc, tag, comm->global_comm, &(nonlocal_requests[num_msgs+node-start]));
+        MPI_Isend(&(recv_buffer[(MPI_Aint)pos*recv_size]), recvcount*PPN, recvtype, proc, tag, comm->global_comm, &(nonlocal_requests[node-start])); 
+        MPI_Irecv(&(recv_buffer[(MPI_Aint)node_pos*recv_size]), recvcount*PPN, recvtype, proc, tag, comm->global_comm, &(nonlocal_requests[num_msgs+node-start]));
     }
     MPI_Waitall(2*num_msgs, nonlocal_requests, MPI_STATUSES_IGNORE);
 
@@ -308,12 +308,12 @@ int allgather_loc_bruck(const void *sendbuf, int sendcount, MPI_Datatype sendtyp
         if (local_rank)
         {
             MPI_Isend(recv_buffer, size, sendtype, send_proc, tag, comm->global_comm, &(requests[0]));
-            MPI_Irecv(&(recv_buffer[recv_pos*recv_size]), size, sendtype, recv_proc, tag, comm->global_comm, &(requests[1]));
+            MPI_Irecv(&(recv_buffer[(MPI_Aint)recv_pos*recv_size]), size, sendtype, recv_proc, tag, comm->global_comm, &(requests[1]));
             MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
         }
 
 
-        allgather_bruck(&(recv_buffer[recv_pos*recv_size]), size, recvtype, recvbuf, size, recvtype, comm->local_comm);
+        allgather_bruck(&(recv_buffer[(MPI_Aint)recv_pos*recv_size]), size, recvtype, recvbuf, size, recvtype, comm->local_comm);
 
         stride *= PPN;
     }
@@ -350,7 +350,7 @@ int allgather_ring_overlap(const void *sendbuf, int sendcount, MPI_Datatype send
     int pos = rank*recvcount;
     for (int i = 0; i < recvcount*recv_size; i++)
     {
-        recv_buffer[pos*recv_size+i] = send_buffer[i];
+        recv_buffer[(MPI_Aint)pos*recv_size+i] = send_buffer[i];
     }
     int next_pos = pos+recvcount;
     if (next_pos >= num_procs*recvcount) next_pos = 0;
@@ -361,13 +361,13 @@ int allgather_ring_overlap(const void *sendbuf, int sendcount, MPI_Datatype send
     {
         if (rank % 2)
         {
-            MPI_Send(&(recv_buffer[pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
-            MPI_Recv(&(recv_buffer[next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
+            MPI_Send(&(recv_buffer[(MPI_Aint)pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
+            MPI_Recv(&(recv_buffer[(MPI_Aint)next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
         }
         else
         {
-            MPI_Recv(&(recv_buffer[next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
-            MPI_Send(&(recv_buffer[pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
+            MPI_Recv(&(recv_buffer[(MPI_Aint)next_pos*recv_size]), recvcount, recvtype, recv_proc, tag, comm, MPI_STATUS_IGNORE);
+            MPI_Send(&(recv_buffer[(MPI_Aint)pos*recv_size]), sendcount, sendtype, send_proc, tag, comm);
         }
         pos = next_pos;
         next_pos += recvcount;
@@ -439,7 +439,7 @@ int allgather_loc_ring(const void *sendbuf, int sendcount, MPI_Datatype sendtype
 
         // Allgather locally - with ring
         int finished = allgather_ring_overlap(sendbuf_tmp, recvcount, recvtype, 
-                &(recv_buffer[node_pos*recv_size]), recvcount, recvtype, comm->local_comm, requests);
+                &(recv_buffer[(MPI_Aint)node_pos*recv_size]), recvcount, recvtype, comm->local_comm, requests);
 
         if (!finished) MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
 
@@ -452,7 +452,7 @@ int allgather_loc_ring(const void *sendbuf, int sendcount, MPI_Datatype sendtype
         sendbuf_tmp = recvbuf_tmp;
         recvbuf_tmp = tmp_ptr;
     }
-    allgather_ring(sendbuf_tmp, recvcount, recvtype, &(recv_buffer[node_pos*recv_size]), recvcount, recvtype, comm->local_comm);    
+    allgather_ring(sendbuf_tmp, recvcount, recvtype, &(recv_buffer[(MPI_Aint)node_pos*recv_size]), recvcount, recvtype, comm->local_comm);    
 
     free(tmpbuf0);
     free(tmpbuf1);
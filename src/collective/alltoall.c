@@ -69,7 +69,7 @@ int alltoall_pairwise(const void* sendbuf,
 
     int tag = 102944;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     MPI_Status status;
 
     int send_size, recv_size;
@@ -86,13 +86,15 @@ int alltoall_pairwise(const void* sendbuf,
         recv_proc = rank - i;
         if (recv_proc < 0)
             recv_proc += num_procs;
-        send_pos = send_proc * sendcount * send_size;
-        recv_pos = recv_proc * recvcount * recv_size;
+        send_pos = (MPI_Aint)send_proc * sendcount * send_size;
+        recv_pos = (MPI_Aint)recv_proc * recvcount * recv_size;
 
         MPI_Sendrecv(sendbuf + send_pos, sendcount, sendtype, send_proc, tag,
                 recvbuf + recv_pos, recvcount, recvtype, recv_proc, tag,
                 comm, &status);
     }
+
+    return 0;
 }
 
 int alltoall_bruck(const void* sendbuf,
@@ -225,10 +227,10 @@ int alltoall_pairwise_loc(const void* sendbuf,
 
     int tag = 102913;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     int send_node, recv_node;
     MPI_Status status;
-    char* tmpbuf = (char*)malloc(num_procs*recv_bytes);
+    char* tmpbuf = (char*)malloc((size_t)num_procs*recv_bytes);
 
     /************************************************
      * Step 1 : Send aggregated data to node
@@ -242,8 +244,8 @@ int alltoall_pairwise_loc(const void* sendbuf,
         if (recv_node < 0)
             recv_node += num_nodes;
 
-        send_pos = send_node * send_bytes_node;
-        recv_pos = recv_node * recv_bytes_node;
+        send_pos = (MPI_Aint)send_node * send_bytes_node;
+        recv_pos = (MPI_Aint)recv_node * recv_bytes_node;
 
         MPI_Sendrecv(sendbuf + send_pos, sendcount_node, sendtype, 
                 send_node*PPN + local_rank, tag,
@@ -257,8 +259,8 @@ int alltoall_pairwise_loc(const void* sendbuf,
      ************************************************/
     for (int i = 0; i < num_nodes; i++)
         for (int j = 0; j < PPN; j++)
-            memcpy(recvbuf + ((j*num_nodes+i)*recv_bytes),
-                    tmpbuf + ((i*PPN+j)*recv_bytes),
+            memcpy(recvbuf + ((MPI_Aint)(j*num_nodes+i)*recv_bytes),
+                    tmpbuf + ((MPI_Aint)(i*PPN+j)*recv_bytes),
                     recv_bytes);
 
     for (int i = 0; i < PPN; i++)
@@ -270,8 +272,8 @@ int alltoall_pairwise_loc(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += PPN;
 
-        send_pos = send_proc * recv_bytes * num_nodes;
-        recv_pos = recv_proc * recv_bytes * num_nodes;
+        send_pos = (MPI_Aint)send_proc * recv_bytes * num_nodes;
+        recv_pos = (MPI_Aint)recv_proc * recv_bytes * num_nodes;
 
         MPI_Sendrecv(recvbuf + send_pos, recvcount * num_nodes, recvtype,
                 send_proc, tag,
@@ -283,8 +285,8 @@ int alltoall_pairwise_loc(const void* sendbuf,
 
     for (int i = 0; i < num_nodes; i++)
         for (int j = 0; j < PPN; j++)
-            memcpy(recvbuf + ((i*PPN+j)*recv_bytes),
-                    tmpbuf + ((j*num_nodes+i)*recv_bytes),
+            memcpy(recvbuf + ((MPI_Aint)(i*PPN+j)*recv_bytes),
+                    tmpbuf + ((MPI_Aint)(j*num_nodes+i)*recv_bytes),
                     recv_bytes);
 
     free(tmpbuf);
@@ -292,3 +294,86 @@ int alltoall_pairwise_loc(const void* sendbuf,
     return 0;
 }
 
+
+
+// Multi-Dimensional (Virtual Grid) Alltoall
+// Generalizes the 2-step aggregation above (group_comm, then local_comm)
+// to any number of dimensions, set with MPIX_Comm_grid_init
+// (defaults to nodes x PPN).  Each step is a pairwise alltoall along
+// one dimension, so a rank sends sum(dims) messages rather than
+// num_nodes, at the cost of forwarding all data once per dimension.
+int alltoall_grid(const void* sendbuf,
+        const int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* mpi_comm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(mpi_comm->global_comm, &rank);
+    MPI_Comm_size(mpi_comm->global_comm, &num_procs);
+
+    if (mpi_comm->grid_ndims == 0)
+    {
+        int dims[2] = {0, 0};
+        if (MPIX_Comm_grid_init(mpi_comm, 2, dims) != MPI_SUCCESS)
+            return alltoall_pairwise(sendbuf, sendcount, sendtype,
+                    recvbuf, recvcount, recvtype, mpi_comm->global_comm);
+    }
+
+    char* recv_buffer = (char*)recvbuf;
+
+    int recv_size;
+    MPI_Type_size(recvtype, &recv_size);
+    MPI_Aint block_size = (MPI_Aint)recvcount*recv_size;
+
+    if (sendbuf != recvbuf)
+        memcpy(recvbuf, sendbuf, num_procs*block_size);
+
+    char* packbuf = (char*)malloc(num_procs*block_size);
+    char* tmpbuf = (char*)malloc(num_procs*block_size);
+
+    // Block at position idx holds (source coordinates for dimensions
+    // already routed, destination coordinates for the remaining ones)
+    int dim, n_blocks;
+    MPI_Aint idx, pos;
+    int stride = num_procs;
+    for (int k = 0; k < mpi_comm->grid_ndims; k++)
+    {
+        dim = mpi_comm->grid_dims[k];
+        stride /= dim;
+        n_blocks = num_procs / dim;
+
+        // Pack blocks with coordinate k == t contiguously for rank t
+        for (int t = 0; t < dim; t++)
+            for (int j = 0; j < n_blocks; j++)
+            {
+                idx = (j / stride) * stride * dim + t * stride + (j % stride);
+                pos = t*n_blocks + j;
+                memcpy(packbuf + pos*block_size,
+                        recv_buffer + idx*block_size,
+                        block_size);
+            }
+
+        alltoall_pairwise(packbuf, recvcount*n_blocks, recvtype,
+                tmpbuf, recvcount*n_blocks, recvtype,
+                mpi_comm->grid_comms[k]);
+
+        // Data from rank t now has coordinate k == t
+        for (int t = 0; t < dim; t++)
+            for (int j = 0; j < n_blocks; j++)
+            {
+                idx = (j / stride) * stride * dim + t * stride + (j % stride);
+                pos = t*n_blocks + j;
+                memcpy(recv_buffer + idx*block_size,
+                        tmpbuf + pos*block_size,
+                        block_size);
+            }
+    }
+
+    free(packbuf);
+    free(tmpbuf);
+
+    return 0;
+}
@@ -65,6 +65,27 @@ int MPIX_Alltoallv(const void* sendbuf,
         mpi_comm->global_comm);
 }
 
+int MPIX_Alltoallv_c(const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* mpi_comm)
+{
+    return alltoallv_nonblocking_c(sendbuf,
+        sendcounts,
+        sdispls,
+        sendtype,
+        recvbuf,
+        recvcounts,
+        rdispls,
+        recvtype,
+        mpi_comm->global_comm);
+}
+
 
 int alltoallv_pairwise(const void* sendbuf,
         const int sendcounts[],
@@ -82,7 +103,7 @@ int alltoallv_pairwise(const void* sendbuf,
 
     int tag = 103044;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     MPI_Status status;
 
     int send_size, recv_size;
@@ -90,9 +111,9 @@ int alltoallv_pairwise(const void* sendbuf,
     MPI_Type_size(recvtype, &recv_size);
 
     memcpy(
-        recvbuf + (rdispls[rank] * recv_size),
-        sendbuf + (sdispls[rank] * send_size), 
-        sendcounts[rank] * send_size);        
+        recvbuf + ((MPI_Aint)rdispls[rank] * recv_size),
+        sendbuf + ((MPI_Aint)sdispls[rank] * send_size), 
+        (size_t)sendcounts[rank] * send_size);        
 
     // Send to rank + i
     // Recv from rank - i
@@ -105,8 +126,8 @@ int alltoallv_pairwise(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += num_procs;
 
-        send_pos = sdispls[send_proc] * send_size;
-        recv_pos = rdispls[recv_proc] * recv_size;
+        send_pos = (MPI_Aint)sdispls[send_proc] * send_size;
+        recv_pos = (MPI_Aint)rdispls[recv_proc] * recv_size;
 
         MPI_Sendrecv(sendbuf + send_pos, sendcounts[send_proc], sendtype, send_proc, tag,
                 recvbuf + recv_pos, recvcounts[recv_proc], recvtype, recv_proc, tag,
@@ -132,7 +153,7 @@ int alltoallv_nonblocking(const void* sendbuf,
 
     int tag = 103044;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     MPI_Status status;
 
     int send_size, recv_size;
@@ -142,9 +163,9 @@ int alltoallv_nonblocking(const void* sendbuf,
     MPI_Request* requests = (MPI_Request*)malloc(2*(num_procs-1)*sizeof(MPI_Request));
 
     memcpy(
-        recvbuf + (rdispls[rank] * recv_size),
-        sendbuf + (sdispls[rank] * send_size), 
-        sendcounts[rank] * send_size);        
+        recvbuf + ((MPI_Aint)rdispls[rank] * recv_size),
+        sendbuf + ((MPI_Aint)sdispls[rank] * send_size), 
+        (size_t)sendcounts[rank] * send_size);        
 
     // For each step i
     // exchange among procs stride (i+1) apart
@@ -157,8 +178,8 @@ int alltoallv_nonblocking(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += num_procs;
 
-        send_pos = sdispls[send_proc] * send_size;
-        recv_pos = rdispls[recv_proc] * recv_size;
+        send_pos = (MPI_Aint)sdispls[send_proc] * send_size;
+        recv_pos = (MPI_Aint)rdispls[recv_proc] * recv_size;
 
         MPI_Isend(sendbuf + send_pos, sendcounts[send_proc], sendtype, send_proc, tag,
                 comm, &(requests[i-1]));
@@ -173,6 +194,79 @@ int alltoallv_nonblocking(const void* sendbuf,
     return 0;
 }
 
+// Large-count version of alltoallv_nonblocking
+// Messages past INT_MAX elements are sent as a single derived datatype
+int alltoallv_nonblocking_c(const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPI_Comm comm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    int tag = 103044;
+    int send_proc, recv_proc;
+    MPI_Aint send_pos, recv_pos;
+
+    MPI_Aint lb, send_extent, recv_extent;
+    MPI_Type_get_extent(sendtype, &lb, &send_extent);
+    MPI_Type_get_extent(recvtype, &lb, &recv_extent);
+
+    int send_size;
+    MPI_Type_size(sendtype, &send_size);
+
+    int count;
+    MPI_Datatype type;
+    int n_types = 0;
+    MPI_Datatype* types = (MPI_Datatype*)malloc(2*num_procs*sizeof(MPI_Datatype));
+    MPI_Request* requests = (MPI_Request*)malloc(2*(num_procs-1)*sizeof(MPI_Request));
+
+    memcpy(
+        recvbuf + (rdispls[rank] * recv_extent),
+        sendbuf + (sdispls[rank] * send_extent), 
+        (size_t)sendcounts[rank] * send_size);        
+
+    // For each step i
+    // exchange among procs stride (i+1) apart
+    for (int i = 1; i < num_procs; i++)
+    {
+        send_proc = rank + i;
+        if (send_proc >= num_procs)
+            send_proc -= num_procs;
+        recv_proc = rank - i;
+        if (recv_proc < 0)
+            recv_proc += num_procs;
+
+        send_pos = sdispls[send_proc] * send_extent;
+        recv_pos = rdispls[recv_proc] * recv_extent;
+
+        if (large_count_type(sendcounts[send_proc], sendtype, &count, &type))
+            types[n_types++] = type;
+        MPI_Isend(sendbuf + send_pos, count, type, send_proc, tag,
+                comm, &(requests[i-1]));
+
+        if (large_count_type(recvcounts[recv_proc], recvtype, &count, &type))
+            types[n_types++] = type;
+        MPI_Irecv(recvbuf + recv_pos, count, type, recv_proc, tag,
+                comm, &(requests[num_procs+i-2]));
+    }
+
+    MPI_Waitall(2*(num_procs-1), requests, MPI_STATUSES_IGNORE);
+
+    for (int i = 0; i < n_types; i++)
+        MPI_Type_free(&(types[i]));
+    free(types);
+    free(requests);
+
+    return 0;
+}
+
 int alltoallv_pairwise_nonblocking(const void* sendbuf,
         const int sendcounts[],
         const int sdispls[],
@@ -193,7 +287,7 @@ int alltoallv_pairwise_nonblocking(const void* sendbuf,
     int tag = 103044;
     int ctr;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     MPI_Status status;
 
     int send_size, recv_size;
@@ -203,9 +297,9 @@ int alltoallv_pairwise_nonblocking(const void* sendbuf,
     MPI_Request* requests = (MPI_Request*)malloc(2*nb_stride*sizeof(MPI_Request));
 
     memcpy(
-        recvbuf + (rdispls[rank] * recv_size),
-        sendbuf + (sdispls[rank] * send_size), 
-        sendcounts[rank] * send_size);        
+        recvbuf + ((MPI_Aint)rdispls[rank] * recv_size),
+        sendbuf + ((MPI_Aint)sdispls[rank] * send_size), 
+        (size_t)sendcounts[rank] * send_size);        
 
     // For each step i
     // exchange among procs stride (i+1) apart
@@ -219,8 +313,8 @@ int alltoallv_pairwise_nonblocking(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += num_procs;
 
-        send_pos = sdispls[send_proc] * send_size;
-        recv_pos = rdispls[recv_proc] * recv_size;
+        send_pos = (MPI_Aint)sdispls[send_proc] * send_size;
+        recv_pos = (MPI_Aint)rdispls[recv_proc] * recv_size;
 
         MPI_Isend(sendbuf + send_pos, sendcounts[send_proc], sendtype, send_proc, tag,
                 comm, &(requests[ctr++]));
@@ -262,7 +356,7 @@ int alltoallv_waitany(const void* sendbuf,
     int tag = 103044;
     int ctr;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     MPI_Status status;
 
     int send_size, recv_size;
@@ -272,9 +366,9 @@ int alltoallv_waitany(const void* sendbuf,
     MPI_Request* requests = (MPI_Request*)malloc(2*nb_stride*sizeof(MPI_Request));
 
     memcpy(
-        recvbuf + (rdispls[rank] * recv_size),
-        sendbuf + (sdispls[rank] * send_size), 
-        sendcounts[rank] * send_size);        
+        recvbuf + ((MPI_Aint)rdispls[rank] * recv_size),
+        sendbuf + ((MPI_Aint)sdispls[rank] * send_size), 
+        (size_t)sendcounts[rank] * send_size);        
 
     // For each step i
     // exchange among procs stride (i+1) apart
@@ -288,8 +382,8 @@ int alltoallv_waitany(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += num_procs;
 
-        send_pos = sdispls[send_proc] * send_size;
-        recv_pos = rdispls[recv_proc] * recv_size;
+        send_pos = (MPI_Aint)sdispls[send_proc] * send_size;
+        recv_pos = (MPI_Aint)rdispls[recv_proc] * recv_size;
 
         MPI_Isend(sendbuf + send_pos, sendcounts[send_proc], sendtype, send_proc, tag,
                 comm, &(requests[ctr++]));
@@ -322,7 +416,7 @@ int alltoallv_waitany(const void* sendbuf,
             send_proc = rank + send_idx;
             if (send_proc >= num_procs)
                 send_proc -= num_procs;
-            send_pos = sdispls[send_proc] * send_size;
+            send_pos = (MPI_Aint)sdispls[send_proc] * send_size;
             MPI_Isend(sendbuf + send_pos, sendcounts[send_proc], sendtype, send_proc, tag,
                     comm, &(requests[idx]));
             send_idx++;
@@ -332,7 +426,7 @@ int alltoallv_waitany(const void* sendbuf,
             recv_proc = rank - recv_idx;
             if (recv_proc < 0)
                 recv_proc += num_procs;
-            recv_pos = rdispls[recv_proc] * recv_size;
+            recv_pos = (MPI_Aint)rdispls[recv_proc] * recv_size;
 
             MPI_Irecv(recvbuf + recv_pos, recvcounts[recv_proc], recvtype, recv_proc, tag,
                     comm, &(requests[idx]));
@@ -384,7 +478,7 @@ int alltoallv_pairwise_loc(const void* sendbuf,
 
     int tag = 102913;
     int send_proc, recv_proc;
-    int send_pos, recv_pos;
+    MPI_Aint send_pos, recv_pos;
     int send_node, recv_node;
     MPI_Status status;
 
@@ -419,8 +513,8 @@ int alltoallv_pairwise_loc(const void* sendbuf,
     int maxrecvcount = final_recvcount;
     if (global_recvcount > maxrecvcount)
         maxrecvcount = global_recvcount;
-    char* tmpbuf = (char*)malloc(maxrecvcount*rbytes);
-    char* contigbuf = (char*)malloc(maxrecvcount*rbytes);
+    char* tmpbuf = (char*)malloc((size_t)maxrecvcount*rbytes);
+    char* contigbuf = (char*)malloc((size_t)maxrecvcount*rbytes);
 
     // Send to node + i
     // Recv from node - i
@@ -484,9 +578,9 @@ int alltoallv_pairwise_loc(const void* sendbuf,
         for (int j = 0; j < PPN; j++)
         {
             recvcount = global_recvcounts[i*PPN+j];
-            memcpy(recvbuf + (ppn_displs[j] + ppn_ctr[j])*rbytes,
-                    tmpbuf + ctr*rbytes,
-                    recvcount*rbytes);
+            memcpy(recvbuf + (MPI_Aint)(ppn_displs[j] + ppn_ctr[j])*rbytes,
+                    tmpbuf + (MPI_Aint)ctr*rbytes,
+                    (size_t)recvcount*rbytes);
             ctr += recvcount;
             ppn_ctr[j] += recvcount;
         }
@@ -503,14 +597,14 @@ int alltoallv_pairwise_loc(const void* sendbuf,
         if (recv_proc < 0)
             recv_proc += PPN;
 
-        send_pos = ppn_displs[send_proc] * rbytes;
+        send_pos = (MPI_Aint)ppn_displs[send_proc] * rbytes;
         recvcount = 0;
         for (int j = 0; j < num_nodes; j++)
             recvcount += recvcounts[j*PPN+i];
 
         MPI_Sendrecv(recvbuf + send_pos, ppn_ctr[send_proc], recvtype,
                 send_proc, tag,
-                tmpbuf + ctr*rbytes, recvcount, recvtype,
+                tmpbuf + (MPI_Aint)ctr*rbytes, recvcount, recvtype,
                 recv_proc, tag,
                 mpi_comm->local_comm, &status);
 
@@ -523,9 +617,9 @@ int alltoallv_pairwise_loc(const void* sendbuf,
     {
         for (int j = 0; j < num_nodes; j++)
         {
-            memcpy(recvbuf + rdispls[j*PPN+i]*rbytes,
-                    tmpbuf + ppn_ctr[i]*rbytes,
-                    recvcounts[j*PPN+i]*rbytes);
+            memcpy(recvbuf + (MPI_Aint)rdispls[j*PPN+i]*rbytes,
+                    tmpbuf + (MPI_Aint)ppn_ctr[i]*rbytes,
+                    (size_t)recvcounts[j*PPN+i]*rbytes);
             ppn_ctr[i] += recvcounts[j*PPN+i];
         }
     }
@@ -69,6 +69,16 @@ int alltoallv_pairwise_nonblocking_log2(const void* sendbuf,
         MPI_Datatype recvtype,
         MPI_Comm comm);
 
+int alltoallv_nonblocking_c(const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPI_Comm comm);
+
 
 
 
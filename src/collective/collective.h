@@ -42,6 +42,18 @@ int MPIX_Alltoallv(const void* sendbuf,
         MPI_Datatype recvtype,
         MPIX_Comm* comm);
 
+// Large-count Alltoallv : MPI_Count counts and MPI_Aint
+// displacements (in units of the datatype extent)
+int MPIX_Alltoallv_c(const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm);
+
 int MPI_Allgather(const void* sendbuf,
         int sendcount,
         MPI_Datatype sendtype,
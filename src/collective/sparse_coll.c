@@ -0,0 +1,569 @@
+#include "sparse_coll.h"
+#include <string.h>
+
+#define CRS_NBX_TAG 20491
+#define CRS_RMA_TAG 20492
+#define CRS_LOC_TAG 20493
+
+// Header of a record in the streams of the locality-aware exchange,
+// followed by its data packed with MPI_Pack
+typedef struct _CrsRecord
+{
+    int src;
+    int dest;
+    int bytes; // size of the type signature
+    int packed; // size of the packed data
+} CrsRecord;
+
+// A message received from src, kept until all have arrived
+// (packed, it holds bytes of MPI_Pack data instead of count elements)
+typedef struct _CrsMsg
+{
+    int src;
+    int count;
+    int order; // arrival, so messages from one source keep their order
+    int bytes;
+    char* data;
+} CrsMsg;
+
+typedef struct _CrsMsgs
+{
+    int n;
+    int capacity;
+    CrsMsg* msgs;
+} CrsMsgs;
+
+typedef struct _CrsStream
+{
+    char* data;
+    int size;
+    int capacity;
+} CrsStream;
+
+static void add_crs_msg(CrsMsgs* msgs, int src, int count, int bytes, char* data)
+{
+    if (msgs->n == msgs->capacity)
+    {
+        msgs->capacity = msgs->capacity ? 2*msgs->capacity : 16;
+        msgs->msgs = (CrsMsg*)realloc(msgs->msgs, msgs->capacity*sizeof(CrsMsg));
+    }
+    CrsMsg* msg = &(msgs->msgs[msgs->n]);
+    msg->src = src;
+    msg->count = count;
+    msg->order = msgs->n++;
+    msg->bytes = bytes;
+    msg->data = data;
+}
+
+static int cmp_crs_msg(const void* a, const void* b)
+{
+    const CrsMsg* ma = (const CrsMsg*)a;
+    const CrsMsg* mb = (const CrsMsg*)b;
+    if (ma->src != mb->src)
+        return ma->src - mb->src;
+    return ma->order - mb->order;
+}
+
+// Lay out received messages by source into the returned arrays
+// (unpacking through recvtype if they were packed), freeing them
+static void finish_crs_msgs(CrsMsgs* msgs, int packed, MPI_Datatype recvtype,
+        MPI_Comm comm, int* recv_nnz, int** src_ptr, int** recvcounts_ptr,
+        int** rdispls_ptr, void** recvvals_ptr)
+{
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(recvtype, &lb, &extent);
+
+    int n = msgs->n;
+    qsort(msgs->msgs, n, sizeof(CrsMsg), cmp_crs_msg);
+
+    int* src = (int*)malloc((n+1)*sizeof(int));
+    int* recvcounts = (int*)malloc((n+1)*sizeof(int));
+    int* rdispls = (int*)malloc((n+1)*sizeof(int));
+    int size = 0;
+    for (int i = 0; i < n; i++)
+    {
+        src[i] = msgs->msgs[i].src;
+        recvcounts[i] = msgs->msgs[i].count;
+        rdispls[i] = size;
+        size += recvcounts[i];
+    }
+
+    char* recvvals = (char*)malloc((size_t)size*extent + 1);
+    int position;
+    for (int i = 0; i < n; i++)
+    {
+        CrsMsg* msg = &(msgs->msgs[i]);
+        if (packed)
+        {
+            position = 0;
+            MPI_Unpack(msg->data, msg->bytes, &position,
+                    &(recvvals[(size_t)rdispls[i]*extent]), msg->count, recvtype, comm);
+        }
+        else
+            memcpy(&(recvvals[(size_t)rdispls[i]*extent]), msg->data,
+                    (size_t)msg->count*extent);
+        free(msg->data);
+    }
+    free(msgs->msgs);
+
+    *recv_nnz = n;
+    *src_ptr = src;
+    if (recvcounts_ptr) *recvcounts_ptr = recvcounts;
+    else free(recvcounts);
+    if (rdispls_ptr) *rdispls_ptr = rdispls;
+    else free(rdispls);
+    *recvvals_ptr = recvvals;
+}
+
+// Receive messages with tag on comm (matched probes, sizes in units of
+// type) until the barrier started once all sends have been matched
+// completes (NBX, Hoefler et al.)
+static void nbx_recv(int n_sends, MPI_Request* send_requests, MPI_Datatype type,
+        int tag, MPI_Comm comm, CrsMsgs* msgs)
+{
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+
+    int done = 0;
+    int barrier_active = 0;
+    int flag, count;
+    char* data;
+    MPI_Request barrier;
+    MPI_Message message;
+    MPI_Status status;
+    while (!done)
+    {
+        MPI_Improbe(MPI_ANY_SOURCE, tag, comm, &flag, &message, &status);
+        if (flag)
+        {
+            MPI_Get_count(&status, type, &count);
+            data = (char*)malloc((size_t)count*extent + 1);
+            MPI_Mrecv(data, count, type, &message, MPI_STATUS_IGNORE);
+            add_crs_msg(msgs, status.MPI_SOURCE, count, count*(int)extent, data);
+        }
+
+        if (barrier_active)
+            MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+        else
+        {
+            MPI_Testall(n_sends, send_requests, &flag, MPI_STATUSES_IGNORE);
+            if (flag)
+            {
+                MPI_Ibarrier(comm, &barrier);
+                barrier_active = 1;
+            }
+        }
+    }
+}
+
+int alltoallv_crs_nbx(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm)
+{
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(sendtype, &lb, &extent);
+    const char* send_buffer = (const char*)sendvals;
+
+    // Probes of a rank still finishing could otherwise match sends of
+    // a following exchange
+    MPI_Comm nbx_comm;
+    MPI_Comm_dup(comm->global_comm, &nbx_comm);
+
+    MPI_Request* requests = (MPI_Request*)malloc((send_nnz+1)*sizeof(MPI_Request));
+    for (int i = 0; i < send_nnz; i++)
+        MPI_Issend(&(send_buffer[(size_t)sdispls[i]*extent]), sendcounts[i], sendtype,
+                dest[i], CRS_NBX_TAG, nbx_comm, &(requests[i]));
+
+    CrsMsgs msgs = {0, 0, NULL};
+    nbx_recv(send_nnz, requests, recvtype, CRS_NBX_TAG, nbx_comm, &msgs);
+    free(requests);
+    MPI_Comm_free(&nbx_comm);
+
+    finish_crs_msgs(&msgs, 0, recvtype, comm->global_comm, recv_nnz, src_ptr,
+            recvcounts_ptr, rdispls_ptr, recvvals_ptr);
+
+    return MPI_SUCCESS;
+}
+
+int alltoallv_crs_rma(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm->global_comm, &rank);
+    MPI_Comm_size(comm->global_comm, &num_procs);
+
+    MPI_Aint lb, send_extent, recv_extent;
+    MPI_Type_get_extent(sendtype, &lb, &send_extent);
+    MPI_Type_get_extent(recvtype, &lb, &recv_extent);
+
+    // Each source adds the number of messages it sends into its own
+    // entry of the destination's window
+    long* n_msgs;
+    long one = 1;
+    MPI_Win win;
+    MPI_Win_allocate(num_procs*sizeof(long), sizeof(long), MPI_INFO_NULL,
+            comm->global_comm, &n_msgs, &win);
+    for (int i = 0; i < num_procs; i++)
+        n_msgs[i] = 0;
+    MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
+    for (int i = 0; i < send_nnz; i++)
+        MPI_Accumulate(&one, 1, MPI_LONG, dest[i], rank, 1, MPI_LONG, MPI_SUM, win);
+    MPI_Win_fence(MPI_MODE_NOPUT|MPI_MODE_NOSUCCEED, win);
+
+    const char* send_buffer = (const char*)sendvals;
+    MPI_Request* requests = (MPI_Request*)malloc((send_nnz+1)*sizeof(MPI_Request));
+    for (int i = 0; i < send_nnz; i++)
+        MPI_Isend(&(send_buffer[(size_t)sdispls[i]*send_extent]), sendcounts[i], sendtype,
+                dest[i], CRS_RMA_TAG, comm->global_comm, &(requests[i]));
+
+    // Messages from one source are matched in the order they were sent,
+    // so their sizes are found by probing each in turn
+    int n = 0;
+    for (int i = 0; i < num_procs; i++)
+        n += n_msgs[i];
+    int* src = (int*)malloc((n+1)*sizeof(int));
+    int* recvcounts = (int*)malloc((n+1)*sizeof(int));
+    int* rdispls = (int*)malloc((n+1)*sizeof(int));
+    MPI_Message* messages = (MPI_Message*)malloc((n+1)*sizeof(MPI_Message));
+    MPI_Status status;
+    int size = 0;
+    n = 0;
+    for (int i = 0; i < num_procs; i++)
+    {
+        for (long j = 0; j < n_msgs[i]; j++)
+        {
+            MPI_Mprobe(i, CRS_RMA_TAG, comm->global_comm, &(messages[n]), &status);
+            MPI_Get_count(&status, recvtype, &(recvcounts[n]));
+            src[n] = i;
+            rdispls[n] = size;
+            size += recvcounts[n++];
+        }
+    }
+    MPI_Win_free(&win);
+
+    char* recvvals = (char*)malloc((size_t)size*recv_extent + 1);
+    for (int i = 0; i < n; i++)
+        MPI_Mrecv(&(recvvals[(size_t)rdispls[i]*recv_extent]), recvcounts[i], recvtype,
+                &(messages[i]), MPI_STATUS_IGNORE);
+    MPI_Waitall(send_nnz, requests, MPI_STATUSES_IGNORE);
+    free(requests);
+    free(messages);
+
+    *recv_nnz = n;
+    *src_ptr = src;
+    if (recvcounts_ptr) *recvcounts_ptr = recvcounts;
+    else free(recvcounts);
+    if (rdispls_ptr) *rdispls_ptr = rdispls;
+    else free(rdispls);
+    *recvvals_ptr = recvvals;
+
+    return MPI_SUCCESS;
+}
+
+
+static void stream_reserve(CrsStream* stream, int bytes)
+{
+    if (stream->size + bytes <= stream->capacity)
+        return;
+    int capacity = stream->capacity ? 2*stream->capacity : 1024;
+    while (capacity < stream->size + bytes)
+        capacity *= 2;
+    stream->data = (char*)realloc(stream->data, capacity);
+    stream->capacity = capacity;
+}
+
+static void stream_append(CrsStream* stream, const void* data, int bytes)
+{
+    stream_reserve(stream, bytes);
+    memcpy(&(stream->data[stream->size]), data, bytes);
+    stream->size += bytes;
+}
+
+// Append count elements of type at vals as a record from src to dest
+static void stream_append_record(CrsStream* stream, int src, int dest,
+        const void* vals, int count, MPI_Datatype type, MPI_Comm comm)
+{
+    CrsRecord record;
+    int type_size, packed_size;
+    MPI_Type_size(type, &type_size);
+    MPI_Pack_size(count, type, comm, &packed_size);
+    stream_reserve(stream, sizeof(CrsRecord) + packed_size);
+
+    int start = stream->size;
+    int position = start + sizeof(CrsRecord);
+    MPI_Pack(vals, count, type, stream->data, stream->capacity, &position, comm);
+
+    record.src = src;
+    record.dest = dest;
+    record.bytes = count*type_size;
+    record.packed = position - start - (int)sizeof(CrsRecord);
+    memcpy(&(stream->data[start]), &record, sizeof(CrsRecord));
+    stream->size = position;
+}
+
+// Exchange one stream with each rank of comm (dense, for on-node
+// communicators), returning the concatenated streams received
+static char* exchange_streams(CrsStream* streams, MPI_Comm comm, int* size_ptr)
+{
+    int num_procs;
+    MPI_Comm_size(comm, &num_procs);
+
+    int* sendcounts = (int*)malloc(num_procs*sizeof(int));
+    int* sdispls = (int*)malloc(num_procs*sizeof(int));
+    int* recvcounts = (int*)malloc(num_procs*sizeof(int));
+    int* rdispls = (int*)malloc(num_procs*sizeof(int));
+    for (int i = 0; i < num_procs; i++)
+        sendcounts[i] = streams[i].size;
+    PMPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, comm);
+
+    char* send_buffer;
+    int send_size = 0;
+    int recv_size = 0;
+    for (int i = 0; i < num_procs; i++)
+    {
+        sdispls[i] = send_size;
+        send_size += sendcounts[i];
+        rdispls[i] = recv_size;
+        recv_size += recvcounts[i];
+    }
+    send_buffer = (char*)malloc(send_size + 1);
+    for (int i = 0; i < num_procs; i++)
+        if (streams[i].size)
+            memcpy(&(send_buffer[sdispls[i]]), streams[i].data, streams[i].size);
+
+    char* recv_buffer = (char*)malloc(recv_size + 1);
+    PMPI_Alltoallv(send_buffer, sendcounts, sdispls, MPI_BYTE,
+            recv_buffer, recvcounts, rdispls, MPI_BYTE, comm);
+
+    free(send_buffer);
+    free(sendcounts);
+    free(sdispls);
+    free(recvcounts);
+    free(rdispls);
+
+    *size_ptr = recv_size;
+    return recv_buffer;
+}
+
+// Walk the records of a stream : those for rank are kept in msgs,
+// others appended to the stream of their destination node (by_node)
+// or of their destination's local rank (nodes hold ppn ranks)
+static void route_records(const char* data, int size, int rank, int recv_size,
+        CrsMsgs* msgs, CrsStream* streams, int by_node, int ppn)
+{
+    CrsRecord record;
+    char* packed;
+    int pos = 0;
+    while (pos < size)
+    {
+        memcpy(&record, &(data[pos]), sizeof(CrsRecord));
+        if (record.dest == rank)
+        {
+            packed = (char*)malloc(record.packed + 1);
+            memcpy(packed, &(data[pos + sizeof(CrsRecord)]), record.packed);
+            add_crs_msg(msgs, record.src, recv_size ? record.bytes / recv_size : 0,
+                    record.packed, packed);
+        }
+        else
+            stream_append(&(streams[by_node ? record.dest / ppn
+                        : record.dest % ppn]), &(data[pos]),
+                    sizeof(CrsRecord) + record.packed);
+        pos += sizeof(CrsRecord) + record.packed;
+    }
+}
+
+int alltoallv_crs_loc(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm->global_comm, &rank);
+    MPI_Comm_size(comm->global_comm, &num_procs);
+
+    // Only the last node may hold fewer ranks (comm->ppn is the size
+    // of this rank's node)
+    int ppn, local_size;
+    MPI_Comm_size(comm->local_comm, &local_size);
+    MPI_Allreduce(&local_size, &ppn, 1, MPI_INT, MPI_MAX, comm->global_comm);
+    int num_nodes = (num_procs + ppn - 1) / ppn;
+    int rank_node = rank / ppn;
+
+    int recv_size;
+    MPI_Aint lb, extent;
+    MPI_Type_size(recvtype, &recv_size);
+    MPI_Type_get_extent(sendtype, &lb, &extent);
+    const char* send_buffer = (const char*)sendvals;
+
+    CrsMsgs msgs = {0, 0, NULL};
+    CrsStream* local_streams = (CrsStream*)calloc(local_size, sizeof(CrsStream));
+    CrsStream* node_streams = (CrsStream*)calloc(num_nodes, sizeof(CrsStream));
+    char* data;
+    int size, node, node_size;
+
+    // On node : messages to this node go to their destination, others
+    // to the rank sending to their destination node
+    for (int i = 0; i < send_nnz; i++)
+    {
+        node = dest[i] / ppn;
+        stream_append_record(
+                &(local_streams[node == rank_node ? dest[i] % ppn
+                    : node % local_size]),
+                rank, dest[i], &(send_buffer[(size_t)sdispls[i]*extent]),
+                sendcounts[i], sendtype, comm->global_comm);
+    }
+    data = exchange_streams(local_streams, comm->local_comm, &size);
+    route_records(data, size, rank, recv_size, &msgs, node_streams, 1, ppn);
+    free(data);
+
+    // Between nodes : one message per pair of nodes, discovered with NBX
+    // Node n receives from this node on local rank rank_node % (its size)
+    MPI_Comm nbx_comm;
+    MPI_Comm_dup(comm->global_comm, &nbx_comm);
+    int n_sends = 0;
+    MPI_Request* requests = (MPI_Request*)malloc((num_nodes+1)*sizeof(MPI_Request));
+    for (int n = 0; n < num_nodes; n++)
+    {
+        if (node_streams[n].size == 0)
+            continue;
+        node_size = num_procs - n*ppn < ppn ? num_procs - n*ppn : ppn;
+        MPI_Issend(node_streams[n].data, node_streams[n].size, MPI_BYTE,
+                n*ppn + rank_node % node_size, CRS_LOC_TAG,
+                nbx_comm, &(requests[n_sends++]));
+    }
+    CrsMsgs node_msgs = {0, 0, NULL};
+    nbx_recv(n_sends, requests, MPI_BYTE, CRS_LOC_TAG, nbx_comm, &node_msgs);
+    free(requests);
+    MPI_Comm_free(&nbx_comm);
+
+    // On node : redistribute to destinations
+    for (int i = 0; i < local_size; i++)
+        local_streams[i].size = 0;
+    for (int i = 0; i < node_msgs.n; i++)
+    {
+        route_records(node_msgs.msgs[i].data, node_msgs.msgs[i].count, rank,
+                recv_size, &msgs, local_streams, 0, ppn);
+        free(node_msgs.msgs[i].data);
+    }
+    free(node_msgs.msgs);
+
+    data = exchange_streams(local_streams, comm->local_comm, &size);
+    route_records(data, size, rank, recv_size, &msgs, node_streams, 1, ppn);
+    free(data);
+
+    for (int i = 0; i < local_size; i++)
+        free(local_streams[i].data);
+    for (int n = 0; n < num_nodes; n++)
+        free(node_streams[n].data);
+    free(local_streams);
+    free(node_streams);
+
+    finish_crs_msgs(&msgs, 1, recvtype, comm->global_comm, recv_nnz, src_ptr,
+            recvcounts_ptr, rdispls_ptr, recvvals_ptr);
+
+    return MPI_SUCCESS;
+}
+
+
+int MPIX_Alltoallv_crs(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPI_Info info,
+        MPIX_Comm* comm)
+{
+    char algorithm[16] = "nbx";
+    int flag = 0;
+    if (info != MPI_INFO_NULL)
+        MPI_Info_get(info, "mpix_crs_algorithm", 15, algorithm, &flag);
+
+    if (strcmp(algorithm, "rma") == 0)
+        return alltoallv_crs_rma(send_nnz, dest, sendcounts, sdispls, sendtype,
+                sendvals, recv_nnz, src_ptr, recvcounts_ptr, rdispls_ptr,
+                recvtype, recvvals_ptr, comm);
+    if (strcmp(algorithm, "locality") == 0)
+        return alltoallv_crs_loc(send_nnz, dest, sendcounts, sdispls, sendtype,
+                sendvals, recv_nnz, src_ptr, recvcounts_ptr, rdispls_ptr,
+                recvtype, recvvals_ptr, comm);
+    return alltoallv_crs_nbx(send_nnz, dest, sendcounts, sdispls, sendtype,
+            sendvals, recv_nnz, src_ptr, recvcounts_ptr, rdispls_ptr,
+            recvtype, recvvals_ptr, comm);
+}
+
+int MPIX_Alltoall_crs(int send_nnz,
+        const int dest[],
+        int sendcount,
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int recvcount,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPI_Info info,
+        MPIX_Comm* comm)
+{
+    int* sendcounts = (int*)malloc((send_nnz+1)*sizeof(int));
+    int* sdispls = (int*)malloc((send_nnz+1)*sizeof(int));
+    for (int i = 0; i < send_nnz; i++)
+    {
+        sendcounts[i] = sendcount;
+        sdispls[i] = i*sendcount;
+    }
+
+    int* recvcounts;
+    int* rdispls;
+    int ierr = MPIX_Alltoallv_crs(send_nnz, dest, sendcounts, sdispls, sendtype,
+            sendvals, recv_nnz, src_ptr, &recvcounts, &rdispls, recvtype,
+            recvvals_ptr, info, comm);
+
+    // Every message must hold recvcount elements
+    for (int i = 0; i < *recv_nnz; i++)
+        if (recvcounts[i] != recvcount)
+            ierr = MPI_ERR_COUNT;
+
+    free(sendcounts);
+    free(sdispls);
+    free(recvcounts);
+    free(rdispls);
+
+    return ierr;
+}
@@ -0,0 +1,111 @@
+#ifndef MPI_ADVANCE_SPARSE_COLL_H
+#define MPI_ADVANCE_SPARSE_COLL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+#include "utils.h"
+#include "locality/topology.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Sparse dynamic data exchange (e.g. forming the send side of a
+// communication pattern from its receive side) : each rank knows only
+// the ranks it sends to, and learns which ranks send to it (collective)
+// Data for dest[i] is sendcount elements at sendvals + i*sendcount
+// elements; the recv_nnz sources (in increasing order) are returned in
+// *src_ptr, and recvcount elements from each in *recvvals_ptr (both
+// allocated here, freed by the caller)
+// A destination may appear more than once; its messages arrive in the
+// order sent.  MPI_ERR_COUNT is returned if a message does not hold
+// recvcount elements
+// The info key "mpix_crs_algorithm" selects "nbx" (default), "rma" or
+// "locality" (info may be MPI_INFO_NULL)
+int MPIX_Alltoall_crs(int send_nnz,
+        const int dest[],
+        int sendcount,
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int recvcount,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPI_Info info,
+        MPIX_Comm* comm);
+
+// Sparse dynamic data exchange of varying sizes : sendcounts[i]
+// elements at sdispls[i] go to dest[i] (zero-size messages still
+// identify their source), and recvcounts and rdispls (in elements of
+// recvtype) of each source are returned along with the data
+int MPIX_Alltoallv_crs(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPI_Info info,
+        MPIX_Comm* comm);
+
+// Helper Functions
+// NBX : synchronous sends, received until a barrier started once all
+// sends are matched completes
+int alltoallv_crs_nbx(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm);
+// RMA : message counts are accumulated into a window of one entry per
+// rank, then data is exchanged with point-to-point messages
+int alltoallv_crs_rma(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm);
+// Locality-aware : messages are gathered on node by the rank assigned
+// to each destination node, exchanged with NBX between nodes (one
+// message per pair of nodes) and redistributed on node
+int alltoallv_crs_loc(int send_nnz,
+        const int dest[],
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        const void* sendvals,
+        int* recv_nnz,
+        int** src_ptr,
+        int** recvcounts_ptr,
+        int** rdispls_ptr,
+        MPI_Datatype recvtype,
+        void** recvvals_ptr,
+        MPIX_Comm* comm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,11 +41,19 @@ TEST(RandomCommTest, TestsInTests)
     std::vector<int> std_alltoall(max_s*num_procs);
     std::vector<int> pairwise_alltoall(max_s*num_procs);
     std::vector<int> loc_pairwise_alltoall(max_s*num_procs);
+    std::vector<int> grid_alltoall(max_s*num_procs);
 
     MPIX_Comm* locality_comm;
     MPIX_Comm_init(&locality_comm, MPI_COMM_WORLD);
     update_locality(locality_comm, 4);
 
+    // 3-D virtual grid (nodes factored in two, then PPN)
+    MPIX_Comm* grid_comm;
+    MPIX_Comm_init(&grid_comm, MPI_COMM_WORLD);
+    update_locality(grid_comm, 4);
+    int dims[3] = {0, 0, 0};
+    MPIX_Comm_grid_init(grid_comm, 3, dims);
+
     for (int i = 0; i < max_i; i++)
     {
         int s = pow(2, i);
@@ -87,6 +95,28 @@ TEST(RandomCommTest, TestsInTests)
         for (int j = 0; j < s*num_procs; j++)
             ASSERT_EQ(std_alltoall[j], loc_pairwise_alltoall[j]);
 
+        // Multi-Dimensional Alltoall (default nodes x PPN grid)
+        alltoall_grid(local_data.data(), 
+                s, 
+                MPI_INT,
+                grid_alltoall.data(), 
+                s, 
+                MPI_INT,
+                locality_comm);
+        for (int j = 0; j < s*num_procs; j++)
+            ASSERT_EQ(std_alltoall[j], grid_alltoall[j]);
+
+        // Multi-Dimensional Alltoall (3-D grid)
+        alltoall_grid(local_data.data(), 
+                s, 
+                MPI_INT,
+                grid_alltoall.data(), 
+                s, 
+                MPI_INT,
+                grid_comm);
+        for (int j = 0; j < s*num_procs; j++)
+            ASSERT_EQ(std_alltoall[j], grid_alltoall[j]);
+
         /*
         alltoall_bruck(local_data.data(), 
                 s, 
@@ -100,6 +130,7 @@ TEST(RandomCommTest, TestsInTests)
     }
 
     MPIX_Comm_free(locality_comm);
+    MPIX_Comm_free(grid_comm);
 }
 
 
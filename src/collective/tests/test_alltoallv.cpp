@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <vector>
 #include <set>
+#include <climits>
 
 int main(int argc, char** argv)
 {
@@ -41,9 +42,12 @@ TEST(RandomCommTest, TestsInTests)
     std::vector<int> std_alltoallv(max_s*num_procs);
     std::vector<int> pairwise_alltoallv(max_s*num_procs);
     std::vector<int> loc_pairwise_alltoallv(max_s*num_procs);
+    std::vector<int> large_count_alltoallv(max_s*num_procs);
 
     std::vector<int> sizes(num_procs);
     std::vector<int> displs(num_procs+1);
+    std::vector<MPI_Count> large_sizes(num_procs);
+    std::vector<MPI_Aint> large_displs(num_procs+1);
 
     MPIX_Comm* locality_comm;
     MPIX_Comm_init(&locality_comm, MPI_COMM_WORLD);
@@ -61,6 +65,8 @@ TEST(RandomCommTest, TestsInTests)
                 local_data[i*s + j] = rank*10000 + i*100 + j;
             sizes[i] = s;
             displs[i+1] = displs[i] + s;
+            large_sizes[i] = s;
+            large_displs[i] = displs[i];
         }
 
 
@@ -99,9 +105,42 @@ TEST(RandomCommTest, TestsInTests)
                 locality_comm);
         for (int j = 0; j < s*num_procs; j++)
             ASSERT_EQ(std_alltoallv[j], loc_pairwise_alltoallv[j]);
+
+        // Large-Count Alltoallv
+        MPIX_Alltoallv_c(local_data.data(), 
+                large_sizes.data(),
+                large_displs.data(),
+                MPI_INT, 
+                large_count_alltoallv.data(), 
+                large_sizes.data(),
+                large_displs.data(),
+                MPI_INT,
+                locality_comm);
+        for (int j = 0; j < s*num_procs; j++)
+            ASSERT_EQ(std_alltoallv[j], large_count_alltoallv[j]);
     }
 
     MPIX_Comm_free(locality_comm);
 }
 
+TEST(LargeCountTypeTest, TestsInTests)
+{
+    int count;
+    MPI_Datatype type;
+    MPI_Count type_size;
+
+    // Fits in an int : type is used directly
+    ASSERT_EQ(large_count_type(1000, MPI_DOUBLE, &count, &type), 0);
+    ASSERT_EQ(count, 1000);
+    ASSERT_EQ(type, MPI_DOUBLE);
+
+    // Past INT_MAX : single derived datatype holding every element
+    MPI_Count large = 3*(MPI_Count)INT_MAX + 17;
+    ASSERT_EQ(large_count_type(large, MPI_CHAR, &count, &type), 1);
+    ASSERT_EQ(count, 1);
+    MPI_Type_size_x(type, &type_size);
+    ASSERT_EQ(type_size, large);
+    MPI_Type_free(&type);
+}
+
 
@@ -0,0 +1,140 @@
+// EXPECT_EQ and ASSERT_EQ are macros
+// EXPECT_EQ test execution and continues even if there is a failure
+// ASSERT_EQ test execution and aborts if there is a failure
+// The ASSERT_* variants abort the program execution if an assertion fails
+// while EXPECT_* variants continue with the run.
+
+
+#include "gtest/gtest.h"
+#include "mpi_advance.h"
+#include <mpi.h>
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <assert.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    ::testing::InitGoogleTest(&argc, argv);
+    int temp=RUN_ALL_TESTS();
+    MPI_Finalize();
+    return temp;
+} // end of main() //
+
+// Destinations of rank p (known to every rank, so sources can be checked)
+// On few ranks, a destination may be repeated
+static std::vector<int> crs_dest(int p, int num_procs)
+{
+    const int offsets[5] = {1, 2, 5, 10, 0};
+    std::vector<int> dest;
+    for (int k = 0; k < p % 6; k++)
+        dest.push_back((p + offsets[k]) % num_procs);
+    return dest;
+}
+
+static int crs_count(int src, int dest)
+{
+    return (src + dest) % 4;
+}
+
+TEST(SparseCollTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    MPIX_Comm* locality_comm;
+    MPIX_Comm_init(&locality_comm, MPI_COMM_WORLD);
+    update_locality(locality_comm, 4);
+
+    std::vector<int> dest = crs_dest(rank, num_procs);
+    int send_nnz = dest.size();
+
+    // Expected sources, in increasing order
+    std::vector<int> sources;
+    for (int p = 0; p < num_procs; p++)
+    {
+        std::vector<int> p_dest = crs_dest(p, num_procs);
+        for (int i = 0; i < (int)p_dest.size(); i++)
+            if (p_dest[i] == rank)
+                sources.push_back(p);
+    }
+
+    std::vector<int> sendvals(2*send_nnz);
+    for (int i = 0; i < send_nnz; i++)
+    {
+        sendvals[2*i] = rank*100 + dest[i];
+        sendvals[2*i+1] = rank;
+    }
+
+    std::vector<int> sendcounts(send_nnz);
+    std::vector<int> sdispls(send_nnz);
+    std::vector<int> sendvals_v;
+    for (int i = 0; i < send_nnz; i++)
+    {
+        sendcounts[i] = crs_count(rank, dest[i]);
+        sdispls[i] = sendvals_v.size();
+        for (int j = 0; j < sendcounts[i]; j++)
+            sendvals_v.push_back(rank*1000 + dest[i]*10 + j);
+    }
+
+    const char* algorithms[3] = {"nbx", "rma", "locality"};
+    MPI_Info info;
+    MPI_Info_create(&info);
+    for (int a = 0; a < 3; a++)
+    {
+        MPI_Info_set(info, "mpix_crs_algorithm", algorithms[a]);
+
+        int recv_nnz;
+        int* src;
+        int* recvvals;
+        int ierr = MPIX_Alltoall_crs(send_nnz, dest.data(), 2, MPI_INT, sendvals.data(),
+                &recv_nnz, &src, 2, MPI_INT, (void**)&recvvals, info, locality_comm);
+        ASSERT_EQ(ierr, MPI_SUCCESS);
+        ASSERT_EQ(recv_nnz, (int)sources.size());
+        for (int i = 0; i < recv_nnz; i++)
+        {
+            ASSERT_EQ(src[i], sources[i]);
+            ASSERT_EQ(recvvals[2*i], sources[i]*100 + rank);
+            ASSERT_EQ(recvvals[2*i+1], sources[i]);
+        }
+        free(src);
+        free(recvvals);
+
+        int* recvcounts;
+        int* rdispls;
+        MPIX_Alltoallv_crs(send_nnz, dest.data(), sendcounts.data(), sdispls.data(),
+                MPI_INT, sendvals_v.data(), &recv_nnz, &src, &recvcounts, &rdispls,
+                MPI_INT, (void**)&recvvals, info, locality_comm);
+        ASSERT_EQ(recv_nnz, (int)sources.size());
+        int displ = 0;
+        for (int i = 0; i < recv_nnz; i++)
+        {
+            ASSERT_EQ(src[i], sources[i]);
+            ASSERT_EQ(recvcounts[i], crs_count(sources[i], rank));
+            ASSERT_EQ(rdispls[i], displ);
+            for (int j = 0; j < recvcounts[i]; j++)
+                ASSERT_EQ(recvvals[displ + j], sources[i]*1000 + rank*10 + j);
+            displ += recvcounts[i];
+        }
+        free(src);
+        free(recvcounts);
+        free(rdispls);
+        free(recvvals);
+    }
+    MPI_Info_free(&info);
+
+    // Messages not holding recvcount elements are reported
+    int recv_nnz;
+    int* src;
+    int* recvvals;
+    int ierr = MPIX_Alltoall_crs(send_nnz, dest.data(), 2, MPI_INT, sendvals.data(),
+            &recv_nnz, &src, 3, MPI_INT, (void**)&recvvals, MPI_INFO_NULL, locality_comm);
+    ASSERT_EQ(ierr, recv_nnz ? MPI_ERR_COUNT : MPI_SUCCESS);
+    free(src);
+    free(recvvals);
+
+    MPIX_Comm_free(locality_comm);
+}
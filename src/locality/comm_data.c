@@ -10,7 +10,11 @@ void init_comm_data(CommData** comm_data_ptr, MPI_Datatype datatype)
     data->procs = NULL;
     data->indptr = NULL;
     data->indices = NULL;
-    data->buffer = NULL;
+    data->global_indices = NULL;
+    data->num_runs = 0;
+    data->run_ptr = NULL;
+    data->run_starts = NULL;
+    data->direct = 0;
 
     *comm_data_ptr = data;
 }
@@ -20,7 +24,9 @@ void destroy_comm_data(CommData* data)
     if (data->procs) free(data->procs);
     if (data->indptr) free(data->indptr);
     if (data->indices) free(data->indices);
-    if (data->buffer) free(data->buffer);
+    if (data->global_indices) free(data->global_indices);
+    if (data->run_ptr) free(data->run_ptr);
+    if (data->run_starts) free(data->run_starts);
 
     free(data);
 }
@@ -39,14 +45,54 @@ void init_size_msgs(CommData* data, int size_msgs)
 {
     data->size_msgs = size_msgs;
     if (data->size_msgs)
-        data->indices = (int*)malloc(data->size_msgs*sizeof(int));
+        data->global_indices = (long*)malloc(data->size_msgs*sizeof(long));
 }
     
 
 void finalize_comm_data(CommData* data)
 {
-    if (data->size_msgs)
-        data->buffer = (char*)malloc(data->size_msgs*data->datatype_size*sizeof(char));
+    if (data->global_indices)
+    {
+        free(data->global_indices);
+        data->global_indices = NULL;
+    }
+
+    if (data->indices)
+        compress_indices(data);
+}
+
+// Find runs of consecutive indices, kept if they average at least
+// 4 elements (or the indices form a single run)
+void compress_indices(CommData* data)
+{
+    int num_runs = 0;
+    for (int i = 0; i < data->size_msgs; i++)
+        if (i == 0 || data->indices[i] != data->indices[i-1] + 1)
+            num_runs++;
+
+    if (num_runs == 0 || (num_runs > 1 && num_runs*4 > data->size_msgs))
+        return;
+
+    data->num_runs = num_runs;
+    data->run_ptr = (int*)malloc((num_runs+1)*sizeof(int));
+    data->run_starts = (int*)malloc(num_runs*sizeof(int));
+
+    num_runs = 0;
+    for (int i = 0; i < data->size_msgs; i++)
+    {
+        if (i == 0 || data->indices[i] != data->indices[i-1] + 1)
+        {
+            data->run_ptr[num_runs] = i;
+            data->run_starts[num_runs++] = data->indices[i];
+        }
+    }
+    data->run_ptr[num_runs] = data->size_msgs;
+}
+
+// Position i of buffer holds index i of the source
+int identity_indices(const CommData* data)
+{
+    return data->num_runs == 1 && data->run_starts[0] == 0;
 }
 
 
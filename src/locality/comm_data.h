@@ -18,7 +18,17 @@ typedef struct _CommData
     int* procs;
     int* indptr;
     int* indices;
-    char* buffer;
+    long* global_indices; // 64-bit global indices, only used during setup
+
+    // Indices compressed into runs of consecutive values (0 if not worthwhile)
+    // buffer positions run_ptr[r] to run_ptr[r+1] map to run_starts[r] onward
+    int num_runs;
+    int* run_ptr;
+    int* run_starts;
+
+    // Messages use the source (or destination) buffer directly, without
+    // a staging buffer (identity indices, or indexed datatypes)
+    int direct;
 } CommData;
 
 void init_comm_data(CommData** comm_data_ptr, MPI_Datatype datatype);
@@ -26,6 +36,8 @@ void destroy_comm_data(CommData* data);
 void init_num_msgs(CommData* data, int num_msgs);
 void init_size_msgs(CommData* data, int size_msgs);
 void finalize_comm_data(CommData* data);
+void compress_indices(CommData* data);
+int identity_indices(const CommData* data);
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,6 @@
 #include "locality_comm.h"
 
-void init_locality_comm(LocalityComm** locality_ptr, const MPIX_Comm* mpix_comm,
+void init_locality_comm(LocalityComm** locality_ptr, MPIX_Comm* mpix_comm,
         MPI_Datatype sendtype, MPI_Datatype recvtype)
 {
     LocalityComm* locality = (LocalityComm*)malloc(sizeof(LocalityComm));
@@ -10,26 +10,209 @@ void init_locality_comm(LocalityComm** locality_ptr, const MPIX_Comm* mpix_comm,
     init_comm_pkg(&(locality->local_R_comm), recvtype, recvtype, 29301);
     init_comm_pkg(&(locality->global_comm), recvtype, recvtype, 72459);
 
+    locality->global_send_deps = NULL;
+    locality->local_S_fwd_ptr = NULL;
+    locality->local_S_fwd = NULL;
+    locality->local_R_send_deps = NULL;
+    locality->global_fwd_ptr = NULL;
+    locality->global_fwd = NULL;
+
+    locality->n_sources = 0;
+    locality->source_counts = NULL;
+    locality->local_L_src_ptr = NULL;
+    locality->local_L_srcs = NULL;
+    locality->local_L_src_counts = NULL;
+    locality->local_R_src_ptr = NULL;
+    locality->local_R_srcs = NULL;
+    locality->local_R_src_counts = NULL;
+
+    for (int i = 0; i < 4; i++)
+        locality->requested_sizes[i] = 0;
+    locality->pattern_hash = 0;
+    locality->ref_count = 1;
+
     locality->communicators = mpix_comm;
 
     *locality_ptr = locality;
 }
 
+// For each message of send_data (indexing into the buffer received
+// through recv_data), count the distinct recv messages it depends on,
+// and list for each recv message the send messages it feeds
+void form_forwarding(const CommData* recv_data, const CommData* send_data,
+        int** deps_ptr, int** fwd_ptr_ptr, int** fwd_list_ptr)
+{
+    int n_recvs = recv_data->num_msgs;
+    int n_sends = send_data->num_msgs;
+
+    int* msg_of_pos = NULL;
+    int* last_send = NULL;
+    if (recv_data->size_msgs)
+        msg_of_pos = (int*)malloc(recv_data->size_msgs*sizeof(int));
+    if (n_recvs)
+        last_send = (int*)malloc(n_recvs*sizeof(int));
+    for (int m = 0; m < n_recvs; m++)
+    {
+        last_send[m] = -1;
+        for (int k = recv_data->indptr[m]; k < recv_data->indptr[m+1]; k++)
+            msg_of_pos[k] = m;
+    }
+
+    int* deps = (int*)malloc((n_sends+1)*sizeof(int));
+    int* fwd_ptr = (int*)calloc(n_recvs+1, sizeof(int));
+
+    // Count (recv, send) pairs
+    int m;
+    for (int g = 0; g < n_sends; g++)
+    {
+        deps[g] = 0;
+        for (int k = send_data->indptr[g]; k < send_data->indptr[g+1]; k++)
+        {
+            m = msg_of_pos[send_data->indices[k]];
+            if (last_send[m] == g) continue;
+            last_send[m] = g;
+            deps[g]++;
+            fwd_ptr[m+1]++;
+        }
+    }
+    for (int m = 0; m < n_recvs; m++)
+        fwd_ptr[m+1] += fwd_ptr[m];
+
+    int* fwd = (int*)malloc((fwd_ptr[n_recvs]+1)*sizeof(int));
+    int* pos = (int*)malloc((n_recvs+1)*sizeof(int));
+    for (int m = 0; m < n_recvs; m++)
+    {
+        pos[m] = fwd_ptr[m];
+        last_send[m] = -1;
+    }
+    for (int g = 0; g < n_sends; g++)
+    {
+        for (int k = send_data->indptr[g]; k < send_data->indptr[g+1]; k++)
+        {
+            m = msg_of_pos[send_data->indices[k]];
+            if (last_send[m] == g) continue;
+            last_send[m] = g;
+            fwd[pos[m]++] = g;
+        }
+    }
+
+    free(msg_of_pos);
+    free(last_send);
+    free(pos);
+
+    *deps_ptr = deps;
+    *fwd_ptr_ptr = fwd_ptr;
+    *fwd_list_ptr = fwd;
+}
+
+// Group the final positions of each recv message by original source
+static void map_recv_sources(const CommData* recv_data, const int* src_of_pos,
+        int** ptr_ptr, int** srcs_ptr, int** counts_ptr)
+{
+    int n_msgs = recv_data->num_msgs;
+    int* ptr = (int*)malloc((n_msgs+1)*sizeof(int));
+    int* srcs = (int*)malloc((recv_data->size_msgs+1)*sizeof(int));
+    int* counts = (int*)malloc((recv_data->size_msgs+1)*sizeof(int));
+
+    int n = 0;
+    int src;
+    ptr[0] = 0;
+    for (int m = 0; m < n_msgs; m++)
+    {
+        for (int k = recv_data->indptr[m]; k < recv_data->indptr[m+1]; k++)
+        {
+            src = src_of_pos[recv_data->indices[k]];
+            if (n > ptr[m] && srcs[n-1] == src)
+                counts[n-1]++;
+            else
+            {
+                srcs[n] = src;
+                counts[n++] = 1;
+            }
+        }
+        ptr[m+1] = n;
+    }
+
+    *ptr_ptr = ptr;
+    *srcs_ptr = srcs;
+    *counts_ptr = counts;
+}
+
+// Record which original sources (positions rdispls[i] to 
+// rdispls[i]+recvcounts[i] of recvbuf) each local_L/local_R recv delivers
+// (a source split over several runs of a message may appear more than once)
+void form_source_map(LocalityComm* locality, int n_sources,
+        const int* recvcounts, const int* rdispls)
+{
+    int size = 0;
+    for (int i = 0; i < n_sources; i++)
+        if (rdispls[i] + recvcounts[i] > size)
+            size = rdispls[i] + recvcounts[i];
+
+    int* src_of_pos = (int*)malloc((size+1)*sizeof(int));
+    for (int i = 0; i < n_sources; i++)
+        for (int j = 0; j < recvcounts[i]; j++)
+            src_of_pos[rdispls[i]+j] = i;
+
+    locality->n_sources = n_sources;
+    locality->source_counts = (int*)malloc((n_sources+1)*sizeof(int));
+    for (int i = 0; i < n_sources; i++)
+        locality->source_counts[i] = recvcounts[i];
+
+    map_recv_sources(locality->local_L_comm->recv_data, src_of_pos,
+            &(locality->local_L_src_ptr), &(locality->local_L_srcs),
+            &(locality->local_L_src_counts));
+    map_recv_sources(locality->local_R_comm->recv_data, src_of_pos,
+            &(locality->local_R_src_ptr), &(locality->local_R_srcs),
+            &(locality->local_R_src_counts));
+
+    free(src_of_pos);
+}
+
 void finalize_locality_comm(LocalityComm* locality)
 {
     finalize_comm_pkg(locality->local_L_comm);
     finalize_comm_pkg(locality->local_S_comm);
     finalize_comm_pkg(locality->local_R_comm);
     finalize_comm_pkg(locality->global_comm);
+
+    form_forwarding(locality->local_S_comm->recv_data,
+            locality->global_comm->send_data,
+            &(locality->global_send_deps),
+            &(locality->local_S_fwd_ptr),
+            &(locality->local_S_fwd));
+    form_forwarding(locality->global_comm->recv_data,
+            locality->local_R_comm->send_data,
+            &(locality->local_R_send_deps),
+            &(locality->global_fwd_ptr),
+            &(locality->global_fwd));
 }
 
 void destroy_locality_comm(LocalityComm* locality)
 {
+    if (--locality->ref_count > 0)
+        return;
+
     destroy_comm_pkg(locality->local_L_comm);
     destroy_comm_pkg(locality->local_S_comm);
     destroy_comm_pkg(locality->local_R_comm);
     destroy_comm_pkg(locality->global_comm);
 
+    free(locality->global_send_deps);
+    free(locality->local_S_fwd_ptr);
+    free(locality->local_S_fwd);
+    free(locality->local_R_send_deps);
+    free(locality->global_fwd_ptr);
+    free(locality->global_fwd);
+
+    free(locality->source_counts);
+    free(locality->local_L_src_ptr);
+    free(locality->local_L_srcs);
+    free(locality->local_L_src_counts);
+    free(locality->local_R_src_ptr);
+    free(locality->local_R_srcs);
+    free(locality->local_R_src_counts);
+
     free(locality);
 }
 
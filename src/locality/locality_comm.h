@@ -19,13 +19,52 @@ typedef struct _LocalityComm
     CommPkg* local_S_comm;
     CommPkg* local_R_comm;
     CommPkg* global_comm;
-    
-    const MPIX_Comm* communicators;
+
+    // Forwarding dependencies (built at finalize, immutable)
+    // global send message g needs global_send_deps[g] local_S recvs, and 
+    // local_S recv m feeds global sends local_S_fwd[local_S_fwd_ptr[m]...]
+    // (likewise for local_R sends fed by global recvs)
+    int* global_send_deps;
+    int* local_S_fwd_ptr;
+    int* local_S_fwd;
+    int* local_R_send_deps;
+    int* global_fwd_ptr;
+    int* global_fwd;
+
+    // Original sources (neighbors) delivered by each local_L/local_R recv:
+    // local_L recv m carries local_L_src_counts[j] values from source 
+    // local_L_srcs[j], for j in local_L_src_ptr[m] to local_L_src_ptr[m+1]
+    int n_sources;
+    int* source_counts;
+    int* local_L_src_ptr;
+    int* local_L_srcs;
+    int* local_L_src_counts;
+    int* local_R_src_ptr;
+    int* local_R_srcs;
+    int* local_R_src_counts;
+
+    // Values each step sends before duplicate indices are removed
+    // (local_L, local_S, local_R, global), see MPIX_Request_duplicate_ratios
+    int requested_sizes[4];
+
+    // Hash of the input pattern and topology the plan was built for
+    // (0 if it cannot be saved, see MPIX_Request_save)
+    unsigned long pattern_hash;
+
+    // Requests sharing this plan (see MPIX_Request_clone), destroyed
+    // with the last of them
+    int ref_count;
+
+    MPIX_Comm* communicators;
 } LocalityComm;
 
-void init_locality_comm(LocalityComm** locality_ptr, const MPIX_Comm* comm,
+void init_locality_comm(LocalityComm** locality_ptr, MPIX_Comm* comm,
         MPI_Datatype sendtype, MPI_Datatype recvtype);
 void finalize_locality_comm(LocalityComm* locality);
+void form_forwarding(const CommData* recv_data, const CommData* send_data,
+        int** deps_ptr, int** fwd_ptr_ptr, int** fwd_list_ptr);
+void form_source_map(LocalityComm* locality, int n_sources,
+        const int* recvcounts, const int* rdispls);
 void destroy_locality_comm(LocalityComm* locality);
 
 void get_local_comm_data(LocalityComm* locality,
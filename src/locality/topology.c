@@ -1,4 +1,5 @@
 #include "topology.h"
+#include "neighborhood/neighbor_cache.h"
 
 int MPIX_Comm_init(MPIX_Comm** comm_dist_graph_ptr, MPI_Comm global_comm)
 {
@@ -28,6 +29,19 @@ int MPIX_Comm_init(MPIX_Comm** comm_dist_graph_ptr, MPI_Comm global_comm)
             &(comm_dist_graph->group_comm));
 
     comm_dist_graph->neighbor_comm = MPI_COMM_NULL;
+    comm_dist_graph->indegree = 0;
+    comm_dist_graph->outdegree = 0;
+    comm_dist_graph->sources = NULL;
+    comm_dist_graph->sourceweights = NULL;
+    comm_dist_graph->destinations = NULL;
+    comm_dist_graph->destweights = NULL;
+    comm_dist_graph->reorder_perm = NULL;
+    comm_dist_graph->neighbor_cache = NULL;
+    comm_dist_graph->locality_tag_offset = 0;
+
+    comm_dist_graph->grid_ndims = 0;
+    comm_dist_graph->grid_dims = NULL;
+    comm_dist_graph->grid_comms = NULL;
     
     *comm_dist_graph_ptr = comm_dist_graph;
 
@@ -36,16 +50,78 @@ int MPIX_Comm_init(MPIX_Comm** comm_dist_graph_ptr, MPI_Comm global_comm)
 
 int MPIX_Comm_free(MPIX_Comm* comm_dist_graph)
 {
+    neighbor_cache_free(comm_dist_graph);
     if (comm_dist_graph->neighbor_comm != MPI_COMM_NULL)
         MPI_Comm_free(&(comm_dist_graph->neighbor_comm));
+    free(comm_dist_graph->sources);
+    free(comm_dist_graph->sourceweights);
+    free(comm_dist_graph->destinations);
+    free(comm_dist_graph->destweights);
+    free(comm_dist_graph->reorder_perm);
     MPI_Comm_free(&(comm_dist_graph->local_comm));
     MPI_Comm_free(&(comm_dist_graph->group_comm));
+    MPIX_Comm_grid_free(comm_dist_graph);
 
     free(comm_dist_graph);
 
     return 0;
 }
 
+// Form one communicator per grid dimension, holding all ranks
+// that share every coordinate except the one in that dimension
+int MPIX_Comm_grid_init(MPIX_Comm* comm, int ndims, int dims[])
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm->global_comm, &rank);
+    MPI_Comm_size(comm->global_comm, &num_procs);
+
+    if (ndims < 1)
+        return MPI_ERR_DIMS;
+
+    if (ndims > 1 && dims[ndims-1] == 0)
+        dims[ndims-1] = comm->ppn;
+
+    int fixed = 1;
+    for (int i = 0; i < ndims; i++)
+        if (dims[i]) fixed *= dims[i];
+    if (num_procs % fixed)
+        return MPI_ERR_DIMS;
+    MPI_Dims_create(num_procs, ndims, dims);
+
+    MPIX_Comm_grid_free(comm);
+
+    comm->grid_ndims = ndims;
+    comm->grid_dims = (int*)malloc(ndims*sizeof(int));
+    comm->grid_comms = (MPI_Comm*)malloc(ndims*sizeof(MPI_Comm));
+
+    int stride = num_procs;
+    int coord;
+    for (int i = 0; i < ndims; i++)
+    {
+        comm->grid_dims[i] = dims[i];
+        stride /= dims[i];
+        coord = (rank / stride) % dims[i];
+        MPI_Comm_split(comm->global_comm,
+                rank - coord*stride,
+                coord,
+                &(comm->grid_comms[i]));
+    }
+
+    return MPI_SUCCESS;
+}
+
+void MPIX_Comm_grid_free(MPIX_Comm* comm)
+{
+    for (int i = 0; i < comm->grid_ndims; i++)
+        MPI_Comm_free(&(comm->grid_comms[i]));
+    free(comm->grid_dims);
+    free(comm->grid_comms);
+
+    comm->grid_ndims = 0;
+    comm->grid_dims = NULL;
+    comm->grid_comms = NULL;
+}
+
 int get_node(const MPIX_Comm* data, const int proc)
 {
     return proc / data->ppn;
@@ -69,6 +145,9 @@ void update_locality(MPIX_Comm* comm_dist_graph, int ppn)
     MPI_Comm_rank(comm_dist_graph->global_comm, &rank);
     MPI_Comm_size(comm_dist_graph->global_comm, &num_procs);
 
+    // Cached locality-aware requests use the old local_comm
+    neighbor_cache_clear(comm_dist_graph);
+
     if (comm_dist_graph->local_comm != MPI_COMM_NULL)
         MPI_Comm_free(&(comm_dist_graph->local_comm));
     if (comm_dist_graph->group_comm != MPI_COMM_NULL)
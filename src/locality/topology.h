@@ -23,11 +23,43 @@ typedef struct _MPIX_Comm
     int num_nodes;
     int rank_node;
     int ppn;
+
+    // Neighbor lists of neighbor_comm, cached at creation
+    // (weights are NULL when the graph is unweighted)
+    int indegree;
+    int outdegree;
+    int* sources;
+    int* sourceweights;
+    int* destinations;
+    int* destweights;
+
+    // Reordered graph (MPIX_Dist_graph_create_adjacent) : the vertex
+    // given by rank r of comm_old is hosted by rank reorder_perm[r]
+    // (NULL unless reordered)
+    int* reorder_perm;
+
+    // Requests reused by the blocking neighbor collectives
+    struct _NeighborCache* neighbor_cache;
+
+    // Last tag offset given to a locality-aware request : requests on 
+    // this comm in flight together never match each other's messages
+    int locality_tag_offset;
+
+    // Virtual grid (multi-dimensional collectives)
+    int grid_ndims;
+    int* grid_dims;
+    MPI_Comm* grid_comms;
 } MPIX_Comm;
 
 int MPIX_Comm_init(MPIX_Comm** comm_dist_graph_ptr, MPI_Comm global_comm);
 int MPIX_Comm_free(MPIX_Comm* comm_dist_graph);
 
+// Virtual d-dimensional grid of ranks (dimension 0 varies slowest)
+// Zero entries of dims are filled in : the last dimension defaults
+// to PPN, and the remaining ones are factored with MPI_Dims_create
+int MPIX_Comm_grid_init(MPIX_Comm* comm, int ndims, int dims[]);
+void MPIX_Comm_grid_free(MPIX_Comm* comm);
+
 int get_node(const MPIX_Comm* data, const int proc);
 int get_local_proc(const MPIX_Comm* data, const int proc);
 int get_global_proc(const MPIX_Comm* data, const int node, const int local_proc);
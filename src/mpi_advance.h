@@ -10,8 +10,12 @@
 
 #include "collective/collective.h"
 #include "collective/allgather.h"
+#include "collective/sparse_coll.h"
 
 #include "neighborhood/dist_graph.h"
 #include "neighborhood/neighbor.h"
+#include "neighborhood/neighbor_cache.h"
+#include "neighborhood/neighbor_plan.h"
+#include "neighborhood/neighbor_reverse.h"
 
 #endif
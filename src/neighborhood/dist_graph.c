@@ -1,4 +1,276 @@
 #include "dist_graph.h"
+#include "utils.h"
+
+#define REORDER_TAG 48201
+
+typedef struct _VertexWeight
+{
+    long weight;
+    int vertex;
+} VertexWeight;
+
+// Heaviest first (lowest vertex on ties)
+static int cmp_vertex_weight(const void* a, const void* b)
+{
+    const VertexWeight* va = (const VertexWeight*)a;
+    const VertexWeight* vb = (const VertexWeight*)b;
+    if (va->weight != vb->weight)
+        return va->weight < vb->weight ? 1 : -1;
+    return va->vertex - vb->vertex;
+}
+
+void map_graph_to_nodes(int n, const int* adj_ptr, const int* adj,
+        const long* weights, int ppn, int* perm)
+{
+    // Seeds, heaviest vertices first
+    VertexWeight* order = (VertexWeight*)malloc((n+1)*sizeof(VertexWeight));
+    for (int v = 0; v < n; v++)
+    {
+        order[v].vertex = v;
+        order[v].weight = 0;
+        for (int j = adj_ptr[v]; j < adj_ptr[v+1]; j++)
+            order[v].weight += weights[j];
+    }
+    qsort(order, n, sizeof(VertexWeight), cmp_vertex_weight);
+
+    // Unmapped vertices connected to the node being filled, and the
+    // weight of their edges to it
+    long* gain = (long*)calloc(n+1, sizeof(long));
+    char* mapped = (char*)calloc(n+1, sizeof(char));
+    char* in_frontier = (char*)calloc(n+1, sizeof(char));
+    int* frontier = (int*)malloc((n+1)*sizeof(int));
+
+    int rank = 0;
+    int next_seed = 0;
+    int capacity, n_frontier, best, v, u;
+    while (rank < n)
+    {
+        capacity = n - rank < ppn ? n - rank : ppn;
+        n_frontier = 0;
+        for (int c = 0; c < capacity; c++)
+        {
+            best = -1;
+            for (int f = 0; f < n_frontier; f++)
+            {
+                v = frontier[f];
+                if (mapped[v])
+                {
+                    frontier[f--] = frontier[--n_frontier];
+                    continue;
+                }
+                if (best < 0 || gain[v] > gain[best]
+                        || (gain[v] == gain[best] && v < best))
+                    best = v;
+            }
+
+            // Nothing connected left : start from the next heaviest vertex
+            if (best < 0)
+            {
+                while (mapped[order[next_seed].vertex])
+                    next_seed++;
+                best = order[next_seed].vertex;
+            }
+
+            mapped[best] = 1;
+            perm[best] = rank++;
+            for (int j = adj_ptr[best]; j < adj_ptr[best+1]; j++)
+            {
+                u = adj[j];
+                if (mapped[u])
+                    continue;
+                gain[u] += weights[j];
+                if (!in_frontier[u])
+                {
+                    in_frontier[u] = 1;
+                    frontier[n_frontier++] = u;
+                }
+            }
+        }
+
+        for (int f = 0; f < n_frontier; f++)
+        {
+            gain[frontier[f]] = 0;
+            in_frontier[frontier[f]] = 0;
+        }
+    }
+
+    free(order);
+    free(gain);
+    free(mapped);
+    free(in_frontier);
+    free(frontier);
+}
+
+// Weight of edges between vertices perm maps to different nodes
+static long off_node_weight(int n, const int* adj_ptr, const int* adj,
+        const long* weights, int ppn, const int* perm)
+{
+    long weight = 0;
+    for (int v = 0; v < n; v++)
+        for (int j = adj_ptr[v]; j < adj_ptr[v+1]; j++)
+            if (perm[v] / ppn != perm[adj[j]] / ppn)
+                weight += weights[j];
+    return weight;
+}
+
+static int is_weighted(const int weights[])
+{
+    return weights != MPI_UNWEIGHTED && weights != MPI_WEIGHTS_EMPTY;
+}
+
+// Gather every rank's destinations (and weights) on rank 0, which maps
+// the symmetrized graph onto nodes of ppn ranks, keeping the identity
+// unless it lowers off-node weight (collective)
+static void reorder_graph(MPI_Comm comm, int outdegree, const int destinations[],
+        const int destweights[], int ppn, int* perm)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    int* weights = (int*)malloc((outdegree+1)*sizeof(int));
+    for (int i = 0; i < outdegree; i++)
+        weights[i] = is_weighted(destweights) ? destweights[i] : 1;
+
+    int* counts = NULL;
+    int* displs = NULL;
+    int* edges = NULL;
+    int* edge_weights = NULL;
+    if (rank == 0)
+    {
+        counts = (int*)malloc(num_procs*sizeof(int));
+        displs = (int*)malloc((num_procs+1)*sizeof(int));
+    }
+    MPI_Gather(&outdegree, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+    if (rank == 0)
+    {
+        displs[0] = 0;
+        for (int i = 0; i < num_procs; i++)
+            displs[i+1] = displs[i] + counts[i];
+        edges = (int*)malloc((displs[num_procs]+1)*sizeof(int));
+        edge_weights = (int*)malloc((displs[num_procs]+1)*sizeof(int));
+    }
+    MPI_Gatherv(destinations, outdegree, MPI_INT, edges, counts, displs,
+            MPI_INT, 0, comm);
+    MPI_Gatherv(weights, outdegree, MPI_INT, edge_weights, counts, displs,
+            MPI_INT, 0, comm);
+    free(weights);
+
+    if (rank == 0)
+    {
+        // Each edge in both directions
+        int n_edges = displs[num_procs];
+        int* adj_ptr = (int*)calloc(num_procs+1, sizeof(int));
+        int* adj = (int*)malloc((2*n_edges+1)*sizeof(int));
+        long* adj_weights = (long*)malloc((2*n_edges+1)*sizeof(long));
+        int* pos = (int*)malloc((num_procs+1)*sizeof(int));
+        int v;
+        for (int u = 0; u < num_procs; u++)
+            for (int j = displs[u]; j < displs[u+1]; j++)
+            {
+                adj_ptr[u+1]++;
+                adj_ptr[edges[j]+1]++;
+            }
+        for (int u = 0; u < num_procs; u++)
+        {
+            adj_ptr[u+1] += adj_ptr[u];
+            pos[u] = adj_ptr[u];
+        }
+        for (int u = 0; u < num_procs; u++)
+            for (int j = displs[u]; j < displs[u+1]; j++)
+            {
+                v = edges[j];
+                adj[pos[u]] = v;
+                adj_weights[pos[u]++] = edge_weights[j];
+                adj[pos[v]] = u;
+                adj_weights[pos[v]++] = edge_weights[j];
+            }
+
+        map_graph_to_nodes(num_procs, adj_ptr, adj, adj_weights, ppn, perm);
+        for (int u = 0; u < num_procs; u++)
+            pos[u] = u;
+        if (off_node_weight(num_procs, adj_ptr, adj, adj_weights, ppn, perm)
+                >= off_node_weight(num_procs, adj_ptr, adj, adj_weights, ppn, pos))
+            for (int u = 0; u < num_procs; u++)
+                perm[u] = u;
+
+        free(adj_ptr);
+        free(adj);
+        free(adj_weights);
+        free(pos);
+        free(counts);
+        free(displs);
+        free(edges);
+        free(edge_weights);
+    }
+    MPI_Bcast(perm, num_procs, MPI_INT, 0, comm);
+}
+
+// Send this rank's neighbor lists (renumbered through perm) to the rank
+// hosting its vertex, and receive those of the vertex this rank hosts
+static void migrate_vertex(MPI_Comm comm, const int* perm,
+        int indegree, const int sources[], const int sourceweights[],
+        int outdegree, const int destinations[], const int destweights[],
+        int* new_indegree, int** new_sources, int** new_sourceweights,
+        int* new_outdegree, int** new_destinations, int** new_destweights)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    int host = perm[rank];
+    int vertex = 0;
+    for (int i = 0; i < num_procs; i++)
+        if (perm[i] == rank)
+            vertex = i;
+
+    int sizes[4] = {indegree, outdegree, is_weighted(sourceweights),
+            is_weighted(destweights)};
+    int new_sizes[4];
+    MPI_Sendrecv(sizes, 4, MPI_INT, host, REORDER_TAG,
+            new_sizes, 4, MPI_INT, vertex, REORDER_TAG, comm, MPI_STATUS_IGNORE);
+
+    // Sources, source weights, destinations, destination weights
+    int* lists = (int*)malloc((2*indegree+2*outdegree+1)*sizeof(int));
+    for (int i = 0; i < indegree; i++)
+    {
+        lists[i] = perm[sources[i]];
+        lists[indegree+i] = sizes[2] ? sourceweights[i] : 1;
+    }
+    for (int i = 0; i < outdegree; i++)
+    {
+        lists[2*indegree+i] = perm[destinations[i]];
+        lists[2*indegree+outdegree+i] = sizes[3] ? destweights[i] : 1;
+    }
+
+    int n_in = new_sizes[0];
+    int n_out = new_sizes[1];
+    int* new_lists = (int*)malloc((2*n_in+2*n_out+1)*sizeof(int));
+    MPI_Sendrecv(lists, 2*indegree+2*outdegree, MPI_INT, host, REORDER_TAG,
+            new_lists, 2*n_in+2*n_out, MPI_INT, vertex, REORDER_TAG, comm,
+            MPI_STATUS_IGNORE);
+    free(lists);
+
+    *new_indegree = n_in;
+    *new_outdegree = n_out;
+    *new_sources = (int*)malloc((n_in+1)*sizeof(int));
+    *new_destinations = (int*)malloc((n_out+1)*sizeof(int));
+    *new_sourceweights = new_sizes[2] ? (int*)malloc((n_in+1)*sizeof(int)) : NULL;
+    *new_destweights = new_sizes[3] ? (int*)malloc((n_out+1)*sizeof(int)) : NULL;
+    for (int i = 0; i < n_in; i++)
+    {
+        (*new_sources)[i] = new_lists[i];
+        if (new_sizes[2])
+            (*new_sourceweights)[i] = new_lists[n_in+i];
+    }
+    for (int i = 0; i < n_out; i++)
+    {
+        (*new_destinations)[i] = new_lists[2*n_in+i];
+        if (new_sizes[3])
+            (*new_destweights)[i] = new_lists[2*n_in+n_out+i];
+    }
+    free(new_lists);
+}
 
 int MPIX_Dist_graph_create_adjacent(MPI_Comm comm_old, 
         int indegree,
@@ -18,11 +290,36 @@ int MPIX_Dist_graph_create_adjacent(MPI_Comm comm_old,
     MPIX_Comm* comm_dist_graph;
     MPIX_Comm_init(&comm_dist_graph, comm_old);
 
+    // Reorder : move vertices so heavy edges are on-node, then build
+    // the graph from the lists of the vertex this rank hosts
+    int* moved_sources = NULL;
+    int* moved_sourceweights = NULL;
+    int* moved_destinations = NULL;
+    int* moved_destweights = NULL;
+    int ppn = get_info_long(info, "mpix_reorder_ppn", comm_dist_graph->ppn);
+    if (reorder && ppn > 0 && ppn < num_procs)
+    {
+        comm_dist_graph->reorder_perm = (int*)malloc(num_procs*sizeof(int));
+        reorder_graph(comm_old, outdegree, destinations, destweights, ppn,
+                comm_dist_graph->reorder_perm);
+        migrate_vertex(comm_old, comm_dist_graph->reorder_perm,
+                indegree, sources, sourceweights,
+                outdegree, destinations, destweights,
+                &indegree, &moved_sources, &moved_sourceweights,
+                &outdegree, &moved_destinations, &moved_destweights);
+        sources = moved_sources;
+        sourceweights = moved_sourceweights ? moved_sourceweights : MPI_UNWEIGHTED;
+        destinations = moved_destinations;
+        destweights = moved_destweights ? moved_destweights : MPI_UNWEIGHTED;
+    }
+
     const int* s = sources;
     if (indegree == 0) s = MPI_WEIGHTS_EMPTY;
     const int* d = destinations;
     if (outdegree == 0) d = MPI_WEIGHTS_EMPTY;
 
+    // Never let MPI renumber ranks : the cached lists, reorder_perm and
+    // the locality-aware collectives all use ranks of global_comm
     MPI_Dist_graph_create_adjacent(comm_dist_graph->global_comm,
             indegree,
             s,
@@ -31,9 +328,46 @@ int MPIX_Dist_graph_create_adjacent(MPI_Comm comm_old,
             d,
             MPI_UNWEIGHTED,
             MPI_INFO_NULL, 
-            reorder,
+            0,
             &(comm_dist_graph->neighbor_comm));
 
+    // Cache neighbor lists so neighbor collectives never query them
+    // (ranks of global_comm, as the locality-aware collectives use)
+    comm_dist_graph->indegree = indegree;
+    comm_dist_graph->outdegree = outdegree;
+    if (indegree)
+    {
+        comm_dist_graph->sources = (int*)malloc(indegree*sizeof(int));
+        for (int i = 0; i < indegree; i++)
+            comm_dist_graph->sources[i] = sources[i];
+    }
+    if (outdegree)
+    {
+        comm_dist_graph->destinations = (int*)malloc(outdegree*sizeof(int));
+        for (int i = 0; i < outdegree; i++)
+            comm_dist_graph->destinations[i] = destinations[i];
+    }
+
+    if (indegree && sourceweights != MPI_UNWEIGHTED 
+            && sourceweights != MPI_WEIGHTS_EMPTY)
+    {
+        comm_dist_graph->sourceweights = (int*)malloc(indegree*sizeof(int));
+        for (int i = 0; i < indegree; i++)
+            comm_dist_graph->sourceweights[i] = sourceweights[i];
+    }
+    if (outdegree && destweights != MPI_UNWEIGHTED 
+            && destweights != MPI_WEIGHTS_EMPTY)
+    {
+        comm_dist_graph->destweights = (int*)malloc(outdegree*sizeof(int));
+        for (int i = 0; i < outdegree; i++)
+            comm_dist_graph->destweights[i] = destweights[i];
+    }
+
+    free(moved_sources);
+    free(moved_sourceweights);
+    free(moved_destinations);
+    free(moved_destweights);
+
     *comm_dist_graph_ptr = comm_dist_graph;
 
     return 0;
@@ -11,6 +11,13 @@ extern "C"
 {
 #endif
 
+// With reorder, the weighted graph (destination weights, or 1) is
+// gathered and mapped onto nodes so heavy edges are on-node : the
+// vertex given by rank r (its neighbor lists, and the data the caller
+// must move with it) is hosted by rank comm->reorder_perm[r], and each
+// rank's neighbor lists are those of the vertex it hosts, renumbered
+// Ranks keep their node order; the node size is the PPN, or the info
+// key "mpix_reorder_ppn" (e.g. to match update_locality in tests)
 int MPIX_Dist_graph_create_adjacent(MPI_Comm comm_old, 
         int indegree,
         const int sources[],
@@ -22,6 +29,13 @@ int MPIX_Dist_graph_create_adjacent(MPI_Comm comm_old,
         int reorder,
         MPIX_Comm** comm_dist_graph_ptr);
 
+// Greedy mapping of a symmetric weighted graph (CSR) of n vertices
+// onto nodes of ppn consecutive ranks (the last may hold fewer) : each
+// node grows from the heaviest unmapped vertex, adding the vertex most
+// heavily connected to it, and perm holds the rank of each vertex
+void map_graph_to_nodes(int n, const int* adj_ptr, const int* adj,
+        const long* weights, int ppn, int* perm);
+
 #ifdef __cplusplus
 }
 #endif
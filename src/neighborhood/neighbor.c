@@ -1,10 +1,23 @@
 #include "neighbor.h"
+#include "neighbor_cache.h"
+#include "neighbor_plan.h"
+#include "utils.h"
 
 void init_request(MPIX_Request** request_ptr)
 {
     MPIX_Request* request = (MPIX_Request*)malloc(sizeof(MPIX_Request));
 
     request->locality = NULL;
+    request->local_L_buffers.send = NULL;
+    request->local_L_buffers.recv = NULL;
+    request->local_S_buffers.send = NULL;
+    request->local_S_buffers.recv = NULL;
+    request->local_R_buffers.send = NULL;
+    request->local_R_buffers.recv = NULL;
+    request->global_buffers.send = NULL;
+    request->global_buffers.recv = NULL;
+    request->zero_copy = 0;
+    request->tag_offset = 0;
 
     request->local_L_n_msgs = 0;
     request->local_S_n_msgs = 0;
@@ -15,8 +28,47 @@ void init_request(MPIX_Request** request_ptr)
     request->local_S_requests = NULL;
     request->local_R_requests = NULL;
     request->global_requests = NULL;
+    request->local_L_msgs = NULL;
+    request->local_S_msgs = NULL;
+    request->local_R_msgs = NULL;
+    request->global_msgs = NULL;
 
     request->recv_size = 0;
+    request->block_size = 1;
+    request->send_index_stride = 1;
+    request->send_column_stride = 1;
+    request->recv_index_stride = 1;
+    request->recv_column_stride = 1;
+    request->pack = NULL;
+    request->unpack = NULL;
+
+    request->active = 0;
+    request->local_L_complete = 0;
+    request->local_S_complete = 0;
+    request->global_complete = 0;
+    request->local_R_complete = 0;
+    request->global_send_remaining = NULL;
+    request->local_R_send_remaining = NULL;
+    request->test_indices = NULL;
+
+    request->n_sources = 0;
+    request->source_remaining = NULL;
+    request->callback = NULL;
+    request->callback_data = NULL;
+
+    request->packed = NULL;
+    request->reverse = NULL;
+    request->shared = NULL;
+
+    request->direct_n_msgs = 0;
+    request->direct_n_recvs = 0;
+    request->direct_requests = NULL;
+    request->direct_msgs = NULL;
+    request->direct_sources = NULL;
+    request->direct_complete = 0;
+
+    request->n_datatypes = 0;
+    request->datatypes = NULL;
 
     *request_ptr = request;
 }
@@ -31,13 +83,49 @@ void destroy_request(MPIX_Request* request)
         free(request->local_R_requests);
     if (request->global_n_msgs)
         free(request->global_requests);
+    if (request->direct_n_msgs)
+        free(request->direct_requests);
+    free(request->direct_sources);
+    free(request->local_L_msgs);
+    free(request->local_S_msgs);
+    free(request->local_R_msgs);
+    free(request->global_msgs);
+    free(request->direct_msgs);
 
     if (request->locality)
         destroy_locality_comm(request->locality);
+    free_step_buffers(&(request->local_L_buffers));
+    free_step_buffers(&(request->local_S_buffers));
+    free_step_buffers(&(request->local_R_buffers));
+    free_step_buffers(&(request->global_buffers));
+
+    for (int i = 0; i < request->n_datatypes; i++)
+        MPI_Type_free(&(request->datatypes[i]));
+    free(request->datatypes);
+
+    free(request->global_send_remaining);
+    free(request->local_R_send_remaining);
+    free(request->test_indices);
+    free(request->source_remaining);
+
+    if (request->packed)
+        destroy_packed_buffers(request->packed);
+    if (request->reverse)
+        destroy_reverse_comm(request->reverse);
+    if (request->shared)
+        destroy_shared_staging(request->shared);
 
     free(request);
 }
 
+// Keep a derived datatype alive until the request is freed
+void add_request_datatype(MPIX_Request* request, MPI_Datatype type)
+{
+    request->datatypes = (MPI_Datatype*)realloc(request->datatypes,
+            (request->n_datatypes+1)*sizeof(MPI_Datatype));
+    request->datatypes[request->n_datatypes++] = type;
+}
+
 void allocate_requests(int n_requests, MPI_Request** request_ptr)
 {
     if (n_requests)
@@ -48,6 +136,95 @@ void allocate_requests(int n_requests, MPI_Request** request_ptr)
     else *request_ptr = NULL;
 }
 
+// Duplicate of type kept with the request (named types are returned)
+// for messages rebuilt after the caller may have freed its type
+MPI_Datatype keep_datatype(MPIX_Request* request, MPI_Datatype type)
+{
+    int num_integers, num_addresses, num_datatypes, combiner;
+    MPI_Type_get_envelope(type, &num_integers, &num_addresses, &num_datatypes,
+            &combiner);
+    if (combiner == MPI_COMBINER_NAMED)
+        return type;
+
+    MPI_Datatype dup_type;
+    MPI_Type_dup(type, &dup_type);
+    add_request_datatype(request, dup_type);
+    return dup_type;
+}
+
+// Elements of k vectors of type, laid out with index_stride and
+// column_stride (in extents of type), kept with the request
+// Returns type itself for a single contiguous vector
+MPI_Datatype block_datatype(MPIX_Request* request, MPI_Datatype type, int k,
+        int index_stride, int column_stride)
+{
+    if (k == 1 && index_stride == 1)
+        return type;
+
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(type, &lb, &extent);
+
+    MPI_Datatype vector_type, block_type;
+    MPI_Type_create_hvector(k, 1, column_stride*extent, type, &vector_type);
+    MPI_Type_create_resized(vector_type, 0, index_stride*extent, &block_type);
+    MPI_Type_free(&vector_type);
+    MPI_Type_commit(&block_type);
+    add_request_datatype(request, block_type);
+
+    return block_type;
+}
+
+// Persistent request of msg over buffer
+int bind_buffer_msg(const BufferMsg* msg, const void* buffer,
+        MPI_Request* request)
+{
+    if (msg->send)
+        return MPI_Send_init(&(((const char*)buffer)[msg->block_offset]), 
+                msg->count, msg->block_type, msg->peer, msg->tag, msg->comm, 
+                request);
+    return MPI_Recv_init(&(((char*)buffer)[msg->block_offset]), msg->count,
+            msg->block_type, msg->peer, msg->tag, msg->comm, request);
+}
+
+// Record msg (a send, or a recv) and build its persistent request
+// type must live as long as the request (see keep_datatype)
+int init_buffer_msg(BufferMsg* msg, int send, int user, const void* buffer,
+        MPI_Aint offset, int count, MPI_Datatype type, int peer, int tag,
+        MPI_Comm comm, MPI_Request* mpi_request)
+{
+    msg->send = send;
+    msg->user = user;
+    msg->offset = offset;
+    msg->count = count;
+    msg->type = type;
+    msg->peer = peer;
+    msg->tag = tag;
+    msg->comm = comm;
+    msg->block_type = type;
+    msg->block_offset = offset;
+
+    return bind_buffer_msg(msg, buffer, mpi_request);
+}
+
+// Allocate the staging buffer of data (elem_size bytes per index) into
+// buffer_ptr, returning the buffer its messages use : source instead, if
+// data is direct or (when alias is set) its indices are the identity
+char* init_staging_buffer(CommData* data, char* source, int alias,
+        int elem_size, char** buffer_ptr)
+{
+    *buffer_ptr = NULL;
+    if (alias && data->size_msgs && identity_indices(data))
+        data->direct = 1;
+    if (data->direct)
+        return source;
+
+    if (data->size_msgs)
+        *buffer_ptr = (char*)malloc((size_t)data->size_msgs*elem_size);
+    return *buffer_ptr;
+}
+
+// Persistent requests of one locality-aware step, recvs first then
+// sends, over elements of sendtype (recvtype) at send_ptr (recv_ptr)
 int init_communication(const void* sendbuffer,
         int n_sends,
         const int* send_procs,
@@ -60,27 +237,33 @@ int init_communication(const void* sendbuffer,
         MPI_Datatype recvtype,
         int tag,
         MPI_Comm comm,
+        MPIX_Request* request,
         int* n_request_ptr,
-        MPI_Request** request_ptr)
+        MPI_Request** request_ptr,
+        BufferMsg** msgs_ptr)
 {
-    int ierr, start, size;
-    int send_size, recv_size;
+    int ierr = 0;
+    int start, size;
+    MPI_Aint lb, send_extent, recv_extent;
+    MPI_Type_get_extent(sendtype, &lb, &send_extent);
+    MPI_Type_get_extent(recvtype, &lb, &recv_extent);
 
-    char* send_buffer = (char*) sendbuffer;
-    char* recv_buffer = (char*) recvbuffer;
-    MPI_Type_size(sendtype, &send_size);
-    MPI_Type_size(recvtype, &recv_size);
+    // Buffers aliasing sendbuf or recvbuf are rebound with them
+    int send_user = (sendbuffer == request->sendbuf);
+    int recv_user = (recvbuffer == request->recvbuf);
 
     MPI_Request* requests;
     *n_request_ptr = n_recvs+n_sends;
     allocate_requests(*n_request_ptr, &requests);
+    BufferMsg* msgs = (BufferMsg*)malloc((*n_request_ptr+1)*sizeof(BufferMsg));
 
     for (int i = 0; i < n_recvs; i++)
     {
         start = recv_ptr[i];
         size = recv_ptr[i+1] - start;
 
-        ierr += MPI_Recv_init(&(recv_buffer[start*recv_size]), 
+        ierr += init_buffer_msg(&(msgs[i]), 0, recv_user, recvbuffer,
+                (MPI_Aint)start*recv_extent, 
                 size, 
                 recvtype, 
                 recv_procs[i],
@@ -94,7 +277,8 @@ int init_communication(const void* sendbuffer,
         start = send_ptr[i];
         size = send_ptr[i+1] - start;
 
-        ierr += MPI_Send_init(&(send_buffer[start*send_size]),
+        ierr += init_buffer_msg(&(msgs[n_recvs+i]), 1, send_user, sendbuffer,
+                (MPI_Aint)start*send_extent,
                 size,
                 sendtype,
                 send_procs[i],
@@ -104,11 +288,86 @@ int init_communication(const void* sendbuffer,
     }
 
     *request_ptr = requests;
+    *msgs_ptr = msgs;
 
     return ierr;
 }
 
 
+// Zero-copy variant of init_communication for locality-aware plans
+// Each send reads send_data->indices of sendbuffer directly through an
+// indexed datatype (of sendtype), as does each recv into recvbuffer if
+// recv_indexed (otherwise recvs are contiguous, at recv_data->indptr)
+int init_indexed_communication(const void* sendbuffer,
+        CommData* send_data,
+        void* recvbuffer,
+        CommData* recv_data,
+        int recv_indexed,
+        MPI_Datatype sendtype,
+        MPI_Datatype recvtype,
+        int tag,
+        MPI_Comm comm,
+        MPIX_Request* request,
+        int* n_request_ptr,
+        MPI_Request** request_ptr,
+        BufferMsg** msgs_ptr)
+{
+    int ierr = 0;
+    int start, size;
+    MPI_Datatype type;
+
+    MPI_Aint lb, recv_extent;
+    MPI_Type_get_extent(recvtype, &lb, &recv_extent);
+    int send_user = (sendbuffer == request->sendbuf);
+    int recv_user = (recvbuffer == request->recvbuf);
+
+    MPI_Request* requests;
+    *n_request_ptr = recv_data->num_msgs+send_data->num_msgs;
+    allocate_requests(*n_request_ptr, &requests);
+    BufferMsg* msgs = (BufferMsg*)malloc((*n_request_ptr+1)*sizeof(BufferMsg));
+
+    for (int i = 0; i < recv_data->num_msgs; i++)
+    {
+        start = recv_data->indptr[i];
+        size = recv_data->indptr[i+1] - start;
+
+        if (recv_indexed)
+        {
+            MPI_Type_create_indexed_block(size, 1, &(recv_data->indices[start]),
+                    recvtype, &type);
+            MPI_Type_commit(&type);
+            add_request_datatype(request, type);
+            ierr += init_buffer_msg(&(msgs[i]), 0, recv_user, recvbuffer, 0, 1,
+                    type, recv_data->procs[i], tag, comm, &(requests[i]));
+        }
+        else
+            ierr += init_buffer_msg(&(msgs[i]), 0, recv_user, recvbuffer,
+                    (MPI_Aint)start*recv_extent, size, recvtype, 
+                    recv_data->procs[i], tag, comm, &(requests[i]));
+    }
+
+    for (int i = 0; i < send_data->num_msgs; i++)
+    {
+        start = send_data->indptr[i];
+        size = send_data->indptr[i+1] - start;
+
+        MPI_Type_create_indexed_block(size, 1, &(send_data->indices[start]),
+                sendtype, &type);
+        MPI_Type_commit(&type);
+        add_request_datatype(request, type);
+        ierr += init_buffer_msg(&(msgs[recv_data->num_msgs+i]), 1, send_user,
+                sendbuffer, 0, 1, type, send_data->procs[i], tag, comm, 
+                &(requests[recv_data->num_msgs+i]));
+    }
+
+    *request_ptr = requests;
+    *msgs_ptr = msgs;
+
+    return ierr;
+}
+
+// Blocking neighbor collectives reuse persistent requests cached in comm
+// (keyed on the full call signature, see neighbor_cache.h)
 int MPIX_Neighbor_alltoallw(
         const void* sendbuf,
         const int sendcounts[],
@@ -120,26 +379,46 @@ int MPIX_Neighbor_alltoallw(
         MPI_Datatype* recvtypes,
         MPIX_Comm* comm)
 {
-
-    MPIX_Request* request;
+    int ierr = 0;
+    int cached = 1;
     MPI_Status status;
 
-    int ierr = MPIX_Neighbor_alltoallw_init(
-            sendbuf,
-            sendcounts,
-            sdispls,
-            sendtypes,
-            recvbuf,
-            recvcounts,
-            rdispls,
-            recvtypes,
-            comm,
-            MPI_INFO_NULL,
-            &request);
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_ALLTOALLW);
+    neighbor_key_append(&key, &sendbuf, sizeof(void*));
+    neighbor_key_append(&key, sendcounts, comm->outdegree*sizeof(int));
+    neighbor_key_append(&key, sdispls, comm->outdegree*sizeof(MPI_Aint));
+    for (int i = 0; i < comm->outdegree; i++)
+        neighbor_key_append_type(&key, sendtypes[i]);
+    neighbor_key_append(&key, &recvbuf, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, rdispls, comm->indegree*sizeof(MPI_Aint));
+    for (int i = 0; i < comm->indegree; i++)
+        neighbor_key_append_type(&key, recvtypes[i]);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 0);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_alltoallw_init(
+                sendbuf,
+                sendcounts,
+                sdispls,
+                sendtypes,
+                recvbuf,
+                recvcounts,
+                rdispls,
+                recvtypes,
+                comm,
+                MPI_INFO_NULL,
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
 
     MPIX_Start(request);
     MPIX_Wait(request, &status);
-    MPIX_Request_free(request);
+    if (!cached)
+        MPIX_Request_free(request);
 
     return ierr;
 }
@@ -155,29 +434,100 @@ int MPIX_Neighbor_alltoallv(
         MPI_Datatype recvtype,
         MPIX_Comm* comm)
 {
+    int ierr = 0;
+    int cached = 1;
+    MPI_Status status;
 
-    MPIX_Request* request;
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_ALLTOALLV);
+    neighbor_key_append(&key, &sendbuffer, sizeof(void*));
+    neighbor_key_append(&key, sendcounts, comm->outdegree*sizeof(int));
+    neighbor_key_append(&key, sdispls, comm->outdegree*sizeof(int));
+    neighbor_key_append_type(&key, sendtype);
+    neighbor_key_append(&key, &recvbuffer, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, rdispls, comm->indegree*sizeof(int));
+    neighbor_key_append_type(&key, recvtype);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 0);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_alltoallv_init(sendbuffer,
+                sendcounts,
+                sdispls,
+                sendtype,
+                recvbuffer,
+                recvcounts,
+                rdispls,
+                recvtype,
+                comm,
+                MPI_INFO_NULL, 
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
+
+    MPIX_Start(request);
+    MPIX_Wait(request, &status);
+    if (!cached)
+        MPIX_Request_free(request);
+
+    return ierr;
+}
+
+int MPIX_Neighbor_alltoallv_c(
+        const void* sendbuffer,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm)
+{
+    int ierr = 0;
+    int cached = 1;
     MPI_Status status;
 
-    int ierr = MPIX_Neighbor_alltoallv_init(sendbuffer,
-            sendcounts,
-            sdispls,
-            sendtype,
-            recvbuffer,
-            recvcounts,
-            rdispls,
-            recvtype,
-            comm,
-            MPI_INFO_NULL, 
-            &request);
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_ALLTOALLV_C);
+    neighbor_key_append(&key, &sendbuffer, sizeof(void*));
+    neighbor_key_append(&key, sendcounts, comm->outdegree*sizeof(MPI_Count));
+    neighbor_key_append(&key, sdispls, comm->outdegree*sizeof(MPI_Aint));
+    neighbor_key_append_type(&key, sendtype);
+    neighbor_key_append(&key, &recvbuffer, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(MPI_Count));
+    neighbor_key_append(&key, rdispls, comm->indegree*sizeof(MPI_Aint));
+    neighbor_key_append_type(&key, recvtype);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 0);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_alltoallv_init_c(sendbuffer,
+                sendcounts,
+                sdispls,
+                sendtype,
+                recvbuffer,
+                recvcounts,
+                rdispls,
+                recvtype,
+                comm,
+                MPI_INFO_NULL, 
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
 
     MPIX_Start(request);
     MPIX_Wait(request, &status);
-    MPIX_Request_free(request);
+    if (!cached)
+        MPIX_Request_free(request);
 
     return ierr;
 }
 
+// Locality-aware setup is collective, so every rank must agree on a hit
 int MPIX_Neighbor_part_locality_alltoallv(
         const void* sendbuffer,
         const int sendcounts[],
@@ -189,25 +539,43 @@ int MPIX_Neighbor_part_locality_alltoallv(
         MPI_Datatype recvtype,
         MPIX_Comm* comm)
 {
-
-    MPIX_Request* request;
+    int ierr = 0;
+    int cached = 1;
     MPI_Status status;
 
-    int ierr = MPIX_Neighbor_part_locality_alltoallv_init(sendbuffer,
-            sendcounts,
-            sdispls,
-            sendtype,
-            recvbuffer,
-            recvcounts,
-            rdispls,
-            recvtype,
-            comm,
-            MPI_INFO_NULL, 
-            &request);
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_PART_LOCALITY_ALLTOALLV);
+    neighbor_key_append(&key, &sendbuffer, sizeof(void*));
+    neighbor_key_append(&key, sendcounts, comm->outdegree*sizeof(int));
+    neighbor_key_append(&key, sdispls, comm->outdegree*sizeof(int));
+    neighbor_key_append_type(&key, sendtype);
+    neighbor_key_append(&key, &recvbuffer, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, rdispls, comm->indegree*sizeof(int));
+    neighbor_key_append_type(&key, recvtype);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 1);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_part_locality_alltoallv_init(sendbuffer,
+                sendcounts,
+                sdispls,
+                sendtype,
+                recvbuffer,
+                recvcounts,
+                rdispls,
+                recvtype,
+                comm,
+                MPI_INFO_NULL, 
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
 
     MPIX_Start(request);
     MPIX_Wait(request, &status);
-    MPIX_Request_free(request);
+    if (!cached)
+        MPIX_Request_free(request);
 
     return ierr;
 }
@@ -225,27 +593,131 @@ int MPIX_Neighbor_locality_alltoallv(
         MPI_Datatype recvtype,
         MPIX_Comm* comm)
 {
+    int ierr = 0;
+    int cached = 1;
+    MPI_Status status;
 
-    MPIX_Request* request;
+    // Global indices are packed (message i's follow message i-1's,
+    // whatever the displacements), as init_locality reads them
+    long send_total = 0, recv_total = 0;
+    for (int i = 0; i < comm->outdegree; i++)
+        send_total += sendcounts[i];
+    for (int i = 0; i < comm->indegree; i++)
+        recv_total += recvcounts[i];
+
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_LOCALITY_ALLTOALLV);
+    neighbor_key_append(&key, &sendbuffer, sizeof(void*));
+    neighbor_key_append(&key, sendcounts, comm->outdegree*sizeof(int));
+    neighbor_key_append(&key, sdispls, comm->outdegree*sizeof(int));
+    neighbor_key_append(&key, global_sindices, send_total*sizeof(long));
+    neighbor_key_append_type(&key, sendtype);
+    neighbor_key_append(&key, &recvbuffer, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, rdispls, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, global_rindices, recv_total*sizeof(long));
+    neighbor_key_append_type(&key, recvtype);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 1);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_locality_alltoallv_init(sendbuffer,
+                sendcounts,
+                sdispls,
+                global_sindices,
+                sendtype,
+                recvbuffer,
+                recvcounts,
+                rdispls,
+                global_rindices,
+                recvtype,
+                comm,
+                MPI_INFO_NULL, 
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
+
+    MPIX_Start(request);
+    MPIX_Wait(request, &status);
+    if (!cached)
+        MPIX_Request_free(request);
+
+    return ierr;
+}
+
+int MPIX_Neighbor_allgather(
+        const void* sendbuffer,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm)
+{
+    int indegree = comm->indegree;
+    int* recvcounts = (int*)malloc((indegree+1)*sizeof(int));
+    int* displs = (int*)malloc((indegree+1)*sizeof(int));
+    for (int i = 0; i < indegree; i++)
+    {
+        recvcounts[i] = recvcount;
+        displs[i] = i*recvcount;
+    }
+
+    int ierr = MPIX_Neighbor_allgatherv(sendbuffer, sendcount, sendtype,
+            recvbuffer, recvcounts, displs, recvtype, comm);
+
+    free(recvcounts);
+    free(displs);
+
+    return ierr;
+}
+
+int MPIX_Neighbor_allgatherv(
+        const void* sendbuffer,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const int recvcounts[],
+        const int displs[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm)
+{
+    int ierr = 0;
+    int cached = 1;
     MPI_Status status;
 
-    int ierr = MPIX_Neighbor_locality_alltoallv_init(sendbuffer,
-            sendcounts,
-            sdispls,
-            global_sindices,
-            sendtype,
-            recvbuffer,
-            recvcounts,
-            rdispls,
-            global_rindices,
-            recvtype,
-            comm,
-            MPI_INFO_NULL, 
-            &request);
+    NeighborKey key;
+    init_neighbor_key(&key, NEIGHBOR_ALLGATHERV);
+    neighbor_key_append(&key, &sendbuffer, sizeof(void*));
+    neighbor_key_append(&key, &sendcount, sizeof(int));
+    neighbor_key_append_type(&key, sendtype);
+    neighbor_key_append(&key, &recvbuffer, sizeof(void*));
+    neighbor_key_append(&key, recvcounts, comm->indegree*sizeof(int));
+    neighbor_key_append(&key, displs, comm->indegree*sizeof(int));
+    neighbor_key_append_type(&key, recvtype);
+
+    MPIX_Request* request = neighbor_cache_lookup(comm, &key, 0);
+    if (request == NULL)
+    {
+        ierr = MPIX_Neighbor_allgatherv_init(sendbuffer,
+                sendcount,
+                sendtype,
+                recvbuffer,
+                recvcounts,
+                displs,
+                recvtype,
+                comm,
+                MPI_INFO_NULL, 
+                &request);
+        cached = neighbor_cache_insert(comm, &key, request);
+    }
+    free_neighbor_key(&key);
 
     MPIX_Start(request);
     MPIX_Wait(request, &status);
-    MPIX_Request_free(request);
+    if (!cached)
+        MPIX_Request_free(request);
 
     return ierr;
 }
@@ -268,57 +740,107 @@ int MPIX_Neighbor_alltoallv_init(
 {
     int tag = 349526;
 
-    int indegree, outdegree, weighted;
-    MPI_Dist_graph_neighbors_count(
-            comm->neighbor_comm, 
-            &indegree, 
-            &outdegree, 
-            &weighted);
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
+
+    MPIX_Request* request;
+    init_request(&request);
+
+    request->global_n_msgs = indegree+outdegree;
+    request->n_sources = indegree;
+    request->sendbuf = sendbuffer;
+    request->recvbuf = recvbuffer;
+    allocate_requests(request->global_n_msgs, &(request->global_requests));
+    request->global_msgs = (BufferMsg*)malloc((request->global_n_msgs+1)*sizeof(BufferMsg));
 
-    int* sources = NULL;
-    int* sourceweights = NULL;
-    int* destinations = NULL;
-    int* destweights = NULL;
+    int send_size, recv_size;
+    MPI_Type_size(sendtype, &send_size);
+    MPI_Type_size(recvtype, &recv_size);
+    MPI_Datatype stype = keep_datatype(request, sendtype);
+    MPI_Datatype rtype = keep_datatype(request, recvtype);
 
-    if (indegree)
+    for (int i = 0; i < indegree; i++)
     {
-        sources = (int*)malloc(indegree*sizeof(int));
-        sourceweights = (int*)malloc(indegree*sizeof(int));
+        init_buffer_msg(&(request->global_msgs[i]), 0, 1, recvbuffer,
+                (MPI_Aint)rdispls[i]*recv_size, 
+                recvcounts[i],
+                rtype, 
+                sources[i],
+                tag,
+                comm->neighbor_comm, 
+                &(request->global_requests[i]));
     }
 
-    if (outdegree)
+    for (int i = 0; i < outdegree; i++)
     {
-        destinations = (int*)malloc(outdegree*sizeof(int));
-        destweights = (int*)malloc(outdegree*sizeof(int));
+        init_buffer_msg(&(request->global_msgs[indegree+i]), 1, 1, sendbuffer,
+                (MPI_Aint)sdispls[i]*send_size,
+                sendcounts[i],
+                stype,
+                destinations[i],
+                tag,
+                comm->neighbor_comm,
+                &(request->global_requests[indegree+i]));
     }
 
-    MPI_Dist_graph_neighbors(
-            comm->neighbor_comm, 
-            indegree, 
-            sources, 
-            sourceweights,
-            outdegree, 
-            destinations, 
-            destweights);
+    *request_ptr = request;
+
+    return MPI_SUCCESS;
+}
+
+
+
+// Large-Count Standard Persistent Neighbor Alltoallv
+// Counts are MPI_Count, displacements are MPI_Aint (in elements)
+// Messages past INT_MAX elements are sent as a single derived datatype
+int MPIX_Neighbor_alltoallv_init_c(
+        const void* sendbuffer,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int tag = 349526;
+
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
 
     MPIX_Request* request;
     init_request(&request);
 
     request->global_n_msgs = indegree+outdegree;
+    request->n_sources = indegree;
+    request->sendbuf = sendbuffer;
+    request->recvbuf = recvbuffer;
     allocate_requests(request->global_n_msgs, &(request->global_requests));
+    request->global_msgs = (BufferMsg*)malloc((request->global_n_msgs+1)*sizeof(BufferMsg));
 
-    const char* send_buffer = (char*) sendbuffer;
-    char* recv_buffer = (char*) recvbuffer;
-
-    int send_size, recv_size;
-    MPI_Type_size(sendtype, &send_size);
-    MPI_Type_size(recvtype, &recv_size);
+    MPI_Aint lb, send_extent, recv_extent;
+    MPI_Type_get_extent(sendtype, &lb, &send_extent);
+    MPI_Type_get_extent(recvtype, &lb, &recv_extent);
+    MPI_Datatype stype = keep_datatype(request, sendtype);
+    MPI_Datatype rtype = keep_datatype(request, recvtype);
 
+    int count;
+    MPI_Datatype type;
     for (int i = 0; i < indegree; i++)
     {
-        MPI_Recv_init(&(recv_buffer[rdispls[i]*recv_size]), 
-                recvcounts[i],
-                recvtype, 
+        if (large_count_type(recvcounts[i], rtype, &count, &type))
+            add_request_datatype(request, type);
+        init_buffer_msg(&(request->global_msgs[i]), 0, 1, recvbuffer,
+                rdispls[i]*recv_extent, 
+                count,
+                type, 
                 sources[i],
                 tag,
                 comm->neighbor_comm, 
@@ -327,27 +849,24 @@ int MPIX_Neighbor_alltoallv_init(
 
     for (int i = 0; i < outdegree; i++)
     {
-        MPI_Send_init(&(send_buffer[sdispls[i]*send_size]),
-                sendcounts[i],
-                sendtype,
+        if (large_count_type(sendcounts[i], stype, &count, &type))
+            add_request_datatype(request, type);
+        init_buffer_msg(&(request->global_msgs[indegree+i]), 1, 1, sendbuffer,
+                sdispls[i]*send_extent,
+                count,
+                type,
                 destinations[i],
                 tag,
                 comm->neighbor_comm,
                 &(request->global_requests[indegree+i]));
     }
 
-    free(sources);
-    free(sourceweights);
-    free(destinations);
-    free(destweights);
-
     *request_ptr = request;
 
     return MPI_SUCCESS;
 }
 
 
-
 // Standard Persistent Neighbor Alltoallv
 // Extension takes array of requests instead of single request
 // 'requests' must be of size indegree+outdegree!
@@ -366,40 +885,27 @@ int MPIX_Neighbor_alltoallw_init(
 {
     int tag = 349526;
 
-    int indegree, outdegree, weighted;
-    MPI_Dist_graph_neighbors_count(
-            comm->neighbor_comm, 
-            &indegree, 
-            &outdegree, 
-            &weighted);
-
-    int sources[indegree];
-    int sourceweights[indegree];
-    int destinations[outdegree];
-    int destweights[outdegree];
-    MPI_Dist_graph_neighbors(
-            comm->neighbor_comm, 
-            indegree, 
-            sources, 
-            sourceweights,
-            outdegree, 
-            destinations, 
-            destweights);
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
 
     MPIX_Request* request;
     init_request(&request);
 
     request->global_n_msgs = indegree+outdegree;
+    request->n_sources = indegree;
+    request->sendbuf = sendbuffer;
+    request->recvbuf = recvbuffer;
     allocate_requests(request->global_n_msgs, &(request->global_requests));
-
-    const char* send_buffer = (const char*)(sendbuffer);
-    char* recv_buffer = (char*)(recvbuffer);
+    request->global_msgs = (BufferMsg*)malloc((request->global_n_msgs+1)*sizeof(BufferMsg));
 
     for (int i = 0; i < outdegree; i++)
     {
-        MPI_Send_init(&(send_buffer[sdispls[i]]),
+        init_buffer_msg(&(request->global_msgs[indegree+i]), 1, 1, sendbuffer,
+                sdispls[i],
                 sendcounts[i],
-                sendtypes[i],
+                keep_datatype(request, sendtypes[i]),
                 destinations[i],
                 tag,
                 comm->neighbor_comm,
@@ -408,9 +914,10 @@ int MPIX_Neighbor_alltoallw_init(
     }
     for (int i = 0; i < indegree; i++)
     {
-        MPI_Recv_init(&(recv_buffer[rdispls[i]]),
+        init_buffer_msg(&(request->global_msgs[i]), 0, 1, recvbuffer,
+                rdispls[i],
                 recvcounts[i], 
-                recvtypes[i], 
+                keep_datatype(request, recvtypes[i]), 
                 sources[i],
                 tag,
                 comm->neighbor_comm, 
@@ -424,10 +931,184 @@ int MPIX_Neighbor_alltoallw_init(
 }
 
 
-// Locality-Aware Extension to Persistent Neighbor Alltoallv
-// Needs global indices for each send and receive
-int MPIX_Neighbor_locality_alltoallv_init(
+// Standard Persistent Neighbor Allgather
+// Every out-neighbor receives the same sendcount elements of sendbuffer
+int MPIX_Neighbor_allgather_init(
         const void* sendbuffer,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int indegree = comm->indegree;
+    int* recvcounts = (int*)malloc((indegree+1)*sizeof(int));
+    int* displs = (int*)malloc((indegree+1)*sizeof(int));
+    for (int i = 0; i < indegree; i++)
+    {
+        recvcounts[i] = recvcount;
+        displs[i] = i*recvcount;
+    }
+
+    int ierr = MPIX_Neighbor_allgatherv_init(sendbuffer, sendcount, sendtype,
+            recvbuffer, recvcounts, displs, recvtype, comm, info, request_ptr);
+
+    free(recvcounts);
+    free(displs);
+
+    return ierr;
+}
+
+// Standard Persistent Neighbor Allgatherv
+int MPIX_Neighbor_allgatherv_init(
+        const void* sendbuffer,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const int recvcounts[],
+        const int displs[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int tag = 349526;
+
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
+
+    MPIX_Request* request;
+    init_request(&request);
+
+    request->global_n_msgs = indegree+outdegree;
+    request->n_sources = indegree;
+    request->sendbuf = sendbuffer;
+    request->recvbuf = recvbuffer;
+    allocate_requests(request->global_n_msgs, &(request->global_requests));
+    request->global_msgs = (BufferMsg*)malloc((request->global_n_msgs+1)*sizeof(BufferMsg));
+
+    int recv_size;
+    MPI_Type_size(recvtype, &recv_size);
+    MPI_Datatype stype = keep_datatype(request, sendtype);
+    MPI_Datatype rtype = keep_datatype(request, recvtype);
+
+    for (int i = 0; i < indegree; i++)
+    {
+        init_buffer_msg(&(request->global_msgs[i]), 0, 1, recvbuffer,
+                (MPI_Aint)displs[i]*recv_size, 
+                recvcounts[i],
+                rtype, 
+                sources[i],
+                tag,
+                comm->neighbor_comm, 
+                &(request->global_requests[i]));
+    }
+
+    for (int i = 0; i < outdegree; i++)
+    {
+        init_buffer_msg(&(request->global_msgs[indegree+i]), 1, 1, sendbuffer,
+                0,
+                sendcount,
+                stype,
+                destinations[i],
+                tag,
+                comm->neighbor_comm,
+                &(request->global_requests[indegree+i]));
+    }
+
+    *request_ptr = request;
+
+    return MPI_SUCCESS;
+}
+
+
+// Build the locality-aware requests without staging copies
+// Only the local_S and global recv buffers (aggregated data) remain
+// sendtype and recvtype are elements of the user buffers, stagetype
+// those of staging buffers
+void init_zero_copy_locality(MPIX_Request* request, MPI_Datatype sendtype,
+        MPI_Datatype recvtype, MPI_Datatype stagetype, const MPIX_Comm* comm)
+{
+    LocalityComm* locality = request->locality;
+    int elem_size;
+    MPI_Type_size(stagetype, &elem_size);
+    init_staging_buffer(locality->local_S_comm->recv_data, NULL, 0, elem_size,
+            &(request->local_S_buffers.recv));
+    init_staging_buffer(locality->global_comm->recv_data, NULL, 0, elem_size,
+            &(request->global_buffers.recv));
+
+    // Local L : sendbuf to recvbuf (unless through shared memory)
+    if (request->shared == NULL)
+        init_indexed_communication(request->sendbuf,
+                locality->local_L_comm->send_data,
+                request->recvbuf,
+                locality->local_L_comm->recv_data,
+                1,
+                sendtype,
+                recvtype,
+                locality->local_L_comm->tag + request->tag_offset,
+                comm->local_comm,
+                request,
+                &(request->local_L_n_msgs),
+                &(request->local_L_requests),
+                &(request->local_L_msgs));
+
+    // Local S : sendbuf to local_S recv buffer
+    init_indexed_communication(request->sendbuf,
+            locality->local_S_comm->send_data,
+            request->local_S_buffers.recv,
+            locality->local_S_comm->recv_data,
+            0,
+            sendtype,
+            stagetype,
+            locality->local_S_comm->tag + request->tag_offset,
+            comm->local_comm,
+            request,
+            &(request->local_S_n_msgs),
+            &(request->local_S_requests),
+            &(request->local_S_msgs));
+
+    // Global : local_S recv buffer to global recv buffer
+    init_indexed_communication(request->local_S_buffers.recv,
+            locality->global_comm->send_data,
+            request->global_buffers.recv,
+            locality->global_comm->recv_data,
+            0,
+            stagetype,
+            stagetype,
+            locality->global_comm->tag + request->tag_offset,
+            comm->global_comm,
+            request,
+            &(request->global_n_msgs),
+            &(request->global_requests),
+            &(request->global_msgs));
+
+    // Local R : global recv buffer to recvbuf
+    init_indexed_communication(request->global_buffers.recv,
+            locality->local_R_comm->send_data,
+            request->recvbuf,
+            locality->local_R_comm->recv_data,
+            1,
+            stagetype,
+            recvtype,
+            locality->local_R_comm->tag + request->tag_offset,
+            comm->local_comm,
+            request,
+            &(request->local_R_n_msgs),
+            &(request->local_R_requests),
+            &(request->local_R_msgs));
+}
+
+
+// Split messages into direct (off-node and larger than threshold bytes)
+// and aggregated ones, initializing the locality-aware plan for the
+// aggregated messages and persistent requests for the direct ones
+void init_hybrid_locality(const void* sendbuffer,
         const int sendcounts[],
         const int sdispls[],
         const long global_sindices[],
@@ -437,154 +1118,589 @@ int MPIX_Neighbor_locality_alltoallv_init(
         const int rdispls[],
         const long global_rindices[],
         MPI_Datatype recvtype,
+        long threshold,
         MPIX_Comm* comm,
-        MPI_Info info,
-        MPIX_Request** request_ptr)
+        MPIX_Request* request)
 {
+    int tag = 826345;
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
 
-    int tag = 304591;
-    int indegree, outdegree, weighted;
-    MPI_Dist_graph_neighbors_count(
-            comm->neighbor_comm, 
-            &indegree, 
-            &outdegree, 
-            &weighted);
+    int send_size, recv_size;
+    MPI_Type_size(sendtype, &send_size);
+    MPI_Type_size(recvtype, &recv_size);
 
-    int* sources = NULL;
-    int* sourceweights = NULL;
-    int* destinations = NULL;
-    int* destweights = NULL;
+    // Aggregated messages (subsets of the neighbor lists)
+    int n_sends = 0, n_recvs = 0;
+    int* send_procs = (int*)malloc((outdegree+1)*sizeof(int));
+    int* send_ptr = (int*)malloc((outdegree+1)*sizeof(int));
+    int* send_counts = (int*)malloc((outdegree+1)*sizeof(int));
+    int* recv_procs = (int*)malloc((indegree+1)*sizeof(int));
+    int* recv_ptr = (int*)malloc((indegree+1)*sizeof(int));
+    int* recv_counts = (int*)malloc((indegree+1)*sizeof(int));
 
-    if (indegree)
+    long send_total = 0, recv_total = 0;
+    for (int i = 0; i < outdegree; i++)
+        send_total += sendcounts[i];
+    for (int i = 0; i < indegree; i++)
+        recv_total += recvcounts[i];
+    long* send_indices = (long*)malloc((send_total+1)*sizeof(long));
+    long* recv_indices = (long*)malloc((recv_total+1)*sizeof(long));
+
+    int* direct_sends = (int*)malloc((outdegree+1)*sizeof(int));
+    int n_direct_sends = 0;
+    request->direct_sources = (int*)malloc((indegree+1)*sizeof(int));
+    request->direct_n_recvs = 0;
+
+    long ctr = 0, idx_ctr = 0;
+    for (int i = 0; i < outdegree; i++)
     {
-        sources = (int*)malloc(indegree*sizeof(int));
-        sourceweights = (int*)malloc(indegree*sizeof(int));
+        if (get_node(comm, destinations[i]) != comm->rank_node
+                && (long)sendcounts[i]*send_size > threshold)
+            direct_sends[n_direct_sends++] = i;
+        else
+        {
+            send_procs[n_sends] = destinations[i];
+            send_ptr[n_sends] = sdispls[i];
+            send_counts[n_sends++] = sendcounts[i];
+            for (int j = 0; j < sendcounts[i]; j++)
+                send_indices[idx_ctr++] = global_sindices[ctr+j];
+        }
+        ctr += sendcounts[i];
     }
 
-    if (outdegree)
+    ctr = 0;
+    idx_ctr = 0;
+    for (int i = 0; i < indegree; i++)
     {
-        destinations = (int*)malloc(outdegree*sizeof(int));
-        destweights = (int*)malloc(outdegree*sizeof(int));
+        if (get_node(comm, sources[i]) != comm->rank_node
+                && (long)recvcounts[i]*recv_size > threshold)
+            request->direct_sources[request->direct_n_recvs++] = i;
+        else
+        {
+            recv_procs[n_recvs] = sources[i];
+            recv_ptr[n_recvs] = rdispls[i];
+            recv_counts[n_recvs++] = recvcounts[i];
+            for (int j = 0; j < recvcounts[i]; j++)
+                recv_indices[idx_ctr++] = global_rindices[ctr+j];
+        }
+        ctr += recvcounts[i];
     }
 
-    MPI_Dist_graph_neighbors(
-            comm->neighbor_comm, 
-            indegree, 
-            sources, 
-            sourceweights,
-            outdegree, 
-            destinations, 
-            destweights);
-
-    MPIX_Request* request;
-    init_request(&request);
-
-    // Initialize Locality-Aware Communication Strategy (3-Step)
-    // E.G. Determine which processes talk to eachother at every step
-    // TODO : instead of mpi_comm, use comm
-    //        - will need to create local_comm in dist_graph_create_adjacent...
-    init_locality(outdegree, 
-            destinations, 
-            sdispls, 
-            sendcounts,
-            indegree, 
-            sources, 
-            rdispls,
-            recvcounts,
-            global_sindices,
-            global_rindices,
+    init_locality(n_sends, 
+            send_procs, 
+            send_ptr, 
+            send_counts,
+            n_recvs, 
+            recv_procs, 
+            recv_ptr,
+            recv_counts,
+            send_indices,
+            recv_indices,
             sendtype,
             recvtype,
-            comm, // communicator used in dist_graph_create_adjacent 
+            comm,
             request);
 
+    // Direct messages : recvs first, then sends
+    request->direct_n_msgs = request->direct_n_recvs + n_direct_sends;
+    allocate_requests(request->direct_n_msgs, &(request->direct_requests));
+
+    request->direct_msgs = (BufferMsg*)malloc((request->direct_n_msgs+1)*sizeof(BufferMsg));
+    MPI_Datatype stype = keep_datatype(request, sendtype);
+    MPI_Datatype rtype = keep_datatype(request, recvtype);
+    int src, dest;
+    for (int i = 0; i < request->direct_n_recvs; i++)
+    {
+        src = request->direct_sources[i];
+        init_buffer_msg(&(request->direct_msgs[i]), 0, 1, recvbuffer,
+                (MPI_Aint)rdispls[src]*recv_size,
+                recvcounts[src],
+                rtype,
+                sources[src],
+                tag,
+                comm->global_comm,
+                &(request->direct_requests[i]));
+    }
+    for (int i = 0; i < n_direct_sends; i++)
+    {
+        dest = direct_sends[i];
+        init_buffer_msg(&(request->direct_msgs[request->direct_n_recvs+i]), 1, 1, sendbuffer,
+                (MPI_Aint)sdispls[dest]*send_size,
+                sendcounts[dest],
+                stype,
+                destinations[dest],
+                tag,
+                comm->global_comm,
+                &(request->direct_requests[request->direct_n_recvs+i]));
+    }
+
+    free(send_procs);
+    free(send_ptr);
+    free(send_counts);
+    free(recv_procs);
+    free(recv_ptr);
+    free(recv_counts);
+    free(send_indices);
+    free(recv_indices);
+    free(direct_sends);
+}
+
+
+// Local L through a node-shared segment (collective over the local
+// communicator) : each rank stores its distinct local_L values, and
+// receives from each local_L source the position in its segment of
+// every value it needs
+// Leaves request->shared NULL (local_L uses messages) unless all ranks
+// of the local communicator share memory
+void init_shared_local_L(MPIX_Request* request, int elem_size,
+        const MPIX_Comm* comm)
+{
+    LocalityComm* locality = request->locality;
+    CommData* send_data = locality->local_L_comm->send_data;
+    CommData* recv_data = locality->local_L_comm->recv_data;
+
+    MPI_Comm shm_comm;
+    int ppn, shm_size;
+    MPI_Comm_size(comm->local_comm, &ppn);
+    MPI_Comm_split_type(comm->local_comm, MPI_COMM_TYPE_SHARED, 0,
+            MPI_INFO_NULL, &shm_comm);
+    MPI_Comm_size(shm_comm, &shm_size);
+    MPI_Comm_free(&shm_comm);
+    MPI_Allreduce(MPI_IN_PLACE, &shm_size, 1, MPI_INT, MPI_MIN, comm->local_comm);
+    if (shm_size < ppn)
+        return;
+
+    SharedStaging* shared = (SharedStaging*)malloc(sizeof(SharedStaging));
+    MPI_Comm_dup(comm->local_comm, &(shared->comm));
+    shared->barrier = MPI_REQUEST_NULL;
+    shared->phase = 0;
+
+    // Distinct sendbuf positions, and the segment slot of each send value
+    int n = send_data->size_msgs;
+    int max_index = -1;
+    for (int k = 0; k < n; k++)
+        if (send_data->indices[k] > max_index)
+            max_index = send_data->indices[k];
+    int* slot = (int*)malloc((max_index+2)*sizeof(int));
+    for (int i = 0; i <= max_index; i++)
+        slot[i] = -1;
+    int* send_offsets = (int*)malloc((n+1)*sizeof(int));
+    shared->indices = (int*)malloc((n+1)*sizeof(int));
+    shared->n_values = 0;
+    int idx;
+    for (int k = 0; k < n; k++)
+    {
+        idx = send_data->indices[k];
+        if (slot[idx] < 0)
+        {
+            slot[idx] = shared->n_values;
+            shared->indices[shared->n_values++] = idx;
+        }
+        send_offsets[k] = slot[idx];
+    }
+    free(slot);
+
+    MPI_Win_allocate_shared((MPI_Aint)shared->n_values*elem_size, elem_size,
+            MPI_INFO_NULL, shared->comm, &(shared->segment), &(shared->win));
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shared->win);
+
+    // Where each value this rank needs sits in its owner's segment
+    int n_recvs = recv_data->num_msgs;
+    int n_sends = send_data->num_msgs;
+    int tag = locality->local_L_comm->tag;
+    MPI_Aint segment_size;
+    int disp_unit;
+    shared->offsets = (int*)malloc((recv_data->size_msgs+1)*sizeof(int));
+    shared->source_segments = (char**)malloc((n_recvs+1)*sizeof(char*));
+    MPI_Request* requests = (MPI_Request*)malloc((n_recvs+n_sends+1)*sizeof(MPI_Request));
+    for (int m = 0; m < n_recvs; m++)
+    {
+        MPI_Win_shared_query(shared->win, recv_data->procs[m], &segment_size,
+                &disp_unit, &(shared->source_segments[m]));
+        MPI_Irecv(&(shared->offsets[recv_data->indptr[m]]),
+                recv_data->indptr[m+1] - recv_data->indptr[m], MPI_INT,
+                recv_data->procs[m], tag, shared->comm, &(requests[m]));
+    }
+    for (int m = 0; m < n_sends; m++)
+        MPI_Isend(&(send_offsets[send_data->indptr[m]]),
+                send_data->indptr[m+1] - send_data->indptr[m], MPI_INT,
+                send_data->procs[m], tag, shared->comm, &(requests[n_recvs+m]));
+    MPI_Waitall(n_recvs+n_sends, requests, MPI_STATUSES_IGNORE);
+
+    free(requests);
+    free(send_offsets);
+
+    request->shared = shared;
+}
+
+// Tag offsets cycle through 1 to MAX_TAG_OFFSET, staying below the gaps
+// between the plan's tags and those used while building plans, so up to
+// MAX_TAG_OFFSET locality-aware requests on a comm can be in flight together
+#define MAX_TAG_OFFSET 128
+
+static int next_tag_offset(MPIX_Comm* comm)
+{
+    comm->locality_tag_offset = comm->locality_tag_offset % MAX_TAG_OFFSET + 1;
+    return comm->locality_tag_offset;
+}
+
+// Persistent requests and staging buffers of a locality-aware plan
+// (request->locality, from init_locality, a saved plan or another 
+// request) over sendbuffer and recvbuffer
+int init_locality_requests(const void* sendbuffer,
+        void* recvbuffer,
+        int elem_size,
+        MPIX_Comm* comm,
+        int zero_copy,
+        MPIX_Request* request)
+{
     request->sendbuf = sendbuffer;
     request->recvbuf = recvbuffer;
-    MPI_Type_size(recvtype, &(request->recv_size));
+    request->zero_copy = zero_copy;
+    request->recv_size = elem_size;
+    request->tag_offset = next_tag_offset(comm);
+    int k = request->block_size;
+    select_pack_kernels(k*elem_size, &(request->pack), &(request->unpack));
+
+    // Every plan message holds elements of elem_size bytes (for each of
+    // the k vectors, together in staging buffers and messages)
+    MPI_Datatype elemtype;
+    MPI_Type_contiguous(elem_size, MPI_BYTE, &elemtype);
+    MPI_Type_commit(&elemtype);
+    add_request_datatype(request, elemtype);
+    MPI_Datatype stagetype = block_datatype(request, elemtype, k, k, 1);
+    MPI_Datatype sendtype = block_datatype(request, elemtype, k,
+            request->send_index_stride, request->send_column_stride);
+    MPI_Datatype recvtype = block_datatype(request, elemtype, k,
+            request->recv_index_stride, request->recv_column_stride);
+
+    // Zero-copy : messages read and write user buffers through
+    // indexed datatypes instead of staging copies
+    if (zero_copy)
+    {
+        init_zero_copy_locality(request, sendtype, recvtype, stagetype, comm);
+        return 0;
+    }
 
-    // Local L Communication
-    init_communication(request->locality->local_L_comm->send_data->buffer,
-            request->locality->local_L_comm->send_data->num_msgs,
-            request->locality->local_L_comm->send_data->procs,
-            request->locality->local_L_comm->send_data->indptr,
-            sendtype,
-            request->locality->local_L_comm->recv_data->buffer,
-            request->locality->local_L_comm->recv_data->num_msgs,
-            request->locality->local_L_comm->recv_data->procs,
-            request->locality->local_L_comm->recv_data->indptr,
-            recvtype,
-            request->locality->local_L_comm->tag,
-            comm->local_comm,
-            &(request->local_L_n_msgs),
-            &(request->local_L_requests));
+    // Buffers whose indices are the identity alias their source
+    LocalityComm* locality = request->locality;
+    int stage_size = k*elem_size;
+    char* local_S_recvbuf = init_staging_buffer(locality->local_S_comm->recv_data, 
+            NULL, 0, stage_size, &(request->local_S_buffers.recv));
+    char* global_recvbuf = init_staging_buffer(locality->global_comm->recv_data, 
+            NULL, 0, stage_size, &(request->global_buffers.recv));
+    char* local_S_sendbuf = init_staging_buffer(locality->local_S_comm->send_data, 
+            (char*)sendbuffer, 1, stage_size, &(request->local_S_buffers.send));
+    char* global_sendbuf = init_staging_buffer(locality->global_comm->send_data, 
+            local_S_recvbuf, 1, stage_size, &(request->global_buffers.send));
+    char* local_R_sendbuf = init_staging_buffer(locality->local_R_comm->send_data, 
+            global_recvbuf, 1, stage_size, &(request->local_R_buffers.send));
+    char* local_R_recvbuf = init_staging_buffer(locality->local_R_comm->recv_data, 
+            (char*)recvbuffer, 1, stage_size, &(request->local_R_buffers.recv));
+
+    // Local L Communication (unless through shared memory)
+    if (request->shared == NULL)
+    {
+        char* local_L_sendbuf = init_staging_buffer(locality->local_L_comm->send_data, 
+                (char*)sendbuffer, 1, stage_size, &(request->local_L_buffers.send));
+        char* local_L_recvbuf = init_staging_buffer(locality->local_L_comm->recv_data, 
+                (char*)recvbuffer, 1, stage_size, &(request->local_L_buffers.recv));
+        init_communication(local_L_sendbuf,
+                request->locality->local_L_comm->send_data->num_msgs,
+                request->locality->local_L_comm->send_data->procs,
+                request->locality->local_L_comm->send_data->indptr,
+                local_L_sendbuf == sendbuffer ? sendtype : stagetype,
+                local_L_recvbuf,
+                request->locality->local_L_comm->recv_data->num_msgs,
+                request->locality->local_L_comm->recv_data->procs,
+                request->locality->local_L_comm->recv_data->indptr,
+                local_L_recvbuf == recvbuffer ? recvtype : stagetype,
+                request->locality->local_L_comm->tag + request->tag_offset,
+                comm->local_comm,
+                request,
+                &(request->local_L_n_msgs),
+                &(request->local_L_requests),
+                &(request->local_L_msgs));
+    }
 
     // Local S Communication
-    init_communication(request->locality->local_S_comm->send_data->buffer,
+    init_communication(local_S_sendbuf,
             request->locality->local_S_comm->send_data->num_msgs,
             request->locality->local_S_comm->send_data->procs,
             request->locality->local_S_comm->send_data->indptr,
-            sendtype,
-            request->locality->local_S_comm->recv_data->buffer,
+            local_S_sendbuf == sendbuffer ? sendtype : stagetype,
+            local_S_recvbuf,
             request->locality->local_S_comm->recv_data->num_msgs,
             request->locality->local_S_comm->recv_data->procs,
             request->locality->local_S_comm->recv_data->indptr,
-            recvtype,
-            request->locality->local_S_comm->tag,
+            stagetype,
+            request->locality->local_S_comm->tag + request->tag_offset,
             comm->local_comm,
+            request,
             &(request->local_S_n_msgs),
-            &(request->local_S_requests));
+            &(request->local_S_requests),
+            &(request->local_S_msgs));
 
     // Global Communication
-    init_communication(request->locality->global_comm->send_data->buffer,
+    init_communication(global_sendbuf,
             request->locality->global_comm->send_data->num_msgs,
             request->locality->global_comm->send_data->procs,
             request->locality->global_comm->send_data->indptr,
-            sendtype,
-            request->locality->global_comm->recv_data->buffer,
+            stagetype,
+            global_recvbuf,
             request->locality->global_comm->recv_data->num_msgs,
             request->locality->global_comm->recv_data->procs,
             request->locality->global_comm->recv_data->indptr,
-            recvtype,
-            request->locality->global_comm->tag,
+            stagetype,
+            request->locality->global_comm->tag + request->tag_offset,
             comm->global_comm,
+            request,
             &(request->global_n_msgs),
-            &(request->global_requests));
+            &(request->global_requests),
+            &(request->global_msgs));
 
     // Local R Communication
-    init_communication(request->locality->local_R_comm->send_data->buffer,
+    init_communication(local_R_sendbuf,
             request->locality->local_R_comm->send_data->num_msgs,
             request->locality->local_R_comm->send_data->procs,
             request->locality->local_R_comm->send_data->indptr,
-            sendtype,
-            request->locality->local_R_comm->recv_data->buffer,
+            stagetype,
+            local_R_recvbuf,
             request->locality->local_R_comm->recv_data->num_msgs,
             request->locality->local_R_comm->recv_data->procs,
             request->locality->local_R_comm->recv_data->indptr,
-            recvtype,
-            request->locality->local_R_comm->tag,
+            local_R_recvbuf == recvbuffer ? recvtype : stagetype,
+            request->locality->local_R_comm->tag + request->tag_offset,
             comm->local_comm,
+            request,
             &(request->local_R_n_msgs),
-            &(request->local_R_requests));
+            &(request->local_R_requests),
+            &(request->local_R_msgs));
+
+    return 0;
+}
+
 
-    free(sources);
-    free(sourceweights);
-    free(destinations);
-    free(destweights);
+
+// Locality-Aware Extension to Persistent Neighbor Alltoallv
+// Needs global indices for each send and receive
+int MPIX_Neighbor_locality_alltoallv_init(
+        const void* sendbuffer,
+        const int sendcounts[],
+        const int sdispls[],
+        const long global_sindices[],
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const int recvcounts[],
+        const int rdispls[],
+        const long global_rindices[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+
+    int tag = 304591;
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+    const int* sources = comm->sources;
+    const int* destinations = comm->destinations;
+
+    MPIX_Request* request;
+    init_request(&request);
+
+    // Hybrid : off-node messages larger than the threshold (bytes)
+    // are sent directly, only the rest are aggregated
+    long threshold = get_info_long(info, "mpix_direct_threshold", -1);
+    if (threshold >= 0)
+    {
+        init_hybrid_locality(sendbuffer, sendcounts, sdispls, global_sindices, 
+                sendtype, recvbuffer, recvcounts, rdispls, global_rindices, recvtype,
+                threshold, comm, request);
+    }
+    else
+    {
+        // Initialize Locality-Aware Communication Strategy (3-Step)
+        // E.G. Determine which processes talk to eachother at every step
+        // TODO : instead of mpi_comm, use comm
+        //        - will need to create local_comm in dist_graph_create_adjacent...
+        init_locality(outdegree, 
+                destinations, 
+                sdispls, 
+                sendcounts,
+                indegree, 
+                sources, 
+                rdispls,
+                recvcounts,
+                global_sindices,
+                global_rindices,
+                sendtype,
+                recvtype,
+                comm, // communicator used in dist_graph_create_adjacent 
+                request);
+
+        // Identifies the plan if saved (MPIX_Request_save)
+        request->locality->pattern_hash = hash_locality_pattern(sendcounts, 
+                sdispls, global_sindices, sendtype, recvcounts, rdispls, 
+                global_rindices, recvtype, comm);
+    }
+    form_source_map(request->locality, indegree, recvcounts, rdispls);
+    request->n_sources = indegree;
+
+    int recv_size;
+    MPI_Type_size(recvtype, &recv_size);
+    if (get_info_flag(info, "mpix_shared_local"))
+        init_shared_local_L(request, recv_size, comm);
+    init_locality_requests(sendbuffer, recvbuffer, recv_size, comm, 
+            get_info_flag(info, "mpix_zero_copy"), request);
 
     *request_ptr = request;
 
     return 0;
-
 }
 
-int MPIX_Neighbor_part_locality_alltoallv_init(
+// Locality-Aware Extension to Persistent Neighbor Alltoallw
+// Each neighbor's message is packed (MPI_Pack) into a byte stream, which
+// is exchanged with the locality-aware alltoallv and unpacked through
+// recvtypes on completion.  The streams are split into units of the
+// largest power of two (up to 8 bytes) dividing every message size.
+int MPIX_Neighbor_locality_alltoallw_init(
         const void* sendbuffer,
         const int sendcounts[],
-        const int sdispls[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype* sendtypes,
+        void* recvbuffer,
+        const int recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype* recvtypes,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int rank; 
+    MPI_Comm_rank(comm->global_comm, &rank);
+
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
+
+    PackedBuffers* packed;
+    init_packed_buffers(&packed, outdegree, sendbuffer, sendcounts, sdispls, 
+            sendtypes, indegree, recvbuffer, recvcounts, rdispls, recvtypes);
+
+    // Unit size common to all messages on all ranks
+    int unit = 8;
+    for (int i = 0; i < outdegree; i++)
+        while ((packed->send_offsets[i+1] - packed->send_offsets[i]) % unit)
+            unit /= 2;
+    for (int i = 0; i < indegree; i++)
+        while ((packed->recv_offsets[i+1] - packed->recv_offsets[i]) % unit)
+            unit /= 2;
+    MPI_Allreduce(MPI_IN_PLACE, &unit, 1, MPI_INT, MPI_MIN, comm->global_comm);
+
+    int* send_unit_counts = (int*)malloc((outdegree+1)*sizeof(int));
+    int* send_unit_displs = (int*)malloc((outdegree+1)*sizeof(int));
+    int* recv_unit_counts = (int*)malloc((indegree+1)*sizeof(int));
+    int* recv_unit_displs = (int*)malloc((indegree+1)*sizeof(int));
+    for (int i = 0; i < outdegree; i++)
+    {
+        send_unit_displs[i] = packed->send_offsets[i] / unit;
+        send_unit_counts[i] = (packed->send_offsets[i+1] - packed->send_offsets[i]) / unit;
+    }
+    for (int i = 0; i < indegree; i++)
+    {
+        recv_unit_displs[i] = packed->recv_offsets[i] / unit;
+        recv_unit_counts[i] = (packed->recv_offsets[i+1] - packed->recv_offsets[i]) / unit;
+    }
+
+    // Number every packed unit globally, and find the numbers of recvd units
+    long send_size = packed->send_offsets[outdegree] / unit;
+    long recv_size = packed->recv_offsets[indegree] / unit;
+    long first_send;
+    MPI_Exscan(&send_size, &first_send, 1, MPI_LONG, MPI_SUM, comm->global_comm);
+    if (rank == 0) first_send = 0;
+
+    long* global_send_indices = (long*)malloc((send_size+1)*sizeof(long));
+    long* global_recv_indices = (long*)malloc((recv_size+1)*sizeof(long));
+    for (int i = 0; i < send_size; i++)
+        global_send_indices[i] = first_send + i;
+
+    MPIX_Request* index_request;
+    MPI_Status status;
+    MPIX_Neighbor_alltoallv_init(global_send_indices, send_unit_counts, send_unit_displs, 
+            MPI_LONG, global_recv_indices, recv_unit_counts, recv_unit_displs, MPI_LONG,
+            comm, MPI_INFO_NULL, &index_request);
+    MPIX_Start(index_request);
+    MPIX_Wait(index_request, &status);
+    MPIX_Request_free(index_request);
+
+    MPI_Datatype unit_type;
+    MPI_Type_contiguous(unit, MPI_BYTE, &unit_type);
+    MPI_Type_commit(&unit_type);
+
+    int err = MPIX_Neighbor_locality_alltoallv_init(packed->packed_send, 
+            send_unit_counts, send_unit_displs, global_send_indices, unit_type, 
+            packed->packed_recv, recv_unit_counts, recv_unit_displs, 
+            global_recv_indices, unit_type, comm, info, request_ptr);
+
+    add_request_datatype(*request_ptr, unit_type);
+    (*request_ptr)->packed = packed;
+
+    free(send_unit_counts);
+    free(send_unit_displs);
+    free(recv_unit_counts);
+    free(recv_unit_displs);
+    free(global_send_indices);
+    free(global_recv_indices);
+
+    return err;
+}
+
+// Locality-Aware Extension to Persistent Neighbor Allgather
+int MPIX_Neighbor_locality_allgather_init(
+        const void* sendbuffer,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int indegree = comm->indegree;
+    int* recvcounts = (int*)malloc((indegree+1)*sizeof(int));
+    int* displs = (int*)malloc((indegree+1)*sizeof(int));
+    for (int i = 0; i < indegree; i++)
+    {
+        recvcounts[i] = recvcount;
+        displs[i] = i*recvcount;
+    }
+
+    int ierr = MPIX_Neighbor_locality_allgatherv_init(sendbuffer, sendcount, 
+            sendtype, recvbuffer, recvcounts, displs, recvtype, comm, info,
+            request_ptr);
+
+    free(recvcounts);
+    free(displs);
+
+    return ierr;
+}
+
+// Locality-Aware Extension to Persistent Neighbor Allgatherv
+// Every out-neighbor receives the same payload, so each send message
+// carries identical global indices.  init_locality removes duplicates
+// per node : the payload crosses the network once per destination node
+// and is fanned out to the destination ranks by local_R.
+int MPIX_Neighbor_locality_allgatherv_init(
+        const void* sendbuffer,
+        int sendcount,
         MPI_Datatype sendtype,
         void* recvbuffer,
         const int recvcounts[],
-        const int rdispls[],
+        const int displs[],
         MPI_Datatype recvtype,
         MPIX_Comm* comm,
         MPI_Info info,
@@ -593,39 +1709,92 @@ int MPIX_Neighbor_part_locality_alltoallv_init(
     int rank; 
     MPI_Comm_rank(comm->global_comm, &rank);
 
-    int tag = 304591;
-    int indegree, outdegree, weighted;
-    MPI_Dist_graph_neighbors_count(
-            comm->neighbor_comm, 
-            &indegree, 
-            &outdegree, 
-            &weighted);
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
 
-    int* sources = NULL;
-    int* sourceweights = NULL;
-    int* destinations = NULL;
-    int* destweights = NULL;
+    // Number each rank's payload globally
+    long send_size = sendcount;
+    long first_send;
+    MPI_Exscan(&send_size, &first_send, 1, MPI_LONG, MPI_SUM, comm->global_comm);
+    if (rank == 0) first_send = 0;
 
-    if (indegree)
+    // Every message is the whole payload
+    int* sendcounts = (int*)malloc((outdegree+1)*sizeof(int));
+    int* sdispls = (int*)malloc((outdegree+1)*sizeof(int));
+    int* one_counts = (int*)malloc((outdegree+indegree+1)*sizeof(int));
+    int* one_displs = (int*)malloc((outdegree+indegree+1)*sizeof(int));
+    long* global_send_indices = (long*)malloc(((long)outdegree*sendcount+1)*sizeof(long));
+    for (int i = 0; i < outdegree; i++)
     {
-        sources = (int*)malloc(indegree*sizeof(int));
-        sourceweights = (int*)malloc(indegree*sizeof(int));
+        sendcounts[i] = sendcount;
+        sdispls[i] = 0;
+        for (int j = 0; j < sendcount; j++)
+            global_send_indices[(long)i*sendcount + j] = first_send + j;
     }
-    
-    if (outdegree)
+    for (int i = 0; i < outdegree + indegree; i++)
     {
-        destinations = (int*)malloc(outdegree*sizeof(int));
-        destweights = (int*)malloc(outdegree*sizeof(int));
+        one_counts[i] = 1;
+        one_displs[i] = 0;
     }
 
-    MPI_Dist_graph_neighbors(
-            comm->neighbor_comm, 
-            indegree, 
-            sources, 
-            sourceweights,
-            outdegree, 
-            destinations, 
-            destweights);
+    // Exchange the first global index of each neighbor's payload
+    long* first_recvs = (long*)malloc((indegree+1)*sizeof(long));
+    int* recv_displs = &(one_displs[outdegree]);
+    for (int i = 0; i < indegree; i++)
+        recv_displs[i] = i;
+
+    MPIX_Request* index_request;
+    MPI_Status status;
+    MPIX_Neighbor_alltoallv_init(&first_send, one_counts, one_displs, MPI_LONG, 
+            first_recvs, &(one_counts[outdegree]), recv_displs, MPI_LONG, comm,
+            MPI_INFO_NULL, &index_request);
+    MPIX_Start(index_request);
+    MPIX_Wait(index_request, &status);
+    MPIX_Request_free(index_request);
+
+    long recv_size = 0;
+    for (int i = 0; i < indegree; i++)
+        recv_size += recvcounts[i];
+    long* global_recv_indices = (long*)malloc((recv_size+1)*sizeof(long));
+    long ctr = 0;
+    for (int i = 0; i < indegree; i++)
+        for (int j = 0; j < recvcounts[i]; j++)
+            global_recv_indices[ctr++] = first_recvs[i] + j;
+
+    int err = MPIX_Neighbor_locality_alltoallv_init(sendbuffer, sendcounts, sdispls, 
+            global_send_indices, sendtype, recvbuffer, recvcounts, displs, 
+            global_recv_indices, recvtype, comm, info, request_ptr);
+
+    free(sendcounts);
+    free(sdispls);
+    free(one_counts);
+    free(one_displs);
+    free(first_recvs);
+    free(global_send_indices);
+    free(global_recv_indices);
+
+    return err;
+}
+
+int MPIX_Neighbor_part_locality_alltoallv_init(
+        const void* sendbuffer,
+        const int sendcounts[],
+        const int sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const int recvcounts[],
+        const int rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    int rank; 
+    MPI_Comm_rank(comm->global_comm, &rank);
+
+    int tag = 304591;
+    int indegree = comm->indegree;
+    int outdegree = comm->outdegree;
 
     // Make separate temporary displs incase sendbuffer/recvbuffer are not contiguous
     int* send_displs = (int*)malloc(outdegree*sizeof(int));
@@ -659,17 +1828,19 @@ int MPIX_Neighbor_part_locality_alltoallv_init(
         global_send_indices[i] = first_send + i;
 
 
-    MPIX_Neighbor_alltoallv(global_send_indices, sendcounts, send_displs, MPI_LONG, 
-            global_recv_indices, recvcounts, recv_displs, MPI_LONG, comm);
+    // Exchanged buffers are temporary, so bypass the request cache
+    MPIX_Request* index_request;
+    MPI_Status status;
+    MPIX_Neighbor_alltoallv_init(global_send_indices, sendcounts, send_displs, MPI_LONG, 
+            global_recv_indices, recvcounts, recv_displs, MPI_LONG, comm,
+            MPI_INFO_NULL, &index_request);
+    MPIX_Start(index_request);
+    MPIX_Wait(index_request, &status);
+    MPIX_Request_free(index_request);
 
     free(send_displs);
     free(recv_displs);
 
-    free(sources);
-    free(sourceweights);
-    free(destinations);
-    free(destweights);
-
     int err = MPIX_Neighbor_locality_alltoallv_init(sendbuffer, sendcounts, sdispls, 
             global_send_indices, sendtype, recvbuffer, recvcounts, rdispls, 
             global_recv_indices, recvtype, comm, info, request_ptr);
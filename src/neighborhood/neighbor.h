@@ -29,6 +29,20 @@ int MPIX_Neighbor_alltoallv(
         MPIX_Comm* comm);
 
 
+// Large-Count Neighbor Alltoallv
+// Counts are MPI_Count, displacements are MPI_Aint (in elements)
+int MPIX_Neighbor_alltoallv_c(
+        const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm);
+
+
 // Standard Neighbor Alltoallv
 // Extension takes array of requests instead of single request
 // 'requests' must be of size indegree+outdegree!
@@ -45,6 +59,27 @@ int MPIX_Neighbor_alltoallw(
 
 
 
+// Standard Neighbor Allgather(v)
+// The same sendcount elements of sendbuf go to every out-neighbor
+int MPIX_Neighbor_allgather(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm);
+int MPIX_Neighbor_allgatherv(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const int recvcounts[],
+        const int displs[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm);
+
+
 // Locality-Aware Extension to Persistent Neighbor Alltoallv
 // Needs global indices for each send and receive
 int MPIX_Neighbor_locality_alltoallv(
@@ -89,6 +124,22 @@ int MPIX_Neighbor_alltoallv_init(
         MPIX_Request** request_ptr);
 
 
+// Large-Count Standard Persistent Neighbor Alltoallv
+// Counts are MPI_Count, displacements are MPI_Aint (in elements)
+int MPIX_Neighbor_alltoallv_init_c(
+        const void* sendbuf,
+        const MPI_Count sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const MPI_Count recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+
+
 // Standard Persistent Neighbor Alltoallv
 // Extension takes array of requests instead of single request
 // 'requests' must be of size indegree+outdegree!
@@ -107,8 +158,35 @@ int MPIX_Neighbor_alltoallw_init(
 
 
 
+// Standard Persistent Neighbor Allgather(v)
+int MPIX_Neighbor_allgather_init(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+int MPIX_Neighbor_allgatherv_init(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const int recvcounts[],
+        const int displs[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+
+
 // Locality-Aware Extension to Persistent Neighbor Alltoallv
 // Needs global indices for each send and receive
+// Each request on comm uses its own tags, so independent requests can
+// be in flight together, but must be created in the same order on
+// every rank
 int MPIX_Neighbor_locality_alltoallv_init(
         const void* sendbuf,
         const int sendcounts[],
@@ -136,6 +214,47 @@ int MPIX_Neighbor_part_locality_alltoallv_init(
         MPI_Info info,
         MPIX_Request** request_ptr);
 
+// Locality-Aware Extension to Persistent Neighbor Alltoallw
+// Per-neighbor datatypes are packed into node-aggregated messages
+// and unpacked through recvtypes on completion
+int MPIX_Neighbor_locality_alltoallw_init(
+        const void* sendbuf,
+        const int sendcounts[],
+        const MPI_Aint sdispls[],
+        MPI_Datatype* sendtypes,
+        void* recvbuf,
+        const int recvcounts[],
+        const MPI_Aint rdispls[],
+        MPI_Datatype* recvtypes,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+
+// Locality-Aware Extension to Persistent Neighbor Allgather(v)
+// Each payload is sent once per destination node and redistributed
+// to the destination ranks within the node
+int MPIX_Neighbor_locality_allgather_init(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        int recvcount,
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+int MPIX_Neighbor_locality_allgatherv_init(
+        const void* sendbuf,
+        int sendcount,
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const int recvcounts[],
+        const int displs[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+
 
 void init_locality(const int n_sends, 
         const int* send_procs, 
@@ -149,7 +268,22 @@ void init_locality(const int n_sends,
         const long* global_recv_indices,
         const MPI_Datatype sendtype, 
         const MPI_Datatype recvtype,
-        const MPIX_Comm* mpix_comm,
+        MPIX_Comm* mpix_comm,
+        MPIX_Request* request);
+
+void init_request(MPIX_Request** request_ptr);
+void add_request_datatype(MPIX_Request* request, MPI_Datatype type);
+MPI_Datatype block_datatype(MPIX_Request* request, MPI_Datatype type, int k,
+        int index_stride, int column_stride);
+int bind_buffer_msg(const BufferMsg* msg, const void* buffer,
+        MPI_Request* request);
+void init_shared_local_L(MPIX_Request* request, int elem_size,
+        const MPIX_Comm* comm);
+int init_locality_requests(const void* sendbuffer,
+        void* recvbuffer,
+        int elem_size,
+        MPIX_Comm* comm,
+        int zero_copy,
         MPIX_Request* request);
 
 
@@ -0,0 +1,193 @@
+#include "neighbor_cache.h"
+#include <string.h>
+
+void init_neighbor_key(NeighborKey* key, int variant)
+{
+    key->data = NULL;
+    key->size = 0;
+    key->capacity = 0;
+    key->cacheable = 1;
+    neighbor_key_append(key, &variant, sizeof(int));
+}
+
+void neighbor_key_append(NeighborKey* key, const void* data, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+
+    if (key->size + bytes > key->capacity)
+    {
+        size_t capacity = key->capacity ? 2*key->capacity : 256;
+        while (capacity < key->size + bytes)
+            capacity *= 2;
+        key->data = (char*)realloc(key->data, capacity);
+        key->capacity = capacity;
+    }
+    memcpy(&(key->data[key->size]), data, bytes);
+    key->size += bytes;
+}
+
+void neighbor_key_append_type(NeighborKey* key, MPI_Datatype type)
+{
+    int n_ints, n_addrs, n_types, combiner;
+    MPI_Type_get_envelope(type, &n_ints, &n_addrs, &n_types, &combiner);
+    if (combiner != MPI_COMBINER_NAMED)
+        key->cacheable = 0;
+    neighbor_key_append(key, &type, sizeof(MPI_Datatype));
+}
+
+void free_neighbor_key(NeighborKey* key)
+{
+    free(key->data);
+    key->data = NULL;
+    key->size = 0;
+    key->capacity = 0;
+}
+
+// FNV-1a
+static unsigned long hash_neighbor_key(const NeighborKey* key)
+{
+    unsigned long hash = 14695981039346656037UL;
+    for (size_t i = 0; i < key->size; i++)
+    {
+        hash ^= (unsigned char)key->data[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+static NeighborCache* get_neighbor_cache(MPIX_Comm* comm)
+{
+    if (comm->neighbor_cache == NULL)
+    {
+        NeighborCache* cache = (NeighborCache*)malloc(sizeof(NeighborCache));
+        cache->max_entries = NEIGHBOR_CACHE_DEFAULT_SIZE;
+        cache->n_entries = 0;
+        cache->clock = 0;
+        cache->entries = (NeighborCacheEntry*)malloc(cache->max_entries*sizeof(NeighborCacheEntry));
+        comm->neighbor_cache = cache;
+    }
+    return comm->neighbor_cache;
+}
+
+static int find_entry(NeighborCache* cache, const NeighborKey* key, unsigned long hash)
+{
+    for (int i = 0; i < cache->n_entries; i++)
+    {
+        NeighborCacheEntry* entry = &(cache->entries[i]);
+        if (entry->hash == hash && entry->key.size == key->size
+                && memcmp(entry->key.data, key->data, key->size) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void remove_entry(NeighborCache* cache, int idx)
+{
+    free_neighbor_key(&(cache->entries[idx].key));
+    MPIX_Request_free(cache->entries[idx].request);
+    cache->entries[idx] = cache->entries[--cache->n_entries];
+}
+
+MPIX_Request* neighbor_cache_lookup(MPIX_Comm* comm, const NeighborKey* key,
+        int collective)
+{
+    NeighborCache* cache = get_neighbor_cache(comm);
+
+    int idx = -1;
+    if (cache->max_entries && key->cacheable)
+        idx = find_entry(cache, key, hash_neighbor_key(key));
+
+    if (collective)
+    {
+        int hit = idx >= 0;
+        MPI_Allreduce(MPI_IN_PLACE, &hit, 1, MPI_INT, MPI_MIN, comm->global_comm);
+        if (!hit) idx = -1;
+    }
+
+    if (idx < 0)
+        return NULL;
+
+    cache->entries[idx].last_used = ++cache->clock;
+    return cache->entries[idx].request;
+}
+
+int neighbor_cache_insert(MPIX_Comm* comm, NeighborKey* key,
+        MPIX_Request* request)
+{
+    NeighborCache* cache = get_neighbor_cache(comm);
+    if (cache->max_entries == 0 || !key->cacheable)
+        return 0;
+
+    unsigned long hash = hash_neighbor_key(key);
+
+    // Stale copy (collective miss while this rank hit)
+    int idx = find_entry(cache, key, hash);
+    if (idx >= 0)
+        remove_entry(cache, idx);
+
+    // Evict least recently used
+    if (cache->n_entries == cache->max_entries)
+    {
+        idx = 0;
+        for (int i = 1; i < cache->n_entries; i++)
+            if (cache->entries[i].last_used < cache->entries[idx].last_used)
+                idx = i;
+        remove_entry(cache, idx);
+    }
+
+    NeighborCacheEntry* entry = &(cache->entries[cache->n_entries++]);
+    entry->key = *key;
+    entry->hash = hash;
+    entry->last_used = ++cache->clock;
+    entry->request = request;
+
+    key->data = NULL;
+    key->size = 0;
+    key->capacity = 0;
+
+    return 1;
+}
+
+void neighbor_cache_clear(MPIX_Comm* comm)
+{
+    NeighborCache* cache = comm->neighbor_cache;
+    if (cache == NULL)
+        return;
+
+    while (cache->n_entries)
+        remove_entry(cache, cache->n_entries-1);
+}
+
+void neighbor_cache_free(MPIX_Comm* comm)
+{
+    if (comm->neighbor_cache == NULL)
+        return;
+
+    neighbor_cache_clear(comm);
+    free(comm->neighbor_cache->entries);
+    free(comm->neighbor_cache);
+    comm->neighbor_cache = NULL;
+}
+
+int MPIX_Comm_set_neighbor_cache_size(MPIX_Comm* comm, int max_entries)
+{
+    if (max_entries < 0)
+        return MPI_ERR_ARG;
+
+    NeighborCache* cache = get_neighbor_cache(comm);
+    while (cache->n_entries > max_entries)
+    {
+        int idx = 0;
+        for (int i = 1; i < cache->n_entries; i++)
+            if (cache->entries[i].last_used < cache->entries[idx].last_used)
+                idx = i;
+        remove_entry(cache, idx);
+    }
+
+    cache->entries = (NeighborCacheEntry*)realloc(cache->entries,
+            (max_entries ? max_entries : 1)*sizeof(NeighborCacheEntry));
+    cache->max_entries = max_entries;
+
+    return MPI_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#ifndef MPI_ADVANCE_NEIGHBOR_CACHE_H
+#define MPI_ADVANCE_NEIGHBOR_CACHE_H
+
+#include <mpi.h>
+#include <stdlib.h>
+#include "locality/topology.h"
+#include "persistent/persistent.h"
+
+// Declarations of C++ methods
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define NEIGHBOR_CACHE_DEFAULT_SIZE 8
+
+// Collective variants (first entry of every key)
+enum NeighborVariant
+{
+    NEIGHBOR_ALLTOALLV,
+    NEIGHBOR_ALLTOALLV_C,
+    NEIGHBOR_ALLTOALLW,
+    NEIGHBOR_LOCALITY_ALLTOALLV,
+    NEIGHBOR_PART_LOCALITY_ALLTOALLV,
+    NEIGHBOR_ALLGATHERV
+};
+
+// Serialized signature of a neighbor collective call
+// (variant, counts, displacements, datatype handles, buffer addresses,
+// and global indices for the locality-aware variants)
+// Calls with derived datatypes are never cached : MPI may reuse a freed
+// handle for a type with a different layout, which a handle alone
+// cannot tell apart
+typedef struct _NeighborKey
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+    int cacheable;
+} NeighborKey;
+
+typedef struct _NeighborCacheEntry
+{
+    NeighborKey key;
+    unsigned long hash;
+    unsigned long last_used;
+    MPIX_Request* request;
+} NeighborCacheEntry;
+
+// Persistent requests built by the blocking neighbor collectives,
+// reused when an identical call repeats (LRU eviction)
+typedef struct _NeighborCache
+{
+    int max_entries;
+    int n_entries;
+    unsigned long clock;
+    NeighborCacheEntry* entries;
+} NeighborCache;
+
+void init_neighbor_key(NeighborKey* key, int variant);
+void neighbor_key_append(NeighborKey* key, const void* data, size_t bytes);
+// Appends a datatype handle (derived types make the key uncacheable)
+void neighbor_key_append_type(NeighborKey* key, MPI_Datatype type);
+void free_neighbor_key(NeighborKey* key);
+
+// Returns the cached request matching key, or NULL (always NULL for
+// an uncacheable key)
+// If collective, a hit is only returned if every rank in the
+// communicator hits (required before collective setup is skipped)
+MPIX_Request* neighbor_cache_lookup(MPIX_Comm* comm, const NeighborKey* key,
+        int collective);
+
+// Stores request under key, taking ownership of both
+// Returns 0 (and takes nothing) if caching is disabled or the key is
+// uncacheable
+int neighbor_cache_insert(MPIX_Comm* comm, NeighborKey* key,
+        MPIX_Request* request);
+
+void neighbor_cache_clear(MPIX_Comm* comm);
+void neighbor_cache_free(MPIX_Comm* comm);
+
+// Maximum number of cached requests (0 disables caching)
+int MPIX_Comm_set_neighbor_cache_size(MPIX_Comm* comm, int max_entries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
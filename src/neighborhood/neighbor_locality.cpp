@@ -3,6 +3,57 @@
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <math.h>
+#include <climits>
+#include <assert.h>
+
+// Cost of a message in the node assignment, in bytes
+#define LOCALITY_MSG_COST_BYTES 2048
+
+// Flat open-addressing hash table from global index to position
+// (linear probing, at most half full, later inserts of a key win)
+struct GlobalIndexMap
+{
+    std::vector<long> keys;
+    std::vector<int> values;
+    unsigned long mask;
+
+    GlobalIndexMap(long n)
+    {
+        unsigned long capacity = 16;
+        while (capacity < 2*(unsigned long)n)
+            capacity *= 2;
+        keys.resize(capacity, LONG_MIN);
+        values.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    unsigned long slot(long key) const
+    {
+        return ((unsigned long)key * 0x9E3779B97F4A7C15UL) >> 17 & mask;
+    }
+
+    void insert(long key, int value)
+    {
+        unsigned long pos = slot(key);
+        while (keys[pos] != LONG_MIN && keys[pos] != key)
+            pos = (pos + 1) & mask;
+        keys[pos] = key;
+        values[pos] = value;
+    }
+
+    int find(long key) const
+    {
+        unsigned long pos = slot(key);
+        while (keys[pos] != key)
+        {
+            if (keys[pos] == LONG_MIN)
+                return -1;
+            pos = (pos + 1) & mask;
+        }
+        return values[pos];
+    }
+};
 
 /******************************************
  ****
@@ -10,28 +61,31 @@
  ****
  ******************************************/
 
+double fair_share_bytes(LocalityComm* locality, const int n_sends,
+        const int* send_procs, const int* sendcounts, const int send_size);
 void map_procs_to_nodes(LocalityComm* locality, const int orig_num_msgs,
-        const int* orig_procs, const int* orig_counts,
-        std::vector<int>& msg_nodes, std::vector<int>& msg_node_to_local,
-        bool incr);
+        const int* orig_procs, const int* orig_counts, const int type_size,
+        const double fair_share, std::vector<int>& orig_vnodes, 
+        std::map<int, int>& vnode_to_local, std::vector<double>& local_loads,
+        bool sends);
 void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
         const int* orig_send_ptr, const int* orig_sendcounts, const long* orig_send_indices,
-        const std::vector<int>& nodes_to_local, CommData* send_data,
-        CommData* recv_data, CommData* local_data,
+        const std::vector<int>& orig_vnodes, const std::map<int, int>& vnodes_to_local, 
+        CommData* send_data, CommData* recv_data, CommData* local_data,
         std::vector<int>& recv_idx_nodes,
         LocalityComm* locality, const int tag);
 void form_global_comm(CommData* local_data, CommData* global_data,
         std::vector<int>& local_data_nodes, const MPIX_Comm* mpix_comm, int tag);
 void update_global_comm(LocalityComm* locality);
-void form_global_map(const CommData* map_data, std::map<long, int>& global_map);
-void map_indices(CommData* idx_data, std::map<long, int>& global_map);
+void form_global_map(const CommData* map_data, GlobalIndexMap& global_map);
+void map_indices(CommData* idx_data, const GlobalIndexMap& global_map);
 void map_indices(CommData* idx_data, const CommData* map_data);
 void remove_duplicates(CommData* comm_pkg);
 void remove_duplicates(CommPkg* data);
 void remove_duplicates(LocalityComm* locality);
 void update_indices(LocalityComm* locality, 
-        std::map<long, int>& send_global_to_local,
-        std::map<long, int>& recv_global_to_local);
+        const GlobalIndexMap& send_global_to_local,
+        const GlobalIndexMap& recv_global_to_local);
 
 
 /******************************************
@@ -54,7 +108,7 @@ void init_locality(const int n_sends,
         const long* global_recv_indices,
         const MPI_Datatype sendtype, 
         const MPI_Datatype recvtype,
-        const MPIX_Comm* mpix_comm,
+        MPIX_Comm* mpix_comm,
         MPIX_Request* request)
 {
     // Get MPI Information
@@ -66,15 +120,27 @@ void init_locality(const int n_sends,
     LocalityComm* locality_comm;
     init_locality_comm(&locality_comm, mpix_comm, sendtype, recvtype);
 
-    // Find global send nodes
-    std::vector<int> send_nodes;
-    std::vector<int> send_node_to_local;
+    int send_size, recv_size;
+    MPI_Type_size(sendtype, &send_size);
+    MPI_Type_size(recvtype, &recv_size);
+
+    // Node pairs heavier than the average rank's share are split
+    double fair_share = fair_share_bytes(locality_comm, n_sends, send_procs, 
+            sendcounts, send_size);
+
+    // Find global send nodes (loads of local ranks carry over to recvs)
+    std::vector<int> send_vnodes;
+    std::map<int, int> send_vnode_to_local;
+    std::vector<double> local_loads;
     map_procs_to_nodes(locality_comm, 
             n_sends, 
             send_procs, 
             sendcounts,
-            send_nodes, 
-            send_node_to_local, 
+            send_size,
+            fair_share,
+            send_vnodes, 
+            send_vnode_to_local, 
+            local_loads,
             true);
 
     // Form initial send local comm
@@ -84,7 +150,8 @@ void init_locality(const int n_sends,
             send_indptr, 
             sendcounts,
             global_send_indices, 
-            send_node_to_local,
+            send_vnodes,
+            send_vnode_to_local,
             locality_comm->local_S_comm->send_data, 
             locality_comm->local_S_comm->recv_data,
             locality_comm->local_L_comm->send_data, 
@@ -100,14 +167,17 @@ void init_locality(const int n_sends,
             93284);
 
     // Find global recv nodes
-    std::vector<int> recv_nodes;
-    std::vector<int> recv_node_to_local;
+    std::vector<int> recv_vnodes;
+    std::map<int, int> recv_vnode_to_local;
     map_procs_to_nodes(locality_comm, 
             n_recvs, 
             recv_procs, 
             recvcounts,
-            recv_nodes, 
-            recv_node_to_local, 
+            recv_size,
+            fair_share,
+            recv_vnodes, 
+            recv_vnode_to_local, 
+            local_loads,
             false);
 
     // Form final recv local comm
@@ -117,7 +187,8 @@ void init_locality(const int n_sends,
             recv_indptr, 
             recvcounts,
             global_recv_indices,
-            recv_node_to_local,
+            recv_vnodes,
+            recv_vnode_to_local,
             locality_comm->local_R_comm->recv_data, 
             locality_comm->local_R_comm->send_data,
             locality_comm->local_L_comm->recv_data, 
@@ -136,8 +207,13 @@ void init_locality(const int n_sends,
     update_global_comm(locality_comm);
 
     // Update send and receive indices
-    std::map<long, int> send_global_to_local;
-    std::map<long, int> recv_global_to_local;
+    long send_total = 0, recv_total = 0;
+    for (int i = 0; i < n_sends; i++)
+        send_total += sendcounts[i];
+    for (int i = 0; i < n_recvs; i++)
+        recv_total += recvcounts[i];
+    GlobalIndexMap send_global_to_local(send_total);
+    GlobalIndexMap recv_global_to_local(recv_total);
     int ctr = 0;
     int start, end;
     for (int i = 0; i < n_sends; i++)
@@ -145,7 +221,7 @@ void init_locality(const int n_sends,
         start = send_indptr[i];
         end = start + sendcounts[i];
         for (int j = start; j < end; j++)
-            send_global_to_local[global_send_indices[ctr++]] = j;
+            send_global_to_local.insert(global_send_indices[ctr++], j);
     }
 
     ctr = 0;
@@ -154,7 +230,7 @@ void init_locality(const int n_sends,
         start = recv_indptr[i];
         end = start + recvcounts[i];
         for (int j = start; j < end; j++)
-            recv_global_to_local[global_recv_indices[ctr++]] = j;
+            recv_global_to_local.insert(global_recv_indices[ctr++], j);
     }
 
     update_indices(locality_comm, 
@@ -181,77 +257,190 @@ void destroy_locality(MPIX_Request* request)
  **** Helper Methods
  ****
  ******************************************/
-// Map original communication processes to nodes on which they lie
-// And assign local processes to each node
-void map_procs_to_nodes(LocalityComm* locality, const int orig_num_msgs,
-        const int* orig_procs, const int* orig_counts,
-        std::vector<int>& msg_nodes, std::vector<int>& msg_node_to_local,
-        bool incr)
+// Gather every local process's entries of data into node_data
+// (sizes are exchanged first, so only existing entries are sent)
+template <typename T>
+void allgather_node(const std::vector<T>& data, std::vector<T>& node_data,
+        MPI_Datatype type, MPI_Comm local_comm)
 {
-    int rank, num_procs;
-    int local_rank, local_num_procs;
+    int local_num_procs;
+    MPI_Comm_size(local_comm, &local_num_procs);
+
+    int size = data.size();
+    std::vector<int> sizes(local_num_procs);
+    std::vector<int> displs(local_num_procs+1);
+    MPI_Allgather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, local_comm);
+    displs[0] = 0;
+    for (int i = 0; i < local_num_procs; i++)
+        displs[i+1] = displs[i] + sizes[i];
 
-    MPI_Comm_rank(locality->communicators->global_comm, &rank);
+    node_data.resize(displs[local_num_procs]);
+    MPI_Allgatherv(data.data(), size, type, node_data.data(), sizes.data(),
+            displs.data(), type, local_comm);
+}
+
+// Average off-node bytes sent per rank
+double fair_share_bytes(LocalityComm* locality, const int n_sends,
+        const int* send_procs, const int* sendcounts, const int send_size)
+{
+    int num_procs;
     MPI_Comm_size(locality->communicators->global_comm, &num_procs);
+
+    double bytes = 0;
+    for (int i = 0; i < n_sends; i++)
+        if (get_node(locality->communicators, send_procs[i]) != locality->communicators->rank_node)
+            bytes += (double)sendcounts[i] * send_size;
+    MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_DOUBLE, MPI_SUM, 
+            locality->communicators->global_comm);
+
+    bytes /= num_procs;
+    return bytes > 0 ? bytes : 1;
+}
+
+// Map original communication processes to virtual nodes, and assign
+// local processes to each virtual node.
+// A node pair heavier than fair_share bytes is split into up to as
+// many virtual nodes as the smaller node of the pair has processes :
+// virtual node j of node n (id n*PPN + j) holds the 
+// messages whose rank on the receiving node has local rank j modulo 
+// the number of splits.  Both nodes of a pair see the same total, so
+// both split it the same way.
+// Virtual nodes are assigned to local processes with LPT (heaviest
+// first, to the least loaded process), costing a message as 
+// LOCALITY_MSG_COST_BYTES bytes.  local_loads carries the load of each
+// local process from the send pass into the recv pass.
+void map_procs_to_nodes(LocalityComm* locality, const int orig_num_msgs,
+        const int* orig_procs, const int* orig_counts, const int type_size,
+        const double fair_share, std::vector<int>& orig_vnodes, 
+        std::map<int, int>& vnode_to_local, std::vector<double>& local_loads,
+        bool sends)
+{
+    int local_rank, local_num_procs;
     MPI_Comm_rank(locality->communicators->local_comm, &local_rank);
     MPI_Comm_size(locality->communicators->local_comm, &local_num_procs);
 
-    int proc, size, node;
-    int local_proc;
-    int inc;
-    std::vector<int> node_sizes;
-
-    int num_nodes = locality->communicators->num_nodes;
+    int proc, node, lr, k, node_size;
     int rank_node = locality->communicators->rank_node;
+    int ppn = locality->communicators->ppn;
+    int num_procs;
+    MPI_Comm_size(locality->communicators->global_comm, &num_procs);
 
-    // Map local msg_procs to local msg_nodes
-    node_sizes.resize(num_nodes, 0);
+    // Bytes and messages per (remote node, local rank on receiving node),
+    // only for pairs this rank talks to
+    std::map<int, std::pair<double, double> > local_pairs;
     for (int i = 0; i < orig_num_msgs; i++)
     {
         proc = orig_procs[i];
-        size = orig_counts[i];
         node = get_node(locality->communicators, proc);
-        node_sizes[node] += size;
+        if (node == rank_node) continue;
+        lr = sends ? get_local_proc(locality->communicators, proc) : local_rank;
+        std::pair<double, double>& pair = local_pairs[node*ppn + lr];
+        pair.first += (double)orig_counts[i] * type_size;
+        pair.second += 1;
     }
 
-    // Gather all send nodes and sizes among ranks local to node
-    MPI_Allreduce(MPI_IN_PLACE, node_sizes.data(), num_nodes, MPI_INT, MPI_SUM, locality->communicators->local_comm);
-    for (int i = 0; i < num_nodes; i++)
+    // Sum over the node (sparse : gathers only the pairs that exist)
+    std::vector<double> pair_data;
+    for (auto& it : local_pairs)
     {
-        if (node_sizes[i] && i != rank_node)
+        pair_data.push_back(it.first);
+        pair_data.push_back(it.second.first);
+        pair_data.push_back(it.second.second);
+    }
+    std::vector<double> node_pair_data;
+    allgather_node(pair_data, node_pair_data, MPI_DOUBLE, 
+            locality->communicators->local_comm);
+
+    std::map<int, std::pair<double, double> > pairs;
+    for (int i = 0; i < node_pair_data.size(); i += 3)
+    {
+        std::pair<double, double>& pair = pairs[(int)node_pair_data[i]];
+        pair.first += node_pair_data[i+1];
+        pair.second += node_pair_data[i+2];
+    }
+
+    // Split heavy node pairs, and cost each virtual node
+    // (pairs are ordered by id, so each node's entries are consecutive)
+    std::map<int, int> node_splits;
+    std::map<int, double> vnode_cost;
+    double bytes, msgs;
+    auto first = pairs.begin();
+    while (first != pairs.end())
+    {
+        node = first->first / ppn;
+        bytes = 0;
+        msgs = 0;
+        auto last = first;
+        for (; last != pairs.end() && last->first / ppn == node; ++last)
         {
-            msg_nodes.push_back(i);
+            bytes += last->second.first;
+            msgs += last->second.second;
         }
+
+        // Each piece needs its own process on both nodes (the smaller
+        // node may be the last one)
+        node_size = num_procs - node*ppn;
+        if (node_size > ppn) node_size = ppn;
+        if (node_size > local_num_procs) node_size = local_num_procs;
+        k = (int)ceil(bytes / fair_share);
+        if (k > node_size) k = node_size;
+        if (k < 1) k = 1;
+        node_splits[node] = k;
+
+        for (; first != last; ++first)
+            vnode_cost[node*ppn + ((first->first % ppn) % k)] += first->second.first
+                + LOCALITY_MSG_COST_BYTES * first->second.second;
     }
-    std::sort(msg_nodes.begin(), msg_nodes.end(),
+
+    // LPT : heaviest virtual node first, onto the least loaded process
+    // not already holding a piece of the same node pair, so a pair of
+    // processes exchanges at most one global message
+    // (ties go to low local ranks for sends and high ones for recvs)
+    std::vector<int> vnodes;
+    for (auto& it : vnode_cost)
+        vnodes.push_back(it.first);
+    std::sort(vnodes.begin(), vnodes.end(),
             [&](const int i, const int j)
             {
-                return node_sizes[i] > node_sizes[j];
+                if (vnode_cost[i] != vnode_cost[j])
+                    return vnode_cost[i] > vnode_cost[j];
+                return i < j;
             });
-
-    // Map send_nodes to local ranks
-    msg_node_to_local.resize(num_nodes, -1);
-    if (incr)
-    {
-        local_proc = 0;
-        inc = 1;
-    }
-    else
+    local_loads.resize(local_num_procs, 0);
+    std::map<int, std::vector<char> > holds_node;
+    int best;
+    for (int i = 0; i < vnodes.size(); i++)
     {
-        local_proc = local_num_procs - 1;
-        inc = -1;
+        node = vnodes[i] / ppn;
+        std::vector<char>& holds = holds_node[node];
+        holds.resize(local_num_procs, 0);
+        best = -1;
+        for (int p = 0; p < local_num_procs; p++)
+        {
+            lr = sends ? p : local_num_procs - 1 - p;
+            if (holds[lr]) continue;
+            if (best == -1 || local_loads[lr] < local_loads[best])
+                best = lr;
+        }
+        assert(best >= 0);
+        holds[best] = 1;
+        vnode_to_local[vnodes[i]] = best;
+        local_loads[best] += vnode_cost[vnodes[i]];
     }
-    for (int i = 0; i < msg_nodes.size(); i++)
-    {
-        node = msg_nodes[i];
-        msg_node_to_local[node] = local_proc;
 
-        if (local_proc == local_num_procs - 1 && inc == 1)
-            inc = -1;
-        else if (local_proc == 0 && inc == -1)
-           inc = 1;
-        else
-            local_proc += inc;
+    // Virtual node of each original message (-1 if on-node)
+    orig_vnodes.resize(orig_num_msgs);
+    for (int i = 0; i < orig_num_msgs; i++)
+    {
+        proc = orig_procs[i];
+        node = get_node(locality->communicators, proc);
+        if (node == rank_node)
+        {
+            orig_vnodes[i] = -1;
+            continue;
+        }
+        lr = sends ? get_local_proc(locality->communicators, proc) : local_rank;
+        orig_vnodes[i] = node*ppn + (lr % node_splits[node]);
     }
 }
 
@@ -260,8 +449,8 @@ void map_procs_to_nodes(LocalityComm* locality, const int orig_num_msgs,
 // of the fully local (local_L) communicator.
 void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
         const int* orig_send_ptr, const int* orig_sendcounts, const long* orig_send_indices,
-        const std::vector<int>& nodes_to_local, CommData* send_data,
-        CommData* recv_data, CommData* local_data,
+        const std::vector<int>& orig_vnodes, const std::map<int, int>& vnodes_to_local, 
+        CommData* send_data, CommData* recv_data, CommData* local_data,
         std::vector<int>& recv_idx_nodes,
         LocalityComm* locality, const int tag)
 {
@@ -278,13 +467,13 @@ void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
     int size, ctr, start_ctr;
     int start, end, node;
     int idx, proc_idx;
-    int proc, global_idx;
-    MPI_Status recv_status;
+    int proc;
+    long global_idx;
 
-    std::vector<int> send_buffer;
+    std::vector<long> send_buffer;
     std::vector<MPI_Request> send_requests;
     std::vector<int> send_sizes;
-    std::vector<int> recv_buffer;
+    std::vector<long> recv_buffer;
 
     std::vector<int> orig_to_node;
     std::vector<int> local_idx;
@@ -307,10 +496,10 @@ void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
     {
         global_proc = orig_send_procs[i];
         size = orig_sendcounts[i];
-        node = get_node(locality->communicators, global_proc);
-        if (locality->communicators->rank_node != node)
+        node = orig_vnodes[i];
+        if (node != -1)
         {
-            local_proc = nodes_to_local[node];
+            local_proc = vnodes_to_local.at(node);
             if (send_sizes[local_proc] == 0)
             {
                 local_idx[local_proc] = send_data->num_msgs;
@@ -354,30 +543,51 @@ void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
             for (int j = start; j < end; j++)
             {
                 global_idx = orig_send_indices[ctr++];
-                local_data->indices[local_data->size_msgs++] = global_idx;
+                local_data->global_indices[local_data->size_msgs++] = global_idx;
             }
         }
         else
         {
-            local_proc = nodes_to_local[node];
+            local_proc = vnodes_to_local.at(node);
             proc_idx = local_idx[local_proc];
             for (int j = start; j < end; j++)
             {
                 global_idx = orig_send_indices[ctr++];
                 idx = send_data->indptr[proc_idx] + send_sizes[local_proc]++;
-                send_data->indices[idx] = global_idx;
+                send_data->global_indices[idx] = global_idx;
                 send_idx_node[idx] = node;
             }
         }
     }
 
-    // Send 'local_S_comm send' info (to form local_S recv)
-    MPI_Allreduce(MPI_IN_PLACE, send_sizes.data(), local_num_procs,
-            MPI_INT, MPI_SUM, locality->communicators->local_comm);
-    recv_data->size_msgs = send_sizes[local_rank];
+    // Exchange message sizes, so every recv is posted up front
+    // (messages hold pairs of global index and destination node)
+    std::vector<int> recv_sizes(local_num_procs);
+    MPI_Alltoall(send_sizes.data(), 1, MPI_INT, recv_sizes.data(), 1, MPI_INT,
+            locality->communicators->local_comm);
+
+    recv_data->num_msgs = 0;
+    recv_data->size_msgs = 0;
+    for (int i = 0; i < local_num_procs; i++)
+    {
+        if (recv_sizes[i] == 0) continue;
+        recv_data->procs[recv_data->num_msgs] = i;
+        recv_data->size_msgs += recv_sizes[i];
+        recv_data->indptr[++recv_data->num_msgs] = recv_data->size_msgs;
+    }
     init_size_msgs(recv_data, recv_data->size_msgs);
     recv_idx_nodes.resize(recv_data->size_msgs);
 
+    recv_buffer.resize(2*recv_data->size_msgs);
+    std::vector<MPI_Request> recv_requests(recv_data->num_msgs);
+    for (int i = 0; i < recv_data->num_msgs; i++)
+    {
+        start = recv_data->indptr[i];
+        end = recv_data->indptr[i+1];
+        MPI_Irecv(&recv_buffer[2*start], 2*(end - start), MPI_LONG, recv_data->procs[i],
+                tag, locality->communicators->local_comm, &recv_requests[i]);
+    }
+
     send_buffer.resize(2*send_data->size_msgs);
     send_requests.resize(send_data->num_msgs);
     ctr = 0;
@@ -389,60 +599,25 @@ void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
         end = send_data->indptr[i+1];
         for (int j = start; j < end; j++)
         {
-            send_buffer[ctr++] = send_data->indices[j];
+            send_buffer[ctr++] = send_data->global_indices[j];
             send_buffer[ctr++] = send_idx_node[j];
         }
-        MPI_Isend(&send_buffer[start_ctr], ctr - start_ctr ,
-                MPI_INT, proc, tag, locality->communicators->local_comm, &send_requests[i]);
+        if (ctr > start_ctr)
+            MPI_Isend(&send_buffer[start_ctr], ctr - start_ctr ,
+                    MPI_LONG, proc, tag, locality->communicators->local_comm, &send_requests[i]);
+        else
+            send_requests[i] = MPI_REQUEST_NULL;
         start_ctr = ctr;
     }
 
-
-    std::vector<int> proc_pos(local_num_procs, -1);
-    std::vector<int> recv_idx(recv_data->size_msgs);
-    std::vector<int> tmpnodes(recv_data->size_msgs);
-    std::vector<int> recvptr(local_num_procs+1);
-    recvptr[0] = 0;
-    ctr = 0;
-    while (ctr < recv_data->size_msgs)
+    if (recv_data->num_msgs)
+        MPI_Waitall(recv_data->num_msgs, recv_requests.data(), MPI_STATUSES_IGNORE);
+    for (int i = 0; i < recv_data->size_msgs; i++)
     {
-        MPI_Probe(MPI_ANY_SOURCE, tag, locality->communicators->local_comm, &recv_status);
-        proc = recv_status.MPI_SOURCE;
-        MPI_Get_count(&recv_status, MPI_INT, &size);
-        if (size > recv_buffer.size())
-            recv_buffer.resize(size);
-        MPI_Recv(recv_buffer.data(), size, MPI_INT, proc, tag, locality->communicators->local_comm, &recv_status);
-        proc_pos[proc] = recv_data->num_msgs;
-        for (int i = 0; i < size; i += 2)
-        {
-            recv_idx[ctr] = recv_buffer[i];
-            tmpnodes[ctr++] = recv_buffer[i+1];
-        }
-        recvptr[recv_data->num_msgs+1] = recvptr[recv_data->num_msgs] + (size/2);
-        recv_data->num_msgs++;
+        recv_data->global_indices[i] = recv_buffer[2*i];
+        recv_idx_nodes[i] = recv_buffer[2*i+1];
     }
 
-    // Reorder Recvs
-    ctr = 0;
-    int pos, old_start, new_start;
-    for (int i = 0; i < local_num_procs; i++)
-    {
-        if (proc_pos[i] == -1) continue;
-
-        recv_data->procs[ctr] = i;
-        pos = proc_pos[i];
-        old_start = recvptr[pos];
-        new_start = recv_data->indptr[ctr];
-        size = recvptr[pos+1] - old_start;
-        recv_data->indptr[++ctr] = new_start + size;
-        for (int j = 0; j < size; j++)
-        {
-            recv_data->indices[new_start+j] = recv_idx[old_start+j];
-            recv_idx_nodes[new_start+j] = tmpnodes[old_start+j];
-        }
-    }
-
-
     if (send_data->num_msgs)
     {
         MPI_Waitall(send_data->num_msgs, send_requests.data(), MPI_STATUSES_IGNORE);
@@ -451,55 +626,34 @@ void form_local_comm(const int orig_num_sends, const int* orig_send_procs,
 
 
 // Form portion of inter-node communication (data corresponding to
-// either global send or global recv), with node id currently in
-// place of process with which to communicate
+// either global send or global recv), with virtual node id currently
+// in place of process with which to communicate
 void form_global_comm(CommData* local_data, CommData* global_data,
         std::vector<int>& local_data_nodes, const MPIX_Comm* mpix_comm, int tag)
 {
-    std::vector<int> tmp_send_indices;
-    std::vector<int> node_sizes;
+    std::map<int, int> node_sizes;
     std::vector<int> node_ctr;
 
-    // Get MPI Information
-    int rank, num_procs;
-    int local_rank, local_num_procs;
-    MPI_Comm_rank(mpix_comm->global_comm, &rank);
-    MPI_Comm_size(mpix_comm->global_comm, &num_procs);
-    MPI_Comm_rank(mpix_comm->local_comm, &local_rank);
-    MPI_Comm_size(mpix_comm->local_comm, &local_num_procs);
-    int num_nodes = mpix_comm->num_nodes;
-    int rank_node = mpix_comm->rank_node;
-
     int node_idx;
     int start, end, idx;
-    int ctr, node, size;
-
-    node_sizes.resize(num_nodes, 0);
+    int node;
 
     for (int i = 0; i < local_data->size_msgs; i++)
-    {
-        node = local_data_nodes[i];
-        if (node_sizes[node] == 0)
-        {
-            global_data->num_msgs++;
-        }
-        node_sizes[node]++;
-    }
+        node_sizes[local_data_nodes[i]]++;
+    global_data->num_msgs = node_sizes.size();
     init_num_msgs(global_data, global_data->num_msgs);
 
+    // Messages ordered by virtual node id
     node_ctr.resize(global_data->num_msgs, 0);
     global_data->num_msgs = 0;
     global_data->indptr[0] = 0;
-    for (int i = 0; i < num_nodes; i++)
+    for (auto& it : node_sizes)
     {
-        if (node_sizes[i])
-        {
-            global_data->procs[global_data->num_msgs] = i;
-            global_data->size_msgs += node_sizes[i];
-            node_sizes[i] = global_data->num_msgs;
-            global_data->num_msgs++;
-            global_data->indptr[global_data->num_msgs] = global_data->size_msgs;
-        }
+        global_data->procs[global_data->num_msgs] = it.first;
+        global_data->size_msgs += it.second;
+        it.second = global_data->num_msgs;
+        global_data->num_msgs++;
+        global_data->indptr[global_data->num_msgs] = global_data->size_msgs;
     }
 
     init_size_msgs(global_data, global_data->size_msgs);
@@ -512,88 +666,111 @@ void form_global_comm(CommData* local_data, CommData* global_data,
             node = local_data_nodes[j];
             node_idx = node_sizes[node];
             idx = global_data->indptr[node_idx] + node_ctr[node_idx]++;
-            global_data->indices[idx] = local_data->indices[j];
+            global_data->global_indices[idx] = local_data->global_indices[j];
         }
     }
 }
 
-// Replace send and receive processes with the node id's currently in their place
+
+// Replace send and receive processes with the virtual node id's currently
+// in their place.  Virtual node j of a node pair is matched with virtual
+// node j of the same pair on the other node.
+// Each global message is announced to the process with the same local
+// rank on the other node, discovered with NBX (synchronous sends and a
+// nonblocking barrier), and the matches found are then shared within
+// the node.  No process stores or reduces O(num_procs) data.
 void update_global_comm(LocalityComm* locality)
 {
-    int rank, num_procs;
-    MPI_Comm_rank(locality->communicators->global_comm, &rank);
-    MPI_Comm_size(locality->communicators->global_comm, &num_procs);
-    int local_rank, local_num_procs;
+    int local_rank;
     MPI_Comm_rank(locality->communicators->local_comm, &local_rank);
-    MPI_Comm_size(locality->communicators->local_comm, &local_num_procs);
-    int num_nodes = locality->communicators->num_nodes;
+    int ppn = locality->communicators->ppn;
+    int rank_node = locality->communicators->rank_node;
+    MPI_Comm global_comm = locality->communicators->global_comm;
 
     int n_sends = locality->global_comm->send_data->num_msgs;
     int n_recvs = locality->global_comm->recv_data->num_msgs;
     int n_msgs = n_sends + n_recvs;
-    MPI_Request* requests = NULL;
-    int* send_buffer = NULL;
     int send_tag = 32148532;
     int recv_tag = 52395234;
-    int node, global_proc, tag;
-    int num_to_recv;
+    int node, global_proc, flag;
+    int ibar = 0;
     MPI_Status recv_status;
-    std::vector<int> send_nodes(num_nodes, 0);
-    std::vector<int> recv_nodes(num_nodes, 0);
-    if (n_msgs)
-    {
-        requests = new MPI_Request[n_msgs];
-        send_buffer = new int[n_msgs];
-    }
+    MPI_Request bar_req;
+    std::vector<MPI_Request> requests(n_msgs);
+    std::vector<int> send_buffer(n_msgs);
 
-    std::vector<int> comm_procs(num_procs, 0);
+    // Announce global sends (send_tag) and recvs (recv_tag) to the
+    // counterpart on the other node, as the matching virtual node there
     for (int i = 0; i < n_sends; i++)
     {
         node = locality->global_comm->send_data->procs[i];
-        global_proc = get_global_proc(locality->communicators, node, local_rank);
-        comm_procs[global_proc]++;
-        send_buffer[i] = locality->communicators->rank_node;
-        MPI_Isend(&(send_buffer[i]), 1, MPI_INT, global_proc, send_tag,
-                locality->communicators->global_comm, &(requests[i]));
+        global_proc = get_global_proc(locality->communicators, node / ppn, local_rank);
+        send_buffer[i] = rank_node*ppn + (node % ppn);
+        MPI_Issend(&(send_buffer[i]), 1, MPI_INT, global_proc, send_tag,
+                global_comm, &(requests[i]));
     }
-    MPI_Allreduce(MPI_IN_PLACE, comm_procs.data(), num_procs, MPI_INT,
-            MPI_SUM, locality->communicators->global_comm);
-    num_to_recv = comm_procs[rank];
-    for (int i = 0; i < num_procs; i++)
-        comm_procs[i] = 0;
-    for (int i = 0; i < num_to_recv; i++)
-    {
-        MPI_Probe(MPI_ANY_SOURCE, send_tag, locality->communicators->global_comm, &recv_status);
-        global_proc = recv_status.MPI_SOURCE;
-        MPI_Recv(&node, 1, MPI_INT, global_proc, send_tag, locality->communicators->global_comm, &recv_status);
-        recv_nodes[node] = global_proc;
-    }
-    
     for (int i = 0; i < n_recvs; i++)
     {
         node = locality->global_comm->recv_data->procs[i];
-        global_proc = get_global_proc(locality->communicators, node, local_rank);
-        comm_procs[global_proc]++;
-        send_buffer[n_sends + i] = locality->communicators->rank_node;
-        MPI_Isend(&(send_buffer[n_sends + i]), 1, MPI_INT, global_proc, recv_tag,
-                locality->communicators->global_comm, &(requests[n_sends + i]));
+        global_proc = get_global_proc(locality->communicators, node / ppn, local_rank);
+        send_buffer[n_sends + i] = rank_node*ppn + (node % ppn);
+        MPI_Issend(&(send_buffer[n_sends + i]), 1, MPI_INT, global_proc, recv_tag,
+                global_comm, &(requests[n_sends + i]));
     }
-    MPI_Allreduce(MPI_IN_PLACE, comm_procs.data(), num_procs, MPI_INT,
-            MPI_SUM, locality->communicators->global_comm);
-    num_to_recv = comm_procs[rank];
-    for (int i = 0; i < num_to_recv; i++)
+
+    // (virtual node, process) pairs : process sending to this node
+    // from virtual node (recv_pairs), and process receiving this node's
+    // data for virtual node (send_pairs)
+    std::vector<int> send_pairs;
+    std::vector<int> recv_pairs;
+    while (1)
     {
-        MPI_Probe(MPI_ANY_SOURCE, recv_tag, locality->communicators->global_comm, &recv_status);
-        global_proc = recv_status.MPI_SOURCE;
-        MPI_Recv(&node, 1, MPI_INT, global_proc, recv_tag, locality->communicators->global_comm, &recv_status);
-        send_nodes[node] = global_proc;
-    }
+        MPI_Iprobe(MPI_ANY_SOURCE, send_tag, global_comm, &flag, &recv_status);
+        if (flag)
+        {
+            global_proc = recv_status.MPI_SOURCE;
+            MPI_Recv(&node, 1, MPI_INT, global_proc, send_tag, global_comm, &recv_status);
+            recv_pairs.push_back(node);
+            recv_pairs.push_back(global_proc);
+        }
 
-    if (n_sends + n_recvs)
-        MPI_Waitall(n_sends + n_recvs, requests, MPI_STATUSES_IGNORE);
+        MPI_Iprobe(MPI_ANY_SOURCE, recv_tag, global_comm, &flag, &recv_status);
+        if (flag)
+        {
+            global_proc = recv_status.MPI_SOURCE;
+            MPI_Recv(&node, 1, MPI_INT, global_proc, recv_tag, global_comm, &recv_status);
+            send_pairs.push_back(node);
+            send_pairs.push_back(global_proc);
+        }
 
-    MPI_Allreduce(MPI_IN_PLACE, send_nodes.data(), num_nodes, MPI_INT, MPI_MAX, locality->communicators->local_comm);
-    MPI_Allreduce(MPI_IN_PLACE, recv_nodes.data(), num_nodes, MPI_INT, MPI_MAX, locality->communicators->local_comm);
+        // Once all of my synchronous sends are received, join the barrier
+        // All announcements are received once every process has joined
+        if (ibar)
+        {
+            MPI_Test(&bar_req, &flag, MPI_STATUS_IGNORE);
+            if (flag) break;
+        }
+        else
+        {
+            MPI_Testall(n_msgs, requests.data(), &flag, MPI_STATUSES_IGNORE);
+            if (flag)
+            {
+                ibar = 1;
+                MPI_Ibarrier(global_comm, &bar_req);
+            }
+        }
+    }
+
+    // Share the matches within the node
+    std::vector<int> node_pairs;
+    std::map<int, int> send_nodes;
+    std::map<int, int> recv_nodes;
+    allgather_node(send_pairs, node_pairs, MPI_INT, locality->communicators->local_comm);
+    for (int i = 0; i < node_pairs.size(); i += 2)
+        send_nodes[node_pairs[i]] = node_pairs[i+1];
+    allgather_node(recv_pairs, node_pairs, MPI_INT, locality->communicators->local_comm);
+    for (int i = 0; i < node_pairs.size(); i += 2)
+        recv_nodes[node_pairs[i]] = node_pairs[i+1];
 
     for (int i = 0; i < n_sends; i++)
     {
@@ -605,9 +782,6 @@ void update_global_comm(LocalityComm* locality)
         node = locality->global_comm->recv_data->procs[i];
         locality->global_comm->recv_data->procs[i] = recv_nodes[node];
     }
-
-    if (requests) delete[] requests;
-    if (send_buffer) delete[] send_buffer;
 }
 
 // Update indices:
@@ -615,30 +789,22 @@ void update_global_comm(LocalityComm* locality)
 // 2.) map internal communication steps to point to correct
 //     position in previously received data
 // 3.) map final receives to points in original recv data
-void form_global_map(const CommData* map_data, std::map<long, int>& global_map)
+void form_global_map(const CommData* map_data, GlobalIndexMap& global_map)
 {
-    int idx;
-
     for (int i = 0; i < map_data->size_msgs; i++)
-    {
-        idx = map_data->indices[i];
-        global_map[idx] = i;
-    }
+        global_map.insert(map_data->global_indices[i], i);
 }
-void map_indices(CommData* idx_data, std::map<long, int>& global_map)
+void map_indices(CommData* idx_data, const GlobalIndexMap& global_map)
 {
-    int idx;
-
+    if (idx_data->size_msgs)
+        idx_data->indices = (int*)malloc(idx_data->size_msgs*sizeof(int));
     for (int i = 0; i < idx_data->size_msgs; i++)
-    {
-        idx = idx_data->indices[i];
-        idx_data->indices[i] = global_map[idx];
-    }
+        idx_data->indices[i] = global_map.find(idx_data->global_indices[i]);
 }
 
 void map_indices(CommData* idx_data, const CommData* map_data)
 {
-    std::map<long, int> global_map;
+    GlobalIndexMap global_map(map_data->size_msgs);
     form_global_map(map_data, global_map);
     map_indices(idx_data, global_map);
 }
@@ -655,7 +821,7 @@ void remove_duplicates(CommData* comm_pkg)
     {
         start = comm_pkg->indptr[i];
         end = comm_pkg->indptr[i+1];
-        std::sort(comm_pkg->indices+start, comm_pkg->indices+end);
+        std::sort(comm_pkg->global_indices+start, comm_pkg->global_indices+end);
     }
 
     comm_pkg->size_msgs = 0;
@@ -663,12 +829,12 @@ void remove_duplicates(CommData* comm_pkg)
     for (int i = 0; i < comm_pkg->num_msgs; i++)
     {
         end = comm_pkg->indptr[i+1];
-        comm_pkg->indices[comm_pkg->size_msgs++] = comm_pkg->indices[start];
+        comm_pkg->global_indices[comm_pkg->size_msgs++] = comm_pkg->global_indices[start];
         for (int j  = start; j < end - 1; j++)
         {
-            if (comm_pkg->indices[j+1] != comm_pkg->indices[j])
+            if (comm_pkg->global_indices[j+1] != comm_pkg->global_indices[j])
             {
-                comm_pkg->indices[comm_pkg->size_msgs++] = comm_pkg->indices[j+1];
+                comm_pkg->global_indices[comm_pkg->size_msgs++] = comm_pkg->global_indices[j+1];
             }
         }
         start = end;
@@ -684,6 +850,11 @@ void remove_duplicates(CommPkg* data)
 
 void remove_duplicates(LocalityComm* locality)
 {
+    locality->requested_sizes[0] = locality->local_L_comm->send_data->size_msgs;
+    locality->requested_sizes[1] = locality->local_S_comm->send_data->size_msgs;
+    locality->requested_sizes[2] = locality->local_R_comm->send_data->size_msgs;
+    locality->requested_sizes[3] = locality->global_comm->send_data->size_msgs;
+
     remove_duplicates(locality->local_S_comm);
     remove_duplicates(locality->local_R_comm);
     remove_duplicates(locality->global_comm);
@@ -691,8 +862,8 @@ void remove_duplicates(LocalityComm* locality)
 
 
 void update_indices(LocalityComm* locality, 
-        std::map<long, int>& send_global_to_local,
-        std::map<long, int>& recv_global_to_local)
+        const GlobalIndexMap& send_global_to_local,
+        const GlobalIndexMap& recv_global_to_local)
 {
     // Remove duplicates
     remove_duplicates(locality);
@@ -706,15 +877,6 @@ void update_indices(LocalityComm* locality,
     map_indices(locality->local_L_comm->recv_data, recv_global_to_local);
 
     // Don't need local_S or global recv indices (just contiguous)
-    if (locality->local_S_comm->recv_data->indices)
-    {
-        free(locality->local_S_comm->recv_data->indices);
-        locality->local_S_comm->recv_data->indices = NULL;
-    }
-    if (locality->global_comm->recv_data->indices)
-    {
-        free(locality->global_comm->recv_data->indices);
-        locality->global_comm->recv_data->indices = NULL;
-    }
+    // Global indices are freed in finalize_comm_data
 }
 
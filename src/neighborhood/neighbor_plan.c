@@ -0,0 +1,543 @@
+#include "neighbor_plan.h"
+#include "neighbor.h"
+#include "utils.h"
+#include <string.h>
+
+// File layout : header (magic, version, number of processes), then
+// (offset, size) of each rank's record, then the records
+// Record : pattern hash, then num_msgs, size_msgs, procs, indptr and
+// indices of each CommData (local_L, local_S, local_R, global; send
+// before recv)
+#define PLAN_FILE_MAGIC 0x4e4c5058
+#define PLAN_FILE_VERSION 2
+#define PLAN_HEADER_BYTES (3*sizeof(int))
+#define PLAN_ENTRY_BYTES (2*sizeof(long long))
+
+// FNV-1a
+static unsigned long hash_append(unsigned long hash, const void* data, size_t bytes)
+{
+    const unsigned char* values = (const unsigned char*)data;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        hash ^= values[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+unsigned long hash_locality_pattern(const int sendcounts[],
+        const int sdispls[],
+        const long global_sindices[],
+        MPI_Datatype sendtype,
+        const int recvcounts[],
+        const int rdispls[],
+        const long global_rindices[],
+        MPI_Datatype recvtype,
+        const MPIX_Comm* comm)
+{
+    int topology[7];
+    MPI_Comm_rank(comm->global_comm, &(topology[0]));
+    MPI_Comm_size(comm->global_comm, &(topology[1]));
+    topology[2] = comm->ppn;
+    topology[3] = comm->indegree;
+    topology[4] = comm->outdegree;
+    MPI_Type_size(sendtype, &(topology[5]));
+    MPI_Type_size(recvtype, &(topology[6]));
+
+    long send_total = 0, recv_total = 0;
+    for (int i = 0; i < comm->outdegree; i++)
+        send_total += sendcounts[i];
+    for (int i = 0; i < comm->indegree; i++)
+        recv_total += recvcounts[i];
+
+    unsigned long hash = 14695981039346656037UL;
+    hash = hash_append(hash, topology, sizeof(topology));
+    hash = hash_append(hash, comm->destinations, comm->outdegree*sizeof(int));
+    hash = hash_append(hash, sendcounts, comm->outdegree*sizeof(int));
+    hash = hash_append(hash, sdispls, comm->outdegree*sizeof(int));
+    hash = hash_append(hash, global_sindices, send_total*sizeof(long));
+    hash = hash_append(hash, comm->sources, comm->indegree*sizeof(int));
+    hash = hash_append(hash, recvcounts, comm->indegree*sizeof(int));
+    hash = hash_append(hash, rdispls, comm->indegree*sizeof(int));
+    hash = hash_append(hash, global_rindices, recv_total*sizeof(long));
+
+    return hash ? hash : 1;
+}
+
+
+typedef struct _PlanBuffer
+{
+    char* data;
+    size_t size;
+    size_t capacity;
+} PlanBuffer;
+
+static void plan_append(PlanBuffer* buf, const void* data, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+
+    if (buf->size + bytes > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? 2*buf->capacity : 1024;
+        while (capacity < buf->size + bytes)
+            capacity *= 2;
+        buf->data = (char*)realloc(buf->data, capacity);
+        buf->capacity = capacity;
+    }
+    memcpy(&(buf->data[buf->size]), data, bytes);
+    buf->size += bytes;
+}
+
+// Copies bytes at *pos into data, returns 0 if past the end of buf
+static int plan_read(const PlanBuffer* buf, size_t* pos, void* data, size_t bytes)
+{
+    if (bytes > buf->size - *pos)
+        return 0;
+    memcpy(data, &(buf->data[*pos]), bytes);
+    *pos += bytes;
+    return 1;
+}
+
+static void write_comm_data(PlanBuffer* buf, const CommData* data)
+{
+    int has_indices = data->indices != NULL;
+    plan_append(buf, &(data->num_msgs), sizeof(int));
+    plan_append(buf, &(data->size_msgs), sizeof(int));
+    plan_append(buf, &has_indices, sizeof(int));
+    if (data->num_msgs)
+    {
+        plan_append(buf, data->procs, data->num_msgs*sizeof(int));
+        plan_append(buf, &(data->indptr[1]), data->num_msgs*sizeof(int));
+    }
+    if (has_indices)
+        plan_append(buf, data->indices, data->size_msgs*sizeof(int));
+}
+
+// Returns 0 if the record is truncated or inconsistent
+static int read_comm_data(const PlanBuffer* buf, size_t* pos, CommData* data)
+{
+    int num_msgs, size_msgs, has_indices;
+    if (!plan_read(buf, pos, &num_msgs, sizeof(int))
+            || !plan_read(buf, pos, &size_msgs, sizeof(int))
+            || !plan_read(buf, pos, &has_indices, sizeof(int)))
+        return 0;
+    if (num_msgs < 0 || size_msgs < 0
+            || (size_t)num_msgs > buf->size || (size_t)size_msgs > buf->size)
+        return 0;
+
+    init_num_msgs(data, num_msgs);
+    data->size_msgs = size_msgs;
+    if (num_msgs && (!plan_read(buf, pos, data->procs, num_msgs*sizeof(int))
+            || !plan_read(buf, pos, &(data->indptr[1]), num_msgs*sizeof(int))))
+        return 0;
+    if (data->indptr[num_msgs] != size_msgs)
+        return 0;
+
+    if (has_indices)
+    {
+        data->indices = (int*)malloc((size_msgs+1)*sizeof(int));
+        if (!plan_read(buf, pos, data->indices, size_msgs*sizeof(int)))
+            return 0;
+    }
+
+    return 1;
+}
+
+static CommData* plan_comm_data(LocalityComm* locality, int i)
+{
+    CommPkg* steps[4] = {locality->local_L_comm, locality->local_S_comm,
+            locality->local_R_comm, locality->global_comm};
+    return i % 2 ? steps[i/2]->recv_data : steps[i/2]->send_data;
+}
+
+
+int MPIX_Request_save(MPIX_Request* request, const char* filename)
+{
+    LocalityComm* locality = request->locality;
+    if (locality == NULL || locality->pattern_hash == 0
+            || request->packed || request->direct_n_msgs)
+        return MPI_ERR_ARG;
+
+    MPI_Comm comm = locality->communicators->global_comm;
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    PlanBuffer buf = {NULL, 0, 0};
+    plan_append(&buf, &(locality->pattern_hash), sizeof(unsigned long));
+    plan_append(&buf, locality->requested_sizes, 4*sizeof(int));
+    for (int i = 0; i < 8; i++)
+        write_comm_data(&buf, plan_comm_data(locality, i));
+
+    long long record_size = buf.size;
+    long long record_offset = 0;
+    MPI_Exscan(&record_size, &record_offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) record_offset = 0;
+
+    MPI_File fh;
+    int ierr = MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+            MPI_INFO_NULL, &fh);
+    if (ierr != MPI_SUCCESS)
+    {
+        free(buf.data);
+        return ierr;
+    }
+    MPI_File_set_size(fh, 0);
+
+    MPI_Offset data_start = PLAN_HEADER_BYTES + (MPI_Offset)num_procs*PLAN_ENTRY_BYTES;
+    if (rank == 0)
+    {
+        int header[3] = {PLAN_FILE_MAGIC, PLAN_FILE_VERSION, num_procs};
+        ierr += MPI_File_write_at(fh, 0, header, 3, MPI_INT, MPI_STATUS_IGNORE);
+    }
+
+    long long entry[2] = {data_start + record_offset, record_size};
+    ierr += MPI_File_write_at_all(fh, PLAN_HEADER_BYTES + (MPI_Offset)rank*PLAN_ENTRY_BYTES,
+            entry, 2, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+
+    int count;
+    MPI_Datatype type;
+    int free_type = large_count_type(record_size, MPI_BYTE, &count, &type);
+    ierr += MPI_File_write_at_all(fh, entry[0], buf.data, count, type, MPI_STATUS_IGNORE);
+    if (free_type)
+        MPI_Type_free(&type);
+
+    MPI_File_close(&fh);
+    free(buf.data);
+
+    return ierr ? MPI_ERR_FILE : MPI_SUCCESS;
+}
+
+
+int MPIX_Request_load(const char* filename,
+        const void* sendbuffer,
+        const int sendcounts[],
+        const int sdispls[],
+        const long global_sindices[],
+        MPI_Datatype sendtype,
+        void* recvbuffer,
+        const int recvcounts[],
+        const int rdispls[],
+        const long global_rindices[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr)
+{
+    *request_ptr = NULL;
+
+    int rank, num_procs;
+    MPI_Comm_rank(comm->global_comm, &rank);
+    MPI_Comm_size(comm->global_comm, &num_procs);
+
+    MPI_File fh;
+    int ierr = MPI_File_open(comm->global_comm, filename, MPI_MODE_RDONLY,
+            MPI_INFO_NULL, &fh);
+    if (ierr != MPI_SUCCESS)
+        return MPI_ERR_FILE;
+
+    // Locate this rank's record
+    MPI_Status status;
+    int count;
+    int header[3] = {0, 0, 0};
+    long long entry[2] = {0, 0};
+    MPI_Offset data_start = PLAN_HEADER_BYTES + (MPI_Offset)num_procs*PLAN_ENTRY_BYTES;
+    int valid = 0;
+    MPI_File_read_at(fh, 0, header, 3, MPI_INT, &status);
+    MPI_Get_count(&status, MPI_INT, &count);
+    if (count == 3 && header[0] == PLAN_FILE_MAGIC && header[1] == PLAN_FILE_VERSION
+            && header[2] == num_procs)
+    {
+        MPI_File_read_at(fh, PLAN_HEADER_BYTES + (MPI_Offset)rank*PLAN_ENTRY_BYTES,
+                entry, 2, MPI_LONG_LONG, &status);
+        MPI_Get_count(&status, MPI_LONG_LONG, &count);
+        valid = count == 2 && entry[0] >= data_start && entry[1] > 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, comm->global_comm);
+    if (!valid)
+    {
+        MPI_File_close(&fh);
+        return MPI_ERR_FILE;
+    }
+
+    PlanBuffer buf;
+    buf.size = entry[1];
+    buf.capacity = buf.size;
+    buf.data = (char*)malloc(buf.size);
+
+    MPI_Datatype type;
+    int read_count;
+    int free_type = large_count_type(entry[1], MPI_BYTE, &count, &type);
+    MPI_File_read_at_all(fh, entry[0], buf.data, count, type, &status);
+    MPI_Get_count(&status, type, &read_count);
+    if (free_type)
+        MPI_Type_free(&type);
+    MPI_File_close(&fh);
+
+    // Check the plan was built for these arguments and topology
+    LocalityComm* locality;
+    init_locality_comm(&locality, comm, sendtype, recvtype);
+    int err = read_count == count ? MPI_SUCCESS : MPI_ERR_FILE;
+    size_t pos = 0;
+    unsigned long hash = 0;
+    if (err == MPI_SUCCESS && !plan_read(&buf, &pos, &hash, sizeof(unsigned long)))
+        err = MPI_ERR_FILE;
+    if (err == MPI_SUCCESS && hash != hash_locality_pattern(sendcounts, sdispls,
+                global_sindices, sendtype, recvcounts, rdispls, global_rindices,
+                recvtype, comm))
+        err = MPI_ERR_ARG;
+    if (err == MPI_SUCCESS && !plan_read(&buf, &pos, locality->requested_sizes, 4*sizeof(int)))
+        err = MPI_ERR_FILE;
+    for (int i = 0; i < 8 && err == MPI_SUCCESS; i++)
+        if (!read_comm_data(&buf, &pos, plan_comm_data(locality, i)))
+            err = MPI_ERR_FILE;
+    free(buf.data);
+
+    MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MAX, comm->global_comm);
+    if (err != MPI_SUCCESS)
+    {
+        destroy_locality_comm(locality);
+        return err;
+    }
+
+    finalize_locality_comm(locality);
+    locality->pattern_hash = hash;
+
+    MPIX_Request* request;
+    init_request(&request);
+    request->locality = locality;
+    form_source_map(locality, comm->indegree, recvcounts, rdispls);
+    request->n_sources = comm->indegree;
+
+    int recv_size;
+    MPI_Type_size(recvtype, &recv_size);
+    if (get_info_flag(info, "mpix_shared_local"))
+        init_shared_local_L(request, recv_size, comm);
+    init_locality_requests(sendbuffer, recvbuffer, recv_size, comm,
+            get_info_flag(info, "mpix_zero_copy"), request);
+
+    *request_ptr = request;
+
+    return MPI_SUCCESS;
+}
+
+
+int MPIX_Request_clone(MPIX_Request* request, const void* sendbuf,
+        void* recvbuf, MPIX_Request** clone_ptr)
+{
+    *clone_ptr = NULL;
+
+    LocalityComm* locality = request->locality;
+    if (locality == NULL || request->packed || request->direct_n_msgs
+            || request->shared)
+        return MPI_ERR_ARG;
+
+    MPIX_Request* clone;
+    init_request(&clone);
+    locality->ref_count++;
+    clone->locality = locality;
+    clone->n_sources = request->n_sources;
+    clone->block_size = request->block_size;
+    clone->send_index_stride = request->send_index_stride;
+    clone->send_column_stride = request->send_column_stride;
+    clone->recv_index_stride = request->recv_index_stride;
+    clone->recv_column_stride = request->recv_column_stride;
+
+    init_locality_requests(sendbuf, recvbuf, request->recv_size,
+            locality->communicators, request->zero_copy, clone);
+
+    *clone_ptr = clone;
+
+    return MPI_SUCCESS;
+}
+
+
+// Rebuild the persistent requests of msgs bound to user buffers
+static int rebind_buffer_msgs(int n_msgs, const BufferMsg* msgs,
+        MPI_Request* requests, const void* sendbuf, void* recvbuf)
+{
+    int ierr = 0;
+    for (int i = 0; i < n_msgs; i++)
+    {
+        if (!msgs[i].user)
+            continue;
+        MPI_Request_free(&(requests[i]));
+        ierr += bind_buffer_msg(&(msgs[i]), msgs[i].send ? sendbuf : recvbuf,
+                &(requests[i]));
+    }
+    return ierr;
+}
+
+int MPIX_Request_rebind(MPIX_Request* request, const void* sendbuf,
+        void* recvbuf)
+{
+    if (request->active)
+        return MPI_ERR_REQUEST;
+
+    // Alltoallw : messages exchange the packed streams, which remain
+    if (request->packed)
+    {
+        request->packed->sendbuf = (const char*)sendbuf;
+        request->packed->recvbuf = (char*)recvbuf;
+        return MPI_SUCCESS;
+    }
+
+    int ierr = 0;
+    ierr += rebind_buffer_msgs(request->local_L_n_msgs, request->local_L_msgs,
+            request->local_L_requests, sendbuf, recvbuf);
+    ierr += rebind_buffer_msgs(request->local_S_n_msgs, request->local_S_msgs,
+            request->local_S_requests, sendbuf, recvbuf);
+    ierr += rebind_buffer_msgs(request->global_n_msgs, request->global_msgs,
+            request->global_requests, sendbuf, recvbuf);
+    ierr += rebind_buffer_msgs(request->local_R_n_msgs, request->local_R_msgs,
+            request->local_R_requests, sendbuf, recvbuf);
+    ierr += rebind_buffer_msgs(request->direct_n_msgs, request->direct_msgs,
+            request->direct_requests, sendbuf, recvbuf);
+
+    // Staging copies read sendbuf and write recvbuf at each start
+    request->sendbuf = sendbuf;
+    request->recvbuf = recvbuf;
+
+    return ierr ? MPI_ERR_OTHER : MPI_SUCCESS;
+}
+
+
+// Messages over INT_MAX elements are bound to derived datatypes, which
+// cannot be blocked (user datatypes are named, or duplicates)
+static int blockable_msgs(int n_msgs, const BufferMsg* msgs)
+{
+    int num_integers, num_addresses, num_datatypes, combiner;
+    for (int i = 0; i < n_msgs; i++)
+    {
+        MPI_Type_get_envelope(msgs[i].type, &num_integers, &num_addresses,
+                &num_datatypes, &combiner);
+        if (combiner != MPI_COMBINER_NAMED && combiner != MPI_COMBINER_DUP)
+            return 0;
+    }
+    return 1;
+}
+
+// Rebuild the persistent requests of msgs (on user buffers) over the
+// block layout of request
+static int block_buffer_msgs(MPIX_Request* request, int n_msgs, 
+        BufferMsg* msgs, MPI_Request* requests)
+{
+    int ierr = 0;
+    int index_stride, column_stride;
+    for (int i = 0; i < n_msgs; i++)
+    {
+        BufferMsg* msg = &(msgs[i]);
+        index_stride = msg->send ? request->send_index_stride : request->recv_index_stride;
+        column_stride = msg->send ? request->send_column_stride : request->recv_column_stride;
+        msg->block_type = block_datatype(request, msg->type, request->block_size,
+                index_stride, column_stride);
+        msg->block_offset = msg->offset*index_stride;
+
+        MPI_Request_free(&(requests[i]));
+        ierr += bind_buffer_msg(msg, msg->send ? request->sendbuf : request->recvbuf,
+                &(requests[i]));
+    }
+    return ierr;
+}
+
+int MPIX_Request_set_block(MPIX_Request* request, int k,
+        int send_index_stride, int send_column_stride,
+        int recv_index_stride, int recv_column_stride)
+{
+    if (request->active)
+        return MPI_ERR_REQUEST;
+    if (k < 1 || request->packed || request->shared)
+        return MPI_ERR_ARG;
+    if (!blockable_msgs(request->direct_n_msgs, request->direct_msgs))
+        return MPI_ERR_ARG;
+    if (request->locality == NULL
+            && !blockable_msgs(request->global_n_msgs, request->global_msgs))
+        return MPI_ERR_ARG;
+
+    request->block_size = k;
+    request->send_index_stride = send_index_stride;
+    request->send_column_stride = send_column_stride;
+    request->recv_index_stride = recv_index_stride;
+    request->recv_column_stride = recv_column_stride;
+
+    // Messages between user buffers : bind block datatypes of their own
+    int ierr = block_buffer_msgs(request, request->direct_n_msgs,
+            request->direct_msgs, request->direct_requests);
+    if (request->locality == NULL)
+    {
+        ierr += block_buffer_msgs(request, request->global_n_msgs,
+                request->global_msgs, request->global_requests);
+        return ierr ? MPI_ERR_OTHER : MPI_SUCCESS;
+    }
+
+    // Locality-aware steps : staging buffers and messages of k values
+    // per index, rebuilt over the plan
+    free_persistent_requests(&(request->local_L_n_msgs), &(request->local_L_requests));
+    free_persistent_requests(&(request->local_S_n_msgs), &(request->local_S_requests));
+    free_persistent_requests(&(request->global_n_msgs), &(request->global_requests));
+    free_persistent_requests(&(request->local_R_n_msgs), &(request->local_R_requests));
+    free(request->local_L_msgs);
+    free(request->local_S_msgs);
+    free(request->global_msgs);
+    free(request->local_R_msgs);
+    free_step_buffers(&(request->local_L_buffers));
+    free_step_buffers(&(request->local_S_buffers));
+    free_step_buffers(&(request->global_buffers));
+    free_step_buffers(&(request->local_R_buffers));
+
+    ierr += init_locality_requests(request->sendbuf, request->recvbuf, 
+            request->recv_size, request->locality->communicators, 
+            request->zero_copy, request);
+
+    return ierr ? MPI_ERR_OTHER : MPI_SUCCESS;
+}
+
+
+// Number of distinct positions in the indices of data
+static int count_distinct(const CommData* data)
+{
+    int n = data->size_msgs;
+    if (n == 0 || data->indices == NULL)
+        return n;
+
+    int max_index = 0;
+    for (int k = 0; k < n; k++)
+        if (data->indices[k] > max_index)
+            max_index = data->indices[k];
+    char* seen = (char*)calloc(max_index+1, sizeof(char));
+    int n_distinct = 0;
+    for (int k = 0; k < n; k++)
+    {
+        if (seen[data->indices[k]])
+            continue;
+        seen[data->indices[k]] = 1;
+        n_distinct++;
+    }
+    free(seen);
+
+    return n_distinct;
+}
+
+int MPIX_Request_duplicate_ratios(MPIX_Request* request, double ratios[4])
+{
+    LocalityComm* locality = request->locality;
+    if (locality == NULL)
+        return MPI_ERR_ARG;
+
+    int sent[4];
+    sent[0] = count_distinct(locality->local_L_comm->send_data);
+    sent[1] = locality->local_S_comm->send_data->size_msgs;
+    sent[2] = locality->local_R_comm->send_data->size_msgs;
+    sent[3] = locality->global_comm->send_data->size_msgs;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (sent[i] && locality->requested_sizes[i] > sent[i])
+            ratios[i] = (double)locality->requested_sizes[i] / sent[i];
+        else
+            ratios[i] = 1.0;
+    }
+
+    return MPI_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#ifndef MPI_ADVANCE_NEIGHBOR_PLAN_H
+#define MPI_ADVANCE_NEIGHBOR_PLAN_H
+
+#include <mpi.h>
+#include <stdlib.h>
+#include "locality/topology.h"
+#include "persistent/persistent.h"
+
+// Declarations of C++ methods
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Hash of the arguments of a locality-aware neighbor alltoallv along
+// with the topology (rank, number of processes, PPN) of comm
+// Never 0 (marks plans that cannot be saved)
+unsigned long hash_locality_pattern(const int sendcounts[],
+        const int sdispls[],
+        const long global_sindices[],
+        MPI_Datatype sendtype,
+        const int recvcounts[],
+        const int rdispls[],
+        const long global_rindices[],
+        MPI_Datatype recvtype,
+        const MPIX_Comm* comm);
+
+// Write the locality-aware plan of request (procs, indptr and indices
+// of all four steps) to filename, one record per rank (collective)
+// Only plans from MPIX_Neighbor_locality_alltoallv_init without a
+// direct threshold can be saved (returns MPI_ERR_ARG otherwise)
+int MPIX_Request_save(MPIX_Request* request, const char* filename);
+
+// New request exchanging sendbuf and recvbuf with the locality-aware
+// plan of request, which it shares : only the persistent requests and
+// staging buffers are created (local, no communication)
+// The plan is freed with the last request using it
+// Each clone uses its own tags, so clones must be created in the same
+// order on every rank (as other locality-aware requests on the comm)
+// Plans with a direct threshold or per-neighbor datatypes (alltoallw),
+// and requests with node-shared local_L, cannot be shared (returns
+// MPI_ERR_ARG)
+int MPIX_Request_clone(MPIX_Request* request, const void* sendbuf,
+        void* recvbuf, MPIX_Request** clone_ptr);
+
+// Point an inactive request at new send and receive buffers, with the
+// same counts and displacements (local, no communication)
+// Locality-aware requests swap pointers, only rebuilding persistent
+// requests on the user buffers (zero-copy, or identity indices), and
+// standard requests rebuild their persistent requests : plans, staging
+// buffers and datatypes are kept
+int MPIX_Request_rebind(MPIX_Request* request, const void* sendbuf,
+        void* recvbuf);
+
+// Exchange k vectors with an inactive request, sending all k values of
+// each index in one message : vector c of index i is element
+// i*index_stride + c*column_stride of sendbuf (recvbuf)
+// Interleaved vectors have index_stride k and column_stride 1, column-
+// major ones index_stride 1 and column_stride the leading dimension
+// (k = 1 and strides of 1 restore the default)
+// Persistent requests and staging buffers are rebuilt, keeping the plan
+// (local, no communication)
+// Locality-aware alltoallw requests, requests with node-shared local_L
+// and messages over INT_MAX elements cannot be blocked (returns
+// MPI_ERR_ARG)
+int MPIX_Request_set_block(MPIX_Request* request, int k,
+        int send_index_stride, int send_column_stride,
+        int recv_index_stride, int recv_column_stride);
+
+// Duplicate ratio of each step of a locality-aware plan on this rank
+// (local_L, local_S, local_R, global) : values requested over values
+// sent once repeated indices are removed (1 if nothing is removed)
+// local_L duplicates (a value sent to several ranks of the node) are
+// only removed with "mpix_shared_local", their ratio is what it saves
+// (local, no communication)
+int MPIX_Request_duplicate_ratios(MPIX_Request* request, double ratios[4]);
+
+// Build the request MPIX_Neighbor_locality_alltoallv_init would, from
+// the plan saved in filename, skipping plan setup (collective)
+// Fails on every rank (request_ptr is set to NULL) if the file is
+// unreadable (MPI_ERR_FILE) or any rank's arguments or topology differ
+// from those of the saved plan (MPI_ERR_ARG)
+int MPIX_Request_load(const char* filename,
+        const void* sendbuf,
+        const int sendcounts[],
+        const int sdispls[],
+        const long global_sindices[],
+        MPI_Datatype sendtype,
+        void* recvbuf,
+        const int recvcounts[],
+        const int rdispls[],
+        const long global_rindices[],
+        MPI_Datatype recvtype,
+        MPIX_Comm* comm,
+        MPI_Info info,
+        MPIX_Request** request_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
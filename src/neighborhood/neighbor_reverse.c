@@ -0,0 +1,241 @@
+#include "neighbor_reverse.h"
+#include "neighbor.h"
+
+// Tags of the reverse steps (distinct from those of the forward steps,
+// which may still be arriving on other ranks)
+#define REVERSE_LOCAL_L_TAG 38201
+#define REVERSE_LOCAL_S_TAG 58302
+#define REVERSE_GLOBAL_TAG 47103
+#define REVERSE_LOCAL_R_TAG 83904
+
+// Round of each value of data : the number of values before it
+// combined into the same position (data->indices)
+static void init_reduce_rounds(const CommData* data, ReduceRounds* rounds)
+{
+    int n = data->size_msgs;
+    int n_slots = 0;
+    for (int i = 0; i < n; i++)
+        if (data->indices[i] >= n_slots)
+            n_slots = data->indices[i] + 1;
+
+    int* slot_count = (int*)calloc(n_slots+1, sizeof(int));
+    int* round = (int*)malloc((n+1)*sizeof(int));
+    rounds->n_rounds = 0;
+    for (int i = 0; i < n; i++)
+    {
+        round[i] = slot_count[data->indices[i]]++;
+        if (round[i] >= rounds->n_rounds)
+            rounds->n_rounds = round[i] + 1;
+    }
+
+    rounds->round_ptr = (int*)calloc(rounds->n_rounds+1, sizeof(int));
+    for (int i = 0; i < n; i++)
+        rounds->round_ptr[round[i]+1]++;
+    for (int r = 0; r < rounds->n_rounds; r++)
+        rounds->round_ptr[r+1] += rounds->round_ptr[r];
+
+    rounds->entries = (int*)malloc((n+1)*sizeof(int));
+    rounds->slots = (int*)malloc((n+1)*sizeof(int));
+    int* next = (int*)malloc((rounds->n_rounds+1)*sizeof(int));
+    for (int r = 0; r < rounds->n_rounds; r++)
+        next[r] = rounds->round_ptr[r];
+    int pos;
+    for (int i = 0; i < n; i++)
+    {
+        pos = next[round[i]]++;
+        rounds->entries[pos] = i;
+        rounds->slots[pos] = data->indices[i];
+    }
+
+    free(next);
+    free(round);
+    free(slot_count);
+}
+
+static char* alloc_values(const CommData* data, int size)
+{
+    return (char*)malloc((size_t)data->size_msgs*size + 1);
+}
+
+static void init_reverse_comm(MPIX_Request* request)
+{
+    LocalityComm* locality = request->locality;
+    int size = request->recv_size;
+    ReverseComm* reverse = (ReverseComm*)malloc(sizeof(ReverseComm));
+
+    init_reduce_rounds(locality->local_L_comm->send_data, &(reverse->local_L_rounds));
+    init_reduce_rounds(locality->local_S_comm->send_data, &(reverse->local_S_rounds));
+    init_reduce_rounds(locality->global_comm->send_data, &(reverse->global_rounds));
+    init_reduce_rounds(locality->local_R_comm->send_data, &(reverse->local_R_rounds));
+
+    reverse->local_L_send = alloc_values(locality->local_L_comm->recv_data, size);
+    reverse->local_L_recv = alloc_values(locality->local_L_comm->send_data, size);
+    reverse->local_R_send = alloc_values(locality->local_R_comm->recv_data, size);
+    reverse->local_R_recv = alloc_values(locality->local_R_comm->send_data, size);
+    reverse->global_values = alloc_values(locality->global_comm->recv_data, size);
+    reverse->global_recv = alloc_values(locality->global_comm->send_data, size);
+    reverse->local_S_values = alloc_values(locality->local_S_comm->recv_data, size);
+    reverse->local_S_recv = alloc_values(locality->local_S_comm->send_data, size);
+
+    // A round holds at most every value received in a step
+    int max_values = locality->local_L_comm->send_data->size_msgs;
+    if (locality->local_S_comm->send_data->size_msgs > max_values)
+        max_values = locality->local_S_comm->send_data->size_msgs;
+    if (locality->global_comm->send_data->size_msgs > max_values)
+        max_values = locality->global_comm->send_data->size_msgs;
+    if (locality->local_R_comm->send_data->size_msgs > max_values)
+        max_values = locality->local_R_comm->send_data->size_msgs;
+    reverse->reduce_in = (char*)malloc((size_t)max_values*size + 1);
+    reverse->reduce_out = (char*)malloc((size_t)max_values*size + 1);
+
+    request->reverse = reverse;
+}
+
+// Combine values (one per position of the received buffer) into data,
+// a round at a time : gather both sides, reduce, and scatter back
+// With overwrite_first, the first round writes data instead (every
+// position of data has at least one value)
+static void reduce_rounds(const MPIX_Request* request, const ReduceRounds* rounds,
+        const char* values, char* data, int overwrite_first,
+        MPI_Datatype type, MPI_Op op)
+{
+    ReverseComm* reverse = request->reverse;
+    int size = request->recv_size;
+    int start, n;
+    for (int r = 0; r < rounds->n_rounds; r++)
+    {
+        start = rounds->round_ptr[r];
+        n = rounds->round_ptr[r+1] - start;
+        request->pack(reverse->reduce_in, values, &(rounds->entries[start]), n, size);
+        if (r == 0 && overwrite_first)
+        {
+            request->unpack(data, reverse->reduce_in, &(rounds->slots[start]), n, size);
+            continue;
+        }
+        request->pack(reverse->reduce_out, data, &(rounds->slots[start]), n, size);
+        MPI_Reduce_local(reverse->reduce_in, reverse->reduce_out, n, type, op);
+        request->unpack(data, reverse->reduce_out, &(rounds->slots[start]), n, size);
+    }
+}
+
+// Post the messages of a forward step in reverse : recvs from its
+// destinations into recv_buffer (laid out as its send buffer), and
+// sends to its sources from send_buffer (laid out as its recv buffer)
+static int start_reverse(const CommPkg* comm_pkg, const char* send_buffer,
+        char* recv_buffer, int size, int tag, MPI_Comm comm,
+        MPI_Request* requests)
+{
+    int ierr = 0;
+    int start, end;
+    const CommData* recv_data = comm_pkg->send_data;
+    const CommData* send_data = comm_pkg->recv_data;
+
+    for (int i = 0; i < recv_data->num_msgs; i++)
+    {
+        start = recv_data->indptr[i];
+        end = recv_data->indptr[i+1];
+        ierr += MPI_Irecv(&(recv_buffer[(size_t)start*size]), (end - start)*size,
+                MPI_BYTE, recv_data->procs[i], tag, comm, &(requests[i]));
+    }
+
+    for (int i = 0; i < send_data->num_msgs; i++)
+    {
+        start = send_data->indptr[i];
+        end = send_data->indptr[i+1];
+        ierr += MPI_Isend(&(send_buffer[(size_t)start*size]), (end - start)*size,
+                MPI_BYTE, send_data->procs[i], tag, comm,
+                &(requests[recv_data->num_msgs+i]));
+    }
+
+    return ierr;
+}
+
+static int n_step_msgs(const CommPkg* comm_pkg)
+{
+    return comm_pkg->send_data->num_msgs + comm_pkg->recv_data->num_msgs;
+}
+
+int MPIX_Neighbor_reverse(MPIX_Request* request,
+        const void* recvbuffer,
+        void* sendbuffer,
+        MPI_Datatype type,
+        MPI_Op op)
+{
+    LocalityComm* locality = request->locality;
+    if (request->active)
+        return MPI_ERR_REQUEST;
+    if (locality == NULL || request->packed || request->direct_n_msgs
+            || request->block_size != 1 || request->send_index_stride != 1
+            || request->recv_index_stride != 1)
+        return MPI_ERR_ARG;
+
+    int size = request->recv_size;
+    int type_size;
+    MPI_Type_size(type, &type_size);
+    if (type_size != size)
+        return MPI_ERR_TYPE;
+
+    if (request->reverse == NULL)
+        init_reverse_comm(request);
+    ReverseComm* reverse = request->reverse;
+    const MPIX_Comm* comm = locality->communicators;
+    CommPkg* local_L_comm = locality->local_L_comm;
+    CommPkg* local_S_comm = locality->local_S_comm;
+    CommPkg* global_comm = locality->global_comm;
+    CommPkg* local_R_comm = locality->local_R_comm;
+
+    int ierr = 0;
+    int n_local_L = n_step_msgs(local_L_comm);
+    int n_local_S = n_step_msgs(local_S_comm);
+    int n_global = n_step_msgs(global_comm);
+    int n_local_R = n_step_msgs(local_R_comm);
+    MPI_Request* local_L_requests = (MPI_Request*)malloc((n_local_L+1)*sizeof(MPI_Request));
+    MPI_Request* local_S_requests = (MPI_Request*)malloc((n_local_S+1)*sizeof(MPI_Request));
+    MPI_Request* global_requests = (MPI_Request*)malloc((n_global+1)*sizeof(MPI_Request));
+    MPI_Request* local_R_requests = (MPI_Request*)malloc((n_local_R+1)*sizeof(MPI_Request));
+
+    // Local R and local L : values of recvbuf back to the ranks that
+    // received them from other nodes, and to their on-node owners
+    request->pack(reverse->local_R_send, (const char*)recvbuffer,
+            local_R_comm->recv_data->indices, local_R_comm->recv_data->size_msgs, size);
+    request->pack(reverse->local_L_send, (const char*)recvbuffer,
+            local_L_comm->recv_data->indices, local_L_comm->recv_data->size_msgs, size);
+    ierr += start_reverse(local_R_comm, reverse->local_R_send, reverse->local_R_recv,
+            size, REVERSE_LOCAL_R_TAG + request->tag_offset, comm->local_comm,
+            local_R_requests);
+    ierr += start_reverse(local_L_comm, reverse->local_L_send, reverse->local_L_recv,
+            size, REVERSE_LOCAL_L_TAG + request->tag_offset, comm->local_comm,
+            local_L_requests);
+
+    // Values for the same global index are combined on node, so each
+    // crosses the network once
+    ierr += MPI_Waitall(n_local_R, local_R_requests, MPI_STATUSES_IGNORE);
+    reduce_rounds(request, &(reverse->local_R_rounds), reverse->local_R_recv,
+            reverse->global_values, 1, type, op);
+
+    // Global : back to the nodes owning each global index
+    ierr += start_reverse(global_comm, reverse->global_values, reverse->global_recv,
+            size, REVERSE_GLOBAL_TAG + request->tag_offset, comm->global_comm,
+            global_requests);
+    ierr += MPI_Waitall(n_global, global_requests, MPI_STATUSES_IGNORE);
+    reduce_rounds(request, &(reverse->global_rounds), reverse->global_recv,
+            reverse->local_S_values, 1, type, op);
+
+    // Local S : back to the owners
+    ierr += start_reverse(local_S_comm, reverse->local_S_values, reverse->local_S_recv,
+            size, REVERSE_LOCAL_S_TAG + request->tag_offset, comm->local_comm,
+            local_S_requests);
+    ierr += MPI_Waitall(n_local_L, local_L_requests, MPI_STATUSES_IGNORE);
+    reduce_rounds(request, &(reverse->local_L_rounds), reverse->local_L_recv,
+            (char*)sendbuffer, 0, type, op);
+    ierr += MPI_Waitall(n_local_S, local_S_requests, MPI_STATUSES_IGNORE);
+    reduce_rounds(request, &(reverse->local_S_rounds), reverse->local_S_recv,
+            (char*)sendbuffer, 0, type, op);
+
+    free(local_L_requests);
+    free(local_S_requests);
+    free(global_requests);
+    free(local_R_requests);
+
+    return ierr;
+}
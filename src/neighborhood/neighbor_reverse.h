@@ -0,0 +1,36 @@
+#ifndef MPI_ADVANCE_NEIGHBOR_REVERSE_H
+#define MPI_ADVANCE_NEIGHBOR_REVERSE_H
+
+#include <mpi.h>
+#include <stdlib.h>
+#include "locality/topology.h"
+#include "persistent/persistent.h"
+
+// Declarations of C++ methods
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Reverse of the exchange of an inactive locality-aware request (e.g.
+// transpose SpMV, finite-element assembly) : each value of recvbuffer
+// (laid out as the request's recvbuf) goes back to the rank that sent
+// it, and is combined with op into sendbuffer (laid out as the request's
+// sendbuf), at the position the plan reads its global index from
+// Steps run in reverse (local_R, global, then local_S, with local_L
+// alongside), and values for the same global index are combined on
+// each node before they cross the network (collective)
+// op is a built-in operation on type, of the request's element size
+// Requests with a direct threshold, per-neighbor datatypes (alltoallw)
+// or in block mode cannot be reversed (returns MPI_ERR_ARG)
+int MPIX_Neighbor_reverse(MPIX_Request* request,
+        const void* recvbuffer,
+        void* sendbuffer,
+        MPI_Datatype type,
+        MPI_Op op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
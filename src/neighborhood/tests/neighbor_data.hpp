@@ -155,4 +155,47 @@ void form_global_indices(int local_size, MPIX_Data<U> send_data, MPIX_Data<U> re
 }
 
 
+// Random communication with global indices, along with a standard
+// dist graph communicator (over the reversed graph if reverse) and an
+// MPIX one with 4 processes per node
+struct NeighborSetup
+{
+    MPIX_Data<int> send_data;
+    MPIX_Data<int> recv_data;
+    std::vector<long> global_send_idx;
+    std::vector<long> global_recv_idx;
+    MPI_Comm std_comm;
+    MPIX_Comm* neighbor_comm;
+};
+
+inline void form_neighbor_setup(int local_size, NeighborSetup& setup, bool reverse = false)
+{
+    MPIX_Data<int>& send_data = setup.send_data;
+    MPIX_Data<int>& recv_data = setup.recv_data;
+    form_initial_communicator(local_size, &send_data, &recv_data);
+    setup.global_send_idx.resize(send_data.size_msgs);
+    setup.global_recv_idx.resize(recv_data.size_msgs);
+    form_global_indices(local_size, send_data, recv_data,
+            setup.global_send_idx, setup.global_recv_idx);
+
+    MPIX_Data<int>& std_recv = reverse ? send_data : recv_data;
+    MPIX_Data<int>& std_send = reverse ? recv_data : send_data;
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            std_recv.num_msgs, std_recv.procs.data(), std_recv.counts.data(),
+            std_send.num_msgs, std_send.procs.data(), std_send.counts.data(),
+            MPI_INFO_NULL, 0, &(setup.std_comm));
+    MPIX_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            recv_data.num_msgs, recv_data.procs.data(), recv_data.counts.data(),
+            send_data.num_msgs, send_data.procs.data(), send_data.counts.data(),
+            MPI_INFO_NULL, 0, &(setup.neighbor_comm));
+    update_locality(setup.neighbor_comm, 4);
+}
+
+inline void free_neighbor_setup(NeighborSetup& setup)
+{
+    MPIX_Comm_free(setup.neighbor_comm);
+    MPI_Comm_free(&(setup.std_comm));
+}
+
+
 #endif
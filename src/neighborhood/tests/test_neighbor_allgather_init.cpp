@@ -0,0 +1,175 @@
+// EXPECT_EQ and ASSERT_EQ are macros
+// EXPECT_EQ test execution and continues even if there is a failure
+// ASSERT_EQ test execution and aborts if there is a failure
+// The ASSERT_* variants abort the program execution if an assertion fails
+// while EXPECT_* variants continue with the run.
+
+
+#include "gtest/gtest.h"
+#include "mpi_advance.h"
+#include <mpi.h>
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <assert.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "neighbor_data.hpp"
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    ::testing::InitGoogleTest(&argc, argv);
+    int temp=RUN_ALL_TESTS();
+    MPI_Finalize();
+    return temp;
+} // end of main() //
+
+
+TEST(RandomCommTest, TestsInTests)
+{
+    // Get MPI Information
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // Random neighborhood (only the procs are used)
+    int local_size = 10000;
+    MPIX_Data<int> send_data;
+    MPIX_Data<int> recv_data;
+    form_initial_communicator(local_size, &send_data, &recv_data);
+
+    // Payload size varies per rank
+    int sendcount = 3 + (rank % 4);
+    std::vector<int> send_vals(8);
+    for (int i = 0; i < 8; i++)
+        send_vals[i] = rank*100 + i;
+
+    std::vector<int> recvcounts(recv_data.num_msgs);
+    std::vector<int> displs(recv_data.num_msgs+1);
+    displs[0] = 0;
+    for (int i = 0; i < recv_data.num_msgs; i++)
+    {
+        recvcounts[i] = 3 + (recv_data.procs[i] % 4);
+        displs[i+1] = displs[i] + recvcounts[i];
+    }
+    int recv_size = displs[recv_data.num_msgs];
+
+    MPI_Comm std_comm;
+    MPI_Status status;
+    MPIX_Comm* neighbor_comm;
+    MPIX_Request* neighbor_request;
+
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            recv_data.num_msgs,
+            recv_data.procs.data(), 
+            MPI_UNWEIGHTED,
+            send_data.num_msgs, 
+            send_data.procs.data(),
+            MPI_UNWEIGHTED,
+            MPI_INFO_NULL, 
+            0, 
+            &std_comm);
+    MPIX_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            recv_data.num_msgs, 
+            recv_data.procs.data(), 
+            MPI_UNWEIGHTED,
+            send_data.num_msgs, 
+            send_data.procs.data(),
+            MPI_UNWEIGHTED,
+            MPI_INFO_NULL, 
+            0, 
+            &neighbor_comm);
+
+    // Update Locality : 4 PPN (for single-node tests)
+    update_locality(neighbor_comm, 4);
+
+    // Standard MPI Implementation of Allgatherv
+    std::vector<int> std_recv_vals(recv_size);
+    MPI_Neighbor_allgatherv(send_vals.data(),
+            sendcount,
+            MPI_INT,
+            std_recv_vals.data(),
+            recvcounts.data(),
+            displs.data(),
+            MPI_INT,
+            std_comm);
+    for (int i = 0; i < recv_data.num_msgs; i++)
+        for (int j = 0; j < recvcounts[i]; j++)
+            ASSERT_EQ(std_recv_vals[displs[i]+j], recv_data.procs[i]*100 + j);
+
+    // Standard Persistent Allgatherv
+    std::vector<int> persistent_recv_vals(recv_size, -1);
+    MPIX_Neighbor_allgatherv_init(send_vals.data(),
+            sendcount,
+            MPI_INT,
+            persistent_recv_vals.data(),
+            recvcounts.data(),
+            displs.data(),
+            MPI_INT,
+            neighbor_comm,
+            MPI_INFO_NULL,
+            &neighbor_request);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (int i = 0; i < recv_size; i++)
+        ASSERT_EQ(std_recv_vals[i], persistent_recv_vals[i]);
+
+    // Blocking Allgatherv
+    std::vector<int> blocking_recv_vals(recv_size, -1);
+    MPIX_Neighbor_allgatherv(send_vals.data(),
+            sendcount,
+            MPI_INT,
+            blocking_recv_vals.data(),
+            recvcounts.data(),
+            displs.data(),
+            MPI_INT,
+            neighbor_comm);
+    for (int i = 0; i < recv_size; i++)
+        ASSERT_EQ(std_recv_vals[i], blocking_recv_vals[i]);
+
+    // Locality-Aware Persistent Allgatherv
+    std::vector<int> loc_recv_vals(recv_size);
+    MPIX_Neighbor_locality_allgatherv_init(send_vals.data(),
+            sendcount,
+            MPI_INT,
+            loc_recv_vals.data(),
+            recvcounts.data(),
+            displs.data(),
+            MPI_INT,
+            neighbor_comm,
+            MPI_INFO_NULL,
+            &neighbor_request);
+    for (int iter = 0; iter < 2; iter++)
+    {
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        for (int i = 0; i < recv_size; i++)
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+    }
+    MPIX_Request_free(neighbor_request);
+
+    // Allgather : fixed size payload
+    int count = 5;
+    std::vector<int> std_gather_vals(count*recv_data.num_msgs);
+    std::vector<int> loc_gather_vals(count*recv_data.num_msgs, -1);
+    MPI_Neighbor_allgather(send_vals.data(), count, MPI_INT,
+            std_gather_vals.data(), count, MPI_INT, std_comm);
+
+    MPIX_Neighbor_locality_allgather_init(send_vals.data(), count, MPI_INT,
+            loc_gather_vals.data(), count, MPI_INT, neighbor_comm, 
+            MPI_INFO_NULL, &neighbor_request);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (int i = 0; i < count*recv_data.num_msgs; i++)
+        ASSERT_EQ(std_gather_vals[i], loc_gather_vals[i]);
+
+    MPIX_Comm_free(neighbor_comm);
+    MPI_Comm_free(&std_comm);
+}
+
@@ -14,6 +14,8 @@
 #include <assert.h>
 #include <vector>
 #include <set>
+#include <map>
+#include <algorithm>
 
 #include "neighbor_data.hpp"
 
@@ -27,6 +29,36 @@ int main(int argc, char** argv)
 } // end of main() //
 
 
+// Per-source callback : counts calls and checks the source's data
+// (expected[indptr[source]] onwards) is already in recvbuf
+struct CallbackCheck
+{
+    std::vector<int> calls;
+    const int* recvbuf;
+    const int* expected;
+    const int* indptr;
+    int errors;
+};
+
+static void check_source(int source, void* data)
+{
+    CallbackCheck* check = (CallbackCheck*)data;
+    check->calls[source]++;
+    for (int j = check->indptr[source]; j < check->indptr[source+1]; j++)
+        if (check->recvbuf[j] != check->expected[j])
+            check->errors++;
+}
+
+static void init_callback_check(CallbackCheck& check, int n_sources,
+        const int* recvbuf, const int* expected, const int* indptr)
+{
+    check.calls.assign(n_sources, 0);
+    check.recvbuf = recvbuf;
+    check.expected = expected;
+    check.indptr = indptr;
+    check.errors = 0;
+}
+
 TEST(RandomCommTest, TestsInTests)
 {
     // Get MPI Information
@@ -48,6 +80,7 @@ TEST(RandomCommTest, TestsInTests)
     std::vector<int> persistent_recv_vals(recv_data.size_msgs);
     std::vector<int> part_recv_vals(recv_data.size_msgs);
     std::vector<int> loc_recv_vals(recv_data.size_msgs);
+    std::vector<int> large_recv_vals(recv_data.size_msgs);
 
     std::vector<int> send_vals(local_size);
     int val = local_size*rank;
@@ -89,6 +122,14 @@ TEST(RandomCommTest, TestsInTests)
             0, 
             &neighbor_comm);
 
+    // Neighbor lists are cached in the MPIX_Comm
+    ASSERT_EQ(neighbor_comm->indegree, recv_data.num_msgs);
+    ASSERT_EQ(neighbor_comm->outdegree, send_data.num_msgs);
+    for (int i = 0; i < recv_data.num_msgs; i++)
+        ASSERT_EQ(neighbor_comm->sources[i], recv_data.procs[i]);
+    for (int i = 0; i < send_data.num_msgs; i++)
+        ASSERT_EQ(neighbor_comm->destinations[i], send_data.procs[i]);
+
     // Update Locality : 4 PPN (for single-node tests)
     update_locality(neighbor_comm, 4);
 
@@ -126,6 +167,40 @@ TEST(RandomCommTest, TestsInTests)
 
     }
 
+    // Large-Count Persistent MPI Advance Implementation
+    std::vector<MPI_Count> send_counts_c(send_data.num_msgs);
+    std::vector<MPI_Aint> send_displs_c(send_data.num_msgs);
+    std::vector<MPI_Count> recv_counts_c(recv_data.num_msgs);
+    std::vector<MPI_Aint> recv_displs_c(recv_data.num_msgs);
+    for (int i = 0; i < send_data.num_msgs; i++)
+    {
+        send_counts_c[i] = send_data.counts[i];
+        send_displs_c[i] = send_data.indptr[i];
+    }
+    for (int i = 0; i < recv_data.num_msgs; i++)
+    {
+        recv_counts_c[i] = recv_data.counts[i];
+        recv_displs_c[i] = recv_data.indptr[i];
+    }
+    MPIX_Neighbor_alltoallv_init_c(alltoallv_send_vals.data(), 
+            send_counts_c.data(),
+            send_displs_c.data(), 
+            MPI_INT,
+            large_recv_vals.data(), 
+            recv_counts_c.data(),
+            recv_displs_c.data(), 
+            MPI_INT,
+            neighbor_comm, 
+            MPI_INFO_NULL,
+            &neighbor_request);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (int i = 0; i < recv_data.size_msgs; i++)
+    {
+        ASSERT_EQ(std_recv_vals[i], large_recv_vals[i]);
+    }
+
     // Locality-Aware MPI Advance Implementation
     MPIX_Neighbor_locality_alltoallv_init(alltoallv_send_vals.data(), 
             send_data.counts.data(),
@@ -148,6 +223,165 @@ TEST(RandomCommTest, TestsInTests)
         ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
     }
 
+    // Zero-Copy Locality-Aware MPI Advance Implementation
+    std::vector<int> zero_copy_recv_vals(recv_data.size_msgs);
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "mpix_zero_copy", "true");
+    MPIX_Neighbor_locality_alltoallv_init(alltoallv_send_vals.data(), 
+            send_data.counts.data(),
+            send_data.indptr.data(), 
+            global_send_idx.data(),
+            MPI_INT,
+            zero_copy_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            global_recv_idx.data(),
+            MPI_INT,
+            neighbor_comm, 
+            info,
+            &neighbor_request);
+    MPI_Info_free(&info);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (int i = 0; i < recv_data.size_msgs; i++)
+    {
+        ASSERT_EQ(std_recv_vals[i], zero_copy_recv_vals[i]);
+    }
+
+    // Hybrid Locality-Aware : off-node messages above the threshold
+    // (all, then only those over 40 bytes) are sent directly
+    const char* thresholds[2] = {"0", "40"};
+    for (int t = 0; t < 2; t++)
+    {
+        std::vector<int> hybrid_recv_vals(recv_data.size_msgs, -1);
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "mpix_direct_threshold", thresholds[t]);
+        MPIX_Neighbor_locality_alltoallv_init(alltoallv_send_vals.data(), 
+                send_data.counts.data(),
+                send_data.indptr.data(), 
+                global_send_idx.data(),
+                MPI_INT,
+                hybrid_recv_vals.data(), 
+                recv_data.counts.data(),
+                recv_data.indptr.data(), 
+                global_recv_idx.data(),
+                MPI_INT,
+                neighbor_comm, 
+                info,
+                &neighbor_request);
+        MPI_Info_free(&info);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        MPIX_Request_free(neighbor_request);
+        for (int i = 0; i < recv_data.size_msgs; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], hybrid_recv_vals[i]);
+        }
+    }
+
+    // Hybrid with callbacks : direct and aggregated sources each fire
+    // once, after their data is unpacked
+    std::vector<int> hybrid_recv_vals(recv_data.size_msgs, -1);
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "mpix_direct_threshold", "0");
+    MPIX_Neighbor_locality_alltoallv_init(alltoallv_send_vals.data(), 
+            send_data.counts.data(),
+            send_data.indptr.data(), 
+            global_send_idx.data(),
+            MPI_INT,
+            hybrid_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            global_recv_idx.data(),
+            MPI_INT,
+            neighbor_comm, 
+            info,
+            &neighbor_request);
+    MPI_Info_free(&info);
+    CallbackCheck check;
+    init_callback_check(check, recv_data.num_msgs, hybrid_recv_vals.data(),
+            std_recv_vals.data(), recv_data.indptr.data());
+    MPIX_Request_set_callback(neighbor_request, check_source, &check);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    MPIX_Request_free(neighbor_request);
+    for (int i = 0; i < recv_data.num_msgs; i++)
+        ASSERT_EQ(check.calls[i], 1);
+    ASSERT_EQ(check.errors, 0);
+
+    // Blocking Locality-Aware : repeated calls reuse the cached request
+    for (int iter = 0; iter < 3; iter++)
+    {
+        for (int i = 0; i < send_data.size_msgs; i++)
+            alltoallv_send_vals[i] += iter;
+        MPI_Neighbor_alltoallv(alltoallv_send_vals.data(), 
+                send_data.counts.data(),
+                send_data.indptr.data(), 
+                MPI_INT,
+                std_recv_vals.data(), 
+                recv_data.counts.data(),
+                recv_data.indptr.data(), 
+                MPI_INT,
+                std_comm);
+        MPIX_Neighbor_locality_alltoallv(alltoallv_send_vals.data(), 
+                send_data.counts.data(),
+                send_data.indptr.data(), 
+                global_send_idx.data(),
+                MPI_INT,
+                loc_recv_vals.data(), 
+                recv_data.counts.data(),
+                recv_data.indptr.data(), 
+                global_recv_idx.data(),
+                MPI_INT,
+                neighbor_comm);
+        for (int i = 0; i < recv_data.size_msgs; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+        }
+        ASSERT_EQ(neighbor_comm->neighbor_cache->n_entries, 1);
+    }
+
+    // Derived datatypes are never cached (freed handles can be reused)
+    MPI_Datatype int_type;
+    MPI_Type_contiguous(1, MPI_INT, &int_type);
+    MPI_Type_commit(&int_type);
+    neighbor_cache_clear(neighbor_comm);
+    MPIX_Neighbor_alltoallv(alltoallv_send_vals.data(), 
+            send_data.counts.data(),
+            send_data.indptr.data(), 
+            int_type,
+            persistent_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            int_type,
+            neighbor_comm);
+    ASSERT_EQ(neighbor_comm->neighbor_cache->n_entries, 0);
+    for (int i = 0; i < recv_data.size_msgs; i++)
+    {
+        ASSERT_EQ(std_recv_vals[i], persistent_recv_vals[i]);
+    }
+    MPI_Type_free(&int_type);
+
+    // Caching disabled : request is rebuilt every call
+    MPIX_Comm_set_neighbor_cache_size(neighbor_comm, 0);
+    ASSERT_EQ(neighbor_comm->neighbor_cache->n_entries, 0);
+    MPIX_Neighbor_alltoallv(alltoallv_send_vals.data(), 
+            send_data.counts.data(),
+            send_data.indptr.data(), 
+            MPI_INT,
+            persistent_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            MPI_INT,
+            neighbor_comm);
+    ASSERT_EQ(neighbor_comm->neighbor_cache->n_entries, 0);
+    for (int i = 0; i < recv_data.size_msgs; i++)
+    {
+        ASSERT_EQ(std_recv_vals[i], persistent_recv_vals[i]);
+    }
+
 /*
     // Partial Locality-Aware MPI Advance Implementation
     MPIX_Neighbor_part_locality_alltoallv_init(alltoallv_send_vals.data(), 
@@ -176,3 +410,1228 @@ TEST(RandomCommTest, TestsInTests)
 
 }
 
+
+// Locality-aware exchange for each specialized pack/unpack kernel
+// (element sizes 4, 8, 16, 24 and the generic 12 bytes)
+TEST(PackKernelTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+    MPI_Status status;
+    MPIX_Request* neighbor_request;
+
+    int widths[5] = {1, 2, 4, 6, 3};
+    for (int w = 0; w < 5; w++)
+    {
+        int width = widths[w];
+        MPI_Datatype type;
+        MPI_Type_contiguous(width, MPI_INT, &type);
+        MPI_Type_commit(&type);
+
+        std::vector<int> send_vals(setup.send_data.size_msgs*width);
+        for (int i = 0; i < setup.send_data.size_msgs*width; i++)
+            send_vals[i] = rank*100000 + i;
+        std::vector<int> std_recv_vals(setup.recv_data.size_msgs*width);
+        std::vector<int> loc_recv_vals(setup.recv_data.size_msgs*width);
+
+        MPI_Neighbor_alltoallv(send_vals.data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                type,
+                std_recv_vals.data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                type,
+                setup.std_comm);
+
+        MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                setup.global_send_idx.data(),
+                type,
+                loc_recv_vals.data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                setup.global_recv_idx.data(),
+                type,
+                setup.neighbor_comm, 
+                MPI_INFO_NULL,
+                &neighbor_request);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        MPIX_Request_free(neighbor_request);
+
+        for (int i = 0; i < setup.recv_data.size_msgs*width; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+        }
+
+        MPI_Type_free(&type);
+    }
+
+    // Kernels against the generic copy, over lengths covering the
+    // vector loops and their remainders (ENABLE_AVX2 builds)
+    int sizes[5] = {4, 8, 16, 24, 12};
+    std::vector<char> data(64*24);
+    for (int i = 0; i < (int)data.size(); i++)
+        data[i] = (char)(i*7 + rank);
+    std::vector<int> indices(20);
+    for (int i = 0; i < 20; i++)
+        indices[i] = (i*13) % 64;
+    pack_func pack;
+    unpack_func unpack;
+    for (int s = 0; s < 5; s++)
+    {
+        int size = sizes[s];
+        select_pack_kernels(size, &pack, &unpack);
+        for (int n = 0; n <= 20; n++)
+        {
+            std::vector<char> buffer(n*size + 1);
+            std::vector<char> expected(n*size + 1);
+            pack(buffer.data(), data.data(), indices.data(), n, size);
+            pack_generic(expected.data(), data.data(), indices.data(), n, size);
+            for (int i = 0; i < n*size; i++)
+                ASSERT_EQ(buffer[i], expected[i]);
+
+            std::vector<char> unpacked(data.size(), 0);
+            std::vector<char> unpacked_expected(data.size(), 0);
+            unpack(unpacked.data(), buffer.data(), indices.data(), n, size);
+            unpack_generic(unpacked_expected.data(), buffer.data(), indices.data(), n, size);
+            for (int i = 0; i < (int)data.size(); i++)
+                ASSERT_EQ(unpacked[i], unpacked_expected[i]);
+        }
+    }
+
+    free_neighbor_setup(setup);
+}
+
+// Locality-aware plan saved to a file and loaded into a new request
+TEST(PlanSaveLoadTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+    MPI_Status status;
+    MPIX_Request* neighbor_request;
+
+    std::vector<int> send_vals(setup.send_data.size_msgs);
+    for (int i = 0; i < setup.send_data.size_msgs; i++)
+        send_vals[i] = rank*10000 + i;
+    std::vector<int> std_recv_vals(setup.recv_data.size_msgs);
+    std::vector<int> loc_recv_vals(setup.recv_data.size_msgs);
+
+    MPI_Neighbor_alltoallv(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            MPI_INT,
+            std_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            MPI_INT,
+            setup.std_comm);
+
+    const char* filename = "test_neighbor_plan.bin";
+    MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            loc_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            &neighbor_request);
+    ASSERT_EQ(MPIX_Request_save(neighbor_request, filename), MPI_SUCCESS);
+    MPIX_Request_free(neighbor_request);
+
+    // Loaded plan, with and without staging copies
+    for (int zero_copy = 0; zero_copy < 2; zero_copy++)
+    {
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "mpix_zero_copy", zero_copy ? "true" : "false");
+        ASSERT_EQ(MPIX_Request_load(filename,
+                send_vals.data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                setup.global_send_idx.data(),
+                MPI_INT,
+                loc_recv_vals.data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                setup.global_recv_idx.data(),
+                MPI_INT,
+                setup.neighbor_comm, 
+                info,
+                &neighbor_request), MPI_SUCCESS);
+        MPI_Info_free(&info);
+
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        MPIX_Request_free(neighbor_request);
+        for (int i = 0; i < setup.recv_data.size_msgs; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+        }
+    }
+
+    // A different pattern on any rank fails the load everywhere
+    if (rank == 0 && setup.recv_data.size_msgs)
+        setup.global_recv_idx[0]++;
+    ASSERT_NE(MPIX_Request_load(filename,
+            send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            loc_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            &neighbor_request), MPI_SUCCESS);
+    ASSERT_TRUE(neighbor_request == NULL);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0)
+        MPI_File_delete(filename, MPI_INFO_NULL);
+
+    free_neighbor_setup(setup);
+}
+
+// Several fields exchanged with clones sharing one locality-aware plan
+TEST(RequestCloneTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+    MPI_Status status;
+
+    int n_fields = 4;
+    std::vector<std::vector<int>> send_vals(n_fields);
+    std::vector<std::vector<int>> std_recv_vals(n_fields);
+    std::vector<std::vector<int>> loc_recv_vals(n_fields);
+    for (int f = 0; f < n_fields; f++)
+    {
+        send_vals[f].resize(setup.send_data.size_msgs);
+        for (int i = 0; i < setup.send_data.size_msgs; i++)
+            send_vals[f][i] = f*1000000 + rank*10000 + i;
+        std_recv_vals[f].resize(setup.recv_data.size_msgs);
+        loc_recv_vals[f].resize(setup.recv_data.size_msgs);
+        MPI_Neighbor_alltoallv(send_vals[f].data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                MPI_INT,
+                std_recv_vals[f].data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                MPI_INT,
+                setup.std_comm);
+    }
+
+    for (int zero_copy = 0; zero_copy < 2; zero_copy++)
+    {
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "mpix_zero_copy", zero_copy ? "true" : "false");
+        std::vector<MPIX_Request*> requests(n_fields);
+        MPIX_Neighbor_locality_alltoallv_init(send_vals[0].data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                setup.global_send_idx.data(),
+                MPI_INT,
+                loc_recv_vals[0].data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                setup.global_recv_idx.data(),
+                MPI_INT,
+                setup.neighbor_comm, 
+                info,
+                &(requests[0]));
+        MPI_Info_free(&info);
+        for (int f = 1; f < n_fields; f++)
+        {
+            ASSERT_EQ(MPIX_Request_clone(requests[0], send_vals[f].data(),
+                    loc_recv_vals[f].data(), &(requests[f])), MPI_SUCCESS);
+            ASSERT_TRUE(requests[f]->locality == requests[0]->locality);
+        }
+
+        // All fields in flight at once
+        for (int f = 0; f < n_fields; f++)
+            std::fill(loc_recv_vals[f].begin(), loc_recv_vals[f].end(), -1);
+        MPIX_Startall(n_fields, requests.data());
+        MPIX_Waitall(n_fields, requests.data(), MPI_STATUSES_IGNORE);
+        for (int f = 0; f < n_fields; f++)
+            for (int i = 0; i < setup.recv_data.size_msgs; i++)
+            {
+                ASSERT_EQ(std_recv_vals[f][i], loc_recv_vals[f][i]);
+            }
+
+        // Clones outlive the request that built the plan
+        MPIX_Request_free(requests[0]);
+        for (int f = 1; f < n_fields; f++)
+        {
+            std::fill(loc_recv_vals[f].begin(), loc_recv_vals[f].end(), -1);
+            MPIX_Start(requests[f]);
+            MPIX_Wait(requests[f], &status);
+            for (int i = 0; i < setup.recv_data.size_msgs; i++)
+            {
+                ASSERT_EQ(std_recv_vals[f][i], loc_recv_vals[f][i]);
+            }
+            MPIX_Request_free(requests[f]);
+        }
+    }
+
+    free_neighbor_setup(setup);
+}
+
+// Ping-pong between two pairs of buffers with a single request
+TEST(RequestRebindTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+    MPI_Status status;
+
+    std::vector<int> send_vals[2];
+    std::vector<int> std_recv_vals[2];
+    std::vector<int> recv_vals[2];
+    for (int b = 0; b < 2; b++)
+    {
+        send_vals[b].resize(setup.send_data.size_msgs);
+        for (int i = 0; i < setup.send_data.size_msgs; i++)
+            send_vals[b][i] = b*1000000 + rank*10000 + i;
+        std_recv_vals[b].resize(setup.recv_data.size_msgs);
+        recv_vals[b].resize(setup.recv_data.size_msgs);
+        MPI_Neighbor_alltoallv(send_vals[b].data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                MPI_INT,
+                std_recv_vals[b].data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                MPI_INT,
+                setup.std_comm);
+    }
+
+    // 0 : standard, 1 : locality-aware, 2 : zero-copy, 3 : hybrid
+    for (int variant = 0; variant < 4; variant++)
+    {
+        MPI_Info info;
+        MPI_Info_create(&info);
+        if (variant == 2)
+            MPI_Info_set(info, "mpix_zero_copy", "true");
+        if (variant == 3)
+            MPI_Info_set(info, "mpix_direct_threshold", "0");
+
+        MPIX_Request* request;
+        if (variant == 0)
+            MPIX_Neighbor_alltoallv_init(send_vals[0].data(), 
+                    setup.send_data.counts.data(),
+                    setup.send_data.indptr.data(), 
+                    MPI_INT,
+                    recv_vals[0].data(), 
+                    setup.recv_data.counts.data(),
+                    setup.recv_data.indptr.data(), 
+                    MPI_INT,
+                    setup.neighbor_comm, 
+                    info,
+                    &request);
+        else
+            MPIX_Neighbor_locality_alltoallv_init(send_vals[0].data(), 
+                    setup.send_data.counts.data(),
+                    setup.send_data.indptr.data(), 
+                    setup.global_send_idx.data(),
+                    MPI_INT,
+                    recv_vals[0].data(), 
+                    setup.recv_data.counts.data(),
+                    setup.recv_data.indptr.data(), 
+                    setup.global_recv_idx.data(),
+                    MPI_INT,
+                    setup.neighbor_comm, 
+                    info,
+                    &request);
+        MPI_Info_free(&info);
+
+        LocalityComm* locality = request->locality;
+        int n_datatypes = request->n_datatypes;
+        for (int iter = 0; iter < 4; iter++)
+        {
+            int b = iter % 2;
+            ASSERT_EQ(MPIX_Request_rebind(request, send_vals[b].data(),
+                    recv_vals[b].data()), MPI_SUCCESS);
+            std::fill(recv_vals[b].begin(), recv_vals[b].end(), -1);
+            std::fill(recv_vals[1-b].begin(), recv_vals[1-b].end(), -1);
+            MPIX_Start(request);
+            MPIX_Wait(request, &status);
+            for (int i = 0; i < setup.recv_data.size_msgs; i++)
+            {
+                ASSERT_EQ(std_recv_vals[b][i], recv_vals[b][i]);
+                ASSERT_EQ(-1, recv_vals[1-b][i]);
+            }
+
+            // Nothing is rebuilt beyond the persistent requests
+            ASSERT_TRUE(request->locality == locality);
+            ASSERT_EQ(request->n_datatypes, n_datatypes);
+        }
+
+        // Started requests cannot be rebound
+        MPIX_Start(request);
+        ASSERT_EQ(MPIX_Request_rebind(request, send_vals[1].data(),
+                recv_vals[1].data()), MPI_ERR_REQUEST);
+        MPIX_Wait(request, &status);
+
+        MPIX_Request_free(request);
+    }
+
+    free_neighbor_setup(setup);
+}
+
+// k vectors exchanged together, interleaved or column-major (with
+// leading dimensions past the vector lengths)
+TEST(BlockExchangeTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+    MPI_Status status;
+
+    // Reference : one exchange per vector
+    int k = 3;
+    int n_send = setup.send_data.size_msgs;
+    int n_recv = setup.recv_data.size_msgs;
+    std::vector<std::vector<int>> send_cols(k);
+    std::vector<std::vector<int>> std_recv_cols(k);
+    for (int c = 0; c < k; c++)
+    {
+        send_cols[c].resize(n_send);
+        for (int i = 0; i < n_send; i++)
+            send_cols[c][i] = c*1000000 + rank*10000 + i;
+        std_recv_cols[c].resize(n_recv);
+        MPI_Neighbor_alltoallv(send_cols[c].data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                MPI_INT,
+                std_recv_cols[c].data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                MPI_INT,
+                setup.std_comm);
+    }
+
+    // Layout 0 : interleaved, 1 : column-major
+    int send_ld = n_send + 5;
+    int recv_ld = n_recv + 3;
+    for (int layout = 0; layout < 2; layout++)
+    {
+        int send_index_stride = layout ? 1 : k;
+        int send_column_stride = layout ? send_ld : 1;
+        int recv_index_stride = layout ? 1 : k;
+        int recv_column_stride = layout ? recv_ld : 1;
+
+        std::vector<int> send_vals(k*send_ld);
+        std::vector<int> recv_vals(k*recv_ld);
+        for (int c = 0; c < k; c++)
+            for (int i = 0; i < n_send; i++)
+                send_vals[i*send_index_stride + c*send_column_stride] = send_cols[c][i];
+
+        // 0 : standard, 1 : locality-aware, 2 : zero-copy, 3 : hybrid
+        for (int variant = 0; variant < 4; variant++)
+        {
+            MPI_Info info;
+            MPI_Info_create(&info);
+            if (variant == 2)
+                MPI_Info_set(info, "mpix_zero_copy", "true");
+            if (variant == 3)
+                MPI_Info_set(info, "mpix_direct_threshold", "0");
+
+            MPIX_Request* request;
+            if (variant == 0)
+                MPIX_Neighbor_alltoallv_init(send_vals.data(), 
+                        setup.send_data.counts.data(),
+                        setup.send_data.indptr.data(), 
+                        MPI_INT,
+                        recv_vals.data(), 
+                        setup.recv_data.counts.data(),
+                        setup.recv_data.indptr.data(), 
+                        MPI_INT,
+                        setup.neighbor_comm, 
+                        info,
+                        &request);
+            else
+                MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+                        setup.send_data.counts.data(),
+                        setup.send_data.indptr.data(), 
+                        setup.global_send_idx.data(),
+                        MPI_INT,
+                        recv_vals.data(), 
+                        setup.recv_data.counts.data(),
+                        setup.recv_data.indptr.data(), 
+                        setup.global_recv_idx.data(),
+                        MPI_INT,
+                        setup.neighbor_comm, 
+                        info,
+                        &request);
+            MPI_Info_free(&info);
+
+            ASSERT_EQ(MPIX_Request_set_block(request, k, 
+                    send_index_stride, send_column_stride,
+                    recv_index_stride, recv_column_stride), MPI_SUCCESS);
+
+            for (int iter = 0; iter < 2; iter++)
+            {
+                std::fill(recv_vals.begin(), recv_vals.end(), -1);
+                MPIX_Start(request);
+                MPIX_Wait(request, &status);
+                for (int c = 0; c < k; c++)
+                    for (int i = 0; i < n_recv; i++)
+                    {
+                        ASSERT_EQ(std_recv_cols[c][i], 
+                                recv_vals[i*recv_index_stride + c*recv_column_stride]);
+                    }
+
+                // Padding past the vectors is untouched
+                if (layout)
+                    for (int c = 0; c < k; c++)
+                        for (int i = n_recv; i < recv_ld; i++)
+                        {
+                            ASSERT_EQ(-1, recv_vals[i + c*recv_ld]);
+                        }
+            }
+
+            MPIX_Request_free(request);
+        }
+    }
+
+    free_neighbor_setup(setup);
+}
+
+// Values sent back to their owners and combined, compared against a
+// standard alltoallv over the reversed graph
+TEST(ReverseExchangeTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup, true);
+
+    int n_send = setup.send_data.size_msgs;
+    int n_recv = setup.recv_data.size_msgs;
+    std::vector<int> contrib(n_recv);
+    for (int i = 0; i < n_recv; i++)
+        contrib[i] = rank*7 + i % 13 + 1;
+    std::vector<int> std_vals(n_send);
+    MPI_Neighbor_alltoallv(contrib.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            MPI_INT,
+            std_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            MPI_INT,
+            setup.std_comm);
+
+    // Every value for a global index is combined into one position
+    // of sendbuf holding it
+    std::map<long, long> std_sum;
+    std::map<long, int> std_max;
+    for (int i = 0; i < n_send; i++)
+    {
+        std_sum[setup.global_send_idx[i]] += std_vals[i];
+        if (std_vals[i] > std_max[setup.global_send_idx[i]])
+            std_max[setup.global_send_idx[i]] = std_vals[i];
+    }
+
+    std::vector<int> send_vals(n_send);
+    std::vector<int> recv_vals(n_recv);
+    std::vector<int> owner_vals(n_send);
+    for (int zero_copy = 0; zero_copy < 2; zero_copy++)
+    {
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "mpix_zero_copy", zero_copy ? "true" : "false");
+        MPIX_Request* request;
+        MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                setup.global_send_idx.data(),
+                MPI_INT,
+                recv_vals.data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                setup.global_recv_idx.data(),
+                MPI_INT,
+                setup.neighbor_comm, 
+                info,
+                &request);
+        MPI_Info_free(&info);
+
+        for (int iter = 0; iter < 2; iter++)
+        {
+            for (int i = 0; i < n_send; i++)
+                owner_vals[i] = i;
+            ASSERT_EQ(MPIX_Neighbor_reverse(request, contrib.data(), owner_vals.data(),
+                    MPI_INT, MPI_SUM), MPI_SUCCESS);
+            std::map<long, long> loc_sum;
+            for (int i = 0; i < n_send; i++)
+                loc_sum[setup.global_send_idx[i]] += owner_vals[i] - i;
+            for (auto& entry : std_sum)
+                ASSERT_EQ(entry.second, loc_sum[entry.first]);
+        }
+
+        std::fill(owner_vals.begin(), owner_vals.end(), 0);
+        ASSERT_EQ(MPIX_Neighbor_reverse(request, contrib.data(), owner_vals.data(),
+                MPI_INT, MPI_MAX), MPI_SUCCESS);
+        std::map<long, int> loc_max;
+        for (int i = 0; i < n_send; i++)
+            if (owner_vals[i] > loc_max[setup.global_send_idx[i]])
+                loc_max[setup.global_send_idx[i]] = owner_vals[i];
+        for (auto& entry : std_max)
+            ASSERT_EQ(entry.second, loc_max[entry.first]);
+
+        // The forward exchange is unaffected
+        for (int i = 0; i < n_send; i++)
+            send_vals[i] = rank*10000 + i;
+        std::fill(recv_vals.begin(), recv_vals.end(), -1);
+        MPIX_Start(request);
+        MPIX_Wait(request, MPI_STATUS_IGNORE);
+        for (int i = 0; i < n_recv; i++)
+            ASSERT_NE(recv_vals[i], -1);
+
+        MPIX_Request_free(request);
+    }
+
+    // Standard requests have no plan to reverse
+    MPIX_Request* request;
+    MPIX_Neighbor_alltoallv_init(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            MPI_INT,
+            recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            &request);
+    ASSERT_EQ(MPIX_Neighbor_reverse(request, contrib.data(), owner_vals.data(),
+            MPI_INT, MPI_SUM), MPI_ERR_ARG);
+    MPIX_Request_free(request);
+
+    free_neighbor_setup(setup);
+}
+
+// Local L through node-shared memory, against a standard alltoallv
+TEST(SharedLocalTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    NeighborSetup setup;
+    form_neighbor_setup(1000, setup);
+
+    int n_send = setup.send_data.size_msgs;
+    int n_recv = setup.recv_data.size_msgs;
+    std::vector<int> send_vals(n_send);
+    std::vector<int> std_recv_vals(n_recv);
+    std::vector<int> loc_recv_vals(n_recv);
+    std::vector<int> copy_recv_vals(n_recv);
+
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "mpix_shared_local", "true");
+    MPIX_Request* requests[2];
+    MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            loc_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            info,
+            &(requests[0]));
+    MPI_Info_set(info, "mpix_zero_copy", "true");
+    MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            copy_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            info,
+            &(requests[1]));
+    MPI_Info_free(&info);
+
+    // All ranks of this test share a node : local_L sends no messages
+    for (int r = 0; r < 2; r++)
+    {
+        ASSERT_NE(requests[r]->shared, nullptr);
+        ASSERT_EQ(requests[r]->local_L_n_msgs, 0);
+    }
+
+    // Both in flight together, and segments rewritten each iteration
+    for (int iter = 0; iter < 3; iter++)
+    {
+        for (int i = 0; i < n_send; i++)
+            send_vals[i] = rank*10000 + setup.send_data.indices[i] + 100*iter;
+        MPI_Neighbor_alltoallv(send_vals.data(), 
+                setup.send_data.counts.data(),
+                setup.send_data.indptr.data(), 
+                MPI_INT,
+                std_recv_vals.data(), 
+                setup.recv_data.counts.data(),
+                setup.recv_data.indptr.data(), 
+                MPI_INT,
+                setup.std_comm);
+
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        std::fill(copy_recv_vals.begin(), copy_recv_vals.end(), -1);
+        MPIX_Startall(2, requests);
+        MPIX_Waitall(2, requests, MPI_STATUSES_IGNORE);
+        for (int i = 0; i < n_recv; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+            ASSERT_EQ(std_recv_vals[i], copy_recv_vals[i]);
+        }
+    }
+
+    // The ratios describe the plan, shared or not
+    MPIX_Request* plain_request;
+    MPIX_Neighbor_locality_alltoallv_init(send_vals.data(), 
+            setup.send_data.counts.data(),
+            setup.send_data.indptr.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            loc_recv_vals.data(), 
+            setup.recv_data.counts.data(),
+            setup.recv_data.indptr.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            &plain_request);
+    double ratios[4], plain_ratios[4];
+    ASSERT_EQ(MPIX_Request_duplicate_ratios(requests[0], ratios), MPI_SUCCESS);
+    ASSERT_EQ(MPIX_Request_duplicate_ratios(plain_request, plain_ratios), MPI_SUCCESS);
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_GE(ratios[i], 1.0);
+        ASSERT_EQ(ratios[i], plain_ratios[i]);
+    }
+    ASSERT_EQ(requests[0]->shared->n_values*ratios[0],
+            plain_request->locality->local_L_comm->send_data->size_msgs);
+    MPIX_Request_free(plain_request);
+
+    // Segments are sized for single elements, and belong to one request
+    MPIX_Request* clone;
+    ASSERT_EQ(MPIX_Request_clone(requests[0], send_vals.data(), loc_recv_vals.data(),
+            &clone), MPI_ERR_ARG);
+    ASSERT_EQ(MPIX_Request_set_block(requests[0], 2, 2, 1, 2, 1), MPI_ERR_ARG);
+
+    MPIX_Request_free(requests[0]);
+    MPIX_Request_free(requests[1]);
+    free_neighbor_setup(setup);
+}
+
+// Reordering a graph whose heavy edges all cross nodes : rank r
+// exchanges 10 with r+-4 and 1 with r+-1 (4 ranks per node)
+TEST(ReorderTest, TestsInTests)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    int ppn = 4;
+    if (num_procs % ppn || num_procs < 2*ppn)
+        return;
+
+    auto neighbors = [&](int v, std::vector<int>& procs, std::vector<int>& weights)
+    {
+        procs = {(v+ppn) % num_procs, (v+num_procs-ppn) % num_procs,
+                (v+1) % num_procs, (v+num_procs-1) % num_procs};
+        weights = {10, 10, 1, 1};
+    };
+
+    // Heavy edges form rings of stride ppn, which fit on one node
+    // when num_procs is ppn^2
+    int n = num_procs;
+    std::vector<int> adj_ptr(n+1, 0);
+    std::vector<int> adj;
+    std::vector<long> adj_weights;
+    std::vector<int> procs, weights;
+    for (int v = 0; v < n; v++)
+    {
+        neighbors(v, procs, weights);
+        for (int j = 0; j < 4; j++)
+        {
+            adj.push_back(procs[j]);
+            adj_weights.push_back(weights[j]);
+        }
+        adj_ptr[v+1] = adj.size();
+    }
+    std::vector<int> perm(n);
+    map_graph_to_nodes(n, adj_ptr.data(), adj.data(), adj_weights.data(), ppn, perm.data());
+    std::vector<int> node_count(n / ppn, 0);
+    long off_node = 0, identity_off_node = 0;
+    for (int v = 0; v < n; v++)
+    {
+        node_count[perm[v] / ppn]++;
+        for (int j = adj_ptr[v]; j < adj_ptr[v+1]; j++)
+        {
+            if (perm[v] / ppn != perm[adj[j]] / ppn)
+                off_node += adj_weights[j];
+            if (v / ppn != adj[j] / ppn)
+                identity_off_node += adj_weights[j];
+        }
+    }
+    for (int i = 0; i < n / ppn; i++)
+        ASSERT_EQ(node_count[i], ppn);
+    ASSERT_LT(off_node, identity_off_node);
+    if (num_procs == ppn*ppn)
+        ASSERT_EQ(off_node, 2*num_procs);
+
+    // Each rank hosts a vertex, with its neighbor lists renumbered
+    std::vector<int> sources, sourceweights;
+    neighbors(rank, sources, sourceweights);
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "mpix_reorder_ppn", "4");
+    MPIX_Comm* neighbor_comm;
+    MPIX_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            4, sources.data(), sourceweights.data(),
+            4, sources.data(), sourceweights.data(),
+            info, 1, &neighbor_comm);
+    MPI_Info_free(&info);
+    ASSERT_NE(neighbor_comm->reorder_perm, nullptr);
+    for (int v = 0; v < n; v++)
+        ASSERT_EQ(neighbor_comm->reorder_perm[v], perm[v]);
+
+    int vertex = -1;
+    for (int v = 0; v < n; v++)
+        if (perm[v] == rank)
+            vertex = v;
+    neighbors(vertex, procs, weights);
+    ASSERT_EQ(neighbor_comm->indegree, 4);
+    ASSERT_EQ(neighbor_comm->outdegree, 4);
+    for (int j = 0; j < 4; j++)
+    {
+        ASSERT_EQ(neighbor_comm->sources[j], perm[procs[j]]);
+        ASSERT_EQ(neighbor_comm->destinations[j], perm[procs[j]]);
+        ASSERT_EQ(neighbor_comm->sourceweights[j], weights[j]);
+        ASSERT_EQ(neighbor_comm->destweights[j], weights[j]);
+    }
+
+    // Neighbors see the vertex each rank hosts
+    std::vector<int> send_vals(4, vertex);
+    std::vector<int> recv_vals(4, -1);
+    MPI_Neighbor_alltoall(send_vals.data(), 1, MPI_INT, recv_vals.data(), 1, MPI_INT,
+            neighbor_comm->neighbor_comm);
+    for (int j = 0; j < 4; j++)
+        ASSERT_EQ(recv_vals[j], procs[j]);
+
+    MPIX_Comm_free(neighbor_comm);
+}
+
+// Banded pattern : each rank exchanges a contiguous block with the
+// ranks before and after it, so the locality-aware indices form long
+// runs (rank p's values are p*local_size + j)
+struct BandedSetup
+{
+    int local_size;
+    int n_msgs;
+    std::vector<int> procs;
+    std::vector<int> counts;
+    std::vector<int> displs;
+    std::vector<long> global_send_idx;
+    std::vector<long> global_recv_idx;
+    std::vector<int> send_vals;
+    std::vector<int> expected;
+    MPIX_Comm* neighbor_comm;
+};
+
+// Pattern and values only (any neighbor_comm over the band)
+static void form_banded_data(BandedSetup& setup, int local_size)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    int band = 5;
+    setup.local_size = local_size;
+    for (int p = rank - band; p <= rank + band; p++)
+        if (p != rank && p >= 0 && p < num_procs)
+            setup.procs.push_back(p);
+    int n_msgs = setup.procs.size();
+    setup.n_msgs = n_msgs;
+
+    setup.counts.assign(n_msgs, local_size);
+    setup.displs.resize(n_msgs+1);
+    setup.global_send_idx.resize(n_msgs*local_size);
+    setup.global_recv_idx.resize(n_msgs*local_size);
+    setup.send_vals.resize(n_msgs*local_size);
+    setup.expected.resize(n_msgs*local_size);
+    for (int i = 0; i <= n_msgs; i++)
+        setup.displs[i] = i*local_size;
+    for (int i = 0; i < n_msgs; i++)
+    {
+        for (int j = 0; j < local_size; j++)
+        {
+            setup.global_send_idx[i*local_size + j] = (long)rank*local_size + j;
+            setup.global_recv_idx[i*local_size + j] = (long)setup.procs[i]*local_size + j;
+            setup.send_vals[i*local_size + j] = rank*local_size + j;
+            setup.expected[i*local_size + j] = setup.procs[i]*local_size + j;
+        }
+    }
+}
+
+static void form_banded_setup(BandedSetup& setup)
+{
+    form_banded_data(setup, 100);
+    MPIX_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            setup.n_msgs, setup.procs.data(), MPI_UNWEIGHTED,
+            setup.n_msgs, setup.procs.data(), MPI_UNWEIGHTED,
+            MPI_INFO_NULL, 0, &(setup.neighbor_comm));
+    update_locality(setup.neighbor_comm, 4);
+}
+
+static void banded_locality_init(BandedSetup& setup, int* recv_vals,
+        MPIX_Request** request)
+{
+    MPIX_Neighbor_locality_alltoallv_init(setup.send_vals.data(), 
+            setup.counts.data(),
+            setup.displs.data(), 
+            setup.global_send_idx.data(),
+            MPI_INT,
+            recv_vals, 
+            setup.counts.data(),
+            setup.displs.data(), 
+            setup.global_recv_idx.data(),
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            request);
+}
+
+static void banded_standard_init(BandedSetup& setup, int* recv_vals,
+        MPIX_Request** request)
+{
+    MPIX_Neighbor_alltoallv_init(setup.send_vals.data(), 
+            setup.counts.data(),
+            setup.displs.data(), 
+            MPI_INT,
+            recv_vals, 
+            setup.counts.data(),
+            setup.displs.data(), 
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            request);
+}
+
+// Runs of contiguous locality-aware indices
+TEST(ContiguousRunTest, TestsInTests)
+{
+    BandedSetup setup;
+    form_banded_setup(setup);
+    MPIX_Request* neighbor_request;
+    MPI_Status status;
+
+    std::vector<int> loc_recv_vals(setup.n_msgs*setup.local_size);
+    banded_locality_init(setup, loc_recv_vals.data(), &neighbor_request);
+    for (int iter = 0; iter < 2; iter++)
+    {
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        for (int i = 0; i < setup.n_msgs*setup.local_size; i++)
+        {
+            ASSERT_EQ(loc_recv_vals[i], setup.expected[i]);
+        }
+    }
+    MPIX_Request_free(neighbor_request);
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
+
+// Progress through MPIX_Test (overlapping other work)
+TEST(AsyncProgressTest, TestsInTests)
+{
+    BandedSetup setup;
+    form_banded_setup(setup);
+    MPIX_Request* neighbor_request;
+    MPI_Status status;
+
+    std::vector<int> loc_recv_vals(setup.n_msgs*setup.local_size);
+    banded_locality_init(setup, loc_recv_vals.data(), &neighbor_request);
+    for (int iter = 0; iter < 2; iter++)
+    {
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        int flag = 0;
+        MPIX_Start(neighbor_request);
+        while (!flag)
+            MPIX_Test(neighbor_request, &flag, &status);
+        for (int i = 0; i < setup.n_msgs*setup.local_size; i++)
+        {
+            ASSERT_EQ(loc_recv_vals[i], setup.expected[i]);
+        }
+    }
+    MPIX_Request_free(neighbor_request);
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
+
+// Arrays of requests : locality-aware and standard exchanges together
+TEST(RequestArrayTest, TestsInTests)
+{
+    BandedSetup setup;
+    form_banded_setup(setup);
+    MPI_Status status;
+    int n_vals = setup.n_msgs*setup.local_size;
+
+    std::vector<int> loc_recv_vals(n_vals, -1);
+    std::vector<int> std_recv_vals(n_vals, -1);
+    MPIX_Request* requests[2];
+    banded_locality_init(setup, loc_recv_vals.data(), &(requests[0]));
+    banded_standard_init(setup, std_recv_vals.data(), &(requests[1]));
+
+    MPIX_Startall(2, requests);
+    MPIX_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    for (int i = 0; i < n_vals; i++)
+    {
+        ASSERT_EQ(loc_recv_vals[i], setup.expected[i]);
+        ASSERT_EQ(std_recv_vals[i], setup.expected[i]);
+    }
+
+    std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+    std::fill(std_recv_vals.begin(), std_recv_vals.end(), -1);
+    MPIX_Startall(2, requests);
+    int index, n_complete = 0;
+    bool seen[2] = {false, false};
+    MPIX_Waitany(2, requests, &index, &status);
+    while (index != MPI_UNDEFINED)
+    {
+        ASSERT_FALSE(seen[index]);
+        seen[index] = true;
+        n_complete++;
+        MPIX_Waitany(2, requests, &index, &status);
+    }
+    ASSERT_EQ(n_complete, 2);
+    int flag;
+    MPIX_Testall(2, requests, &flag, MPI_STATUSES_IGNORE);
+    ASSERT_EQ(flag, 1);
+    for (int i = 0; i < n_vals; i++)
+    {
+        ASSERT_EQ(loc_recv_vals[i], setup.expected[i]);
+        ASSERT_EQ(std_recv_vals[i], setup.expected[i]);
+    }
+
+    MPIX_Request_free(requests[0]);
+    MPIX_Request_free(requests[1]);
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
+
+// Independent locality-aware requests on one comm (100 and 37 values
+// per neighbor), completed in reverse order
+TEST(IndependentRequestTest, TestsInTests)
+{
+    BandedSetup setup, small;
+    form_banded_setup(setup);
+    form_banded_data(small, 37);
+    small.neighbor_comm = setup.neighbor_comm;
+    MPI_Status status;
+    BandedSetup* setups[2] = {&setup, &small};
+
+    std::vector<int> recv_vals[2];
+    MPIX_Request* requests[2];
+    for (int r = 0; r < 2; r++)
+    {
+        recv_vals[r].resize(setups[r]->n_msgs*setups[r]->local_size);
+        banded_locality_init(*(setups[r]), recv_vals[r].data(), &(requests[r]));
+    }
+
+    for (int test = 0; test < 3; test++)
+    {
+        for (int r = 0; r < 2; r++)
+            std::fill(recv_vals[r].begin(), recv_vals[r].end(), -1);
+        MPIX_Startall(2, requests);
+        if (test == 0)
+        {
+            MPIX_Wait(requests[1], &status);
+            MPIX_Wait(requests[0], &status);
+        }
+        else if (test == 1)
+        {
+            MPIX_Request* reversed[2] = {requests[1], requests[0]};
+            MPIX_Waitall(2, reversed, MPI_STATUSES_IGNORE);
+        }
+        else
+        {
+            MPIX_Request* reversed[2] = {requests[1], requests[0]};
+            int index;
+            MPIX_Waitany(2, reversed, &index, &status);
+            while (index != MPI_UNDEFINED)
+                MPIX_Waitany(2, reversed, &index, &status);
+        }
+
+        for (int r = 0; r < 2; r++)
+        {
+            for (int i = 0; i < (int)recv_vals[r].size(); i++)
+            {
+                ASSERT_EQ(recv_vals[r][i], setups[r]->expected[i]);
+            }
+        }
+    }
+
+    MPIX_Request_free(requests[0]);
+    MPIX_Request_free(requests[1]);
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
+
+// Callbacks fire once per source, after its data is unpacked
+TEST(SourceCallbackTest, TestsInTests)
+{
+    BandedSetup setup;
+    form_banded_setup(setup);
+    MPI_Status status;
+    int n_vals = setup.n_msgs*setup.local_size;
+
+    std::vector<int> recv_vals[2];
+    MPIX_Request* requests[2];
+    recv_vals[0].resize(n_vals);
+    recv_vals[1].resize(n_vals);
+    banded_locality_init(setup, recv_vals[0].data(), &(requests[0]));
+    banded_standard_init(setup, recv_vals[1].data(), &(requests[1]));
+
+    for (int r = 0; r < 2; r++)
+    {
+        CallbackCheck check;
+        init_callback_check(check, setup.n_msgs, recv_vals[r].data(),
+                setup.expected.data(), setup.displs.data());
+        MPIX_Request_set_callback(requests[r], check_source, &check);
+
+        std::fill(recv_vals[r].begin(), recv_vals[r].end(), -1);
+        MPIX_Start(requests[r]);
+        MPIX_Wait(requests[r], &status);
+        for (int i = 0; i < setup.n_msgs; i++)
+            ASSERT_EQ(check.calls[i], 1);
+        ASSERT_EQ(check.errors, 0);
+        MPIX_Request_set_callback(requests[r], NULL, NULL);
+    }
+
+    MPIX_Request_free(requests[0]);
+    MPIX_Request_free(requests[1]);
+
+    // Sources without data are skipped
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    std::vector<int> counts(setup.n_msgs);
+    for (int i = 0; i < setup.n_msgs; i++)
+        counts[i] = (rank + setup.procs[i]) % 3 ? setup.local_size : 0;
+    MPIX_Request* sparse_request;
+    MPIX_Neighbor_alltoallv_init(setup.send_vals.data(), 
+            counts.data(),
+            setup.displs.data(), 
+            MPI_INT,
+            recv_vals[1].data(), 
+            counts.data(),
+            setup.displs.data(), 
+            MPI_INT,
+            setup.neighbor_comm, 
+            MPI_INFO_NULL,
+            &sparse_request);
+
+    CallbackCheck check;
+    init_callback_check(check, setup.n_msgs, recv_vals[1].data(),
+            setup.expected.data(), setup.displs.data());
+    MPIX_Request_set_callback(sparse_request, check_source, &check);
+    MPIX_Start(sparse_request);
+    MPIX_Wait(sparse_request, &status);
+    for (int i = 0; i < setup.n_msgs; i++)
+        ASSERT_EQ(check.calls[i], counts[i] ? 1 : 0);
+    ASSERT_EQ(check.errors, 0);
+    MPIX_Request_free(sparse_request);
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
+
+// Blocking Locality-Aware with gaps between messages : global indices
+// stay packed, so repeated calls reuse one cached request
+TEST(BlockingDisplsTest, TestsInTests)
+{
+    BandedSetup setup;
+    form_banded_setup(setup);
+    int local_size = setup.local_size;
+    int n_msgs = setup.n_msgs;
+    int gap = 3;
+
+    std::vector<int> displs(n_msgs);
+    std::vector<int> send_vals(n_msgs*(local_size+gap), -1);
+    std::vector<int> recv_vals(n_msgs*(local_size+gap));
+    for (int i = 0; i < n_msgs; i++)
+    {
+        displs[i] = i*(local_size+gap);
+        for (int j = 0; j < local_size; j++)
+            send_vals[displs[i] + j] = setup.send_vals[i*local_size + j];
+    }
+
+    for (int iter = 0; iter < 3; iter++)
+    {
+        std::fill(recv_vals.begin(), recv_vals.end(), -1);
+        MPIX_Neighbor_locality_alltoallv(send_vals.data(), 
+                setup.counts.data(),
+                displs.data(), 
+                setup.global_send_idx.data(),
+                MPI_INT,
+                recv_vals.data(), 
+                setup.counts.data(),
+                displs.data(), 
+                setup.global_recv_idx.data(),
+                MPI_INT,
+                setup.neighbor_comm);
+        for (int i = 0; i < n_msgs; i++)
+        {
+            for (int j = 0; j < local_size; j++)
+                ASSERT_EQ(recv_vals[displs[i] + j], setup.expected[i*local_size + j]);
+            for (int j = local_size; j < local_size + gap; j++)
+                ASSERT_EQ(recv_vals[displs[i] + j], -1);
+        }
+        ASSERT_EQ(setup.neighbor_comm->neighbor_cache->n_entries, 1);
+    }
+
+    MPIX_Comm_free(setup.neighbor_comm);
+}
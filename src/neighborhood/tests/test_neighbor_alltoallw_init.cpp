@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <vector>
 #include <set>
+#include <algorithm>
 
 #include "neighbor_data.hpp"
 
@@ -123,6 +124,66 @@ TEST(RandomCommTest, TestsInTests)
     }
 
     MPIX_Request_free(neighbor_request);
+
+    // 4. Locality-Aware Alltoallw
+    std::vector<int> loc_recv_vals(recv_data.size_msgs);
+    MPIX_Neighbor_locality_alltoallw_init(alltoallv_send_vals.data(), 
+            send_data.counts.data(),
+            send_data.indptr.data(), 
+            sendtypes.data(),
+            loc_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            recvtypes.data(),
+            neighbor_comm, 
+            MPI_INFO_NULL,
+            &neighbor_request);
+    for (int iter = 0; iter < 2; iter++)
+    {
+        std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+        MPIX_Start(neighbor_request);
+        MPIX_Wait(neighbor_request, &status);
+        for (int i = 0; i < recv_data.size_msgs; i++)
+        {
+            ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+        }
+    }
+    MPIX_Request_free(neighbor_request);
+
+    // 5. Locality-Aware Alltoallw with strided send datatypes
+    // (every other int of the send buffer)
+    MPI_Datatype strided_type;
+    MPI_Type_create_resized(MPI_INT, 0, 2*sizeof(int), &strided_type);
+    MPI_Type_commit(&strided_type);
+    std::vector<MPI_Datatype> strided_types(num_procs, strided_type);
+    std::vector<int> strided_send_vals(2*send_data.size_msgs, -1);
+    for (int i = 0; i < send_data.size_msgs; i++)
+        strided_send_vals[2*i] = alltoallv_send_vals[i];
+    std::vector<MPI_Aint> strided_displs(send_data.num_msgs+1);
+    for (int i = 0; i <= send_data.num_msgs; i++)
+        strided_displs[i] = 2*send_data.indptr[i];
+
+    std::fill(loc_recv_vals.begin(), loc_recv_vals.end(), -1);
+    MPIX_Neighbor_locality_alltoallw_init(strided_send_vals.data(), 
+            send_data.counts.data(),
+            strided_displs.data(), 
+            strided_types.data(),
+            loc_recv_vals.data(), 
+            recv_data.counts.data(),
+            recv_data.indptr.data(), 
+            recvtypes.data(),
+            neighbor_comm, 
+            MPI_INFO_NULL,
+            &neighbor_request);
+    MPI_Type_free(&strided_type);
+    MPIX_Start(neighbor_request);
+    MPIX_Wait(neighbor_request, &status);
+    for (int i = 0; i < recv_data.size_msgs; i++)
+    {
+        ASSERT_EQ(std_recv_vals[i], loc_recv_vals[i]);
+    }
+    MPIX_Request_free(neighbor_request);
+
     MPIX_Comm_free(neighbor_comm);
     MPI_Comm_free(&std_comm);
 
@@ -0,0 +1,174 @@
+#include "pack.h"
+#include <string.h>
+
+// Gather kernels need -mavx2 (cmake -DENABLE_AVX2=ON)
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Fixed-size memcpy compiles to a single (unaligned) load/store
+#define COPY_ELEMENT(dst, src, bytes) memcpy((dst), (src), (bytes))
+
+static void pack_4(char* buffer, const char* data, const int* indices, int n, int size)
+{
+    int i = 0;
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i idx = _mm256_loadu_si256((const __m256i*)&(indices[i]));
+        __m256i vals = _mm256_i32gather_epi32((const int*)data, idx, 4);
+        _mm256_storeu_si256((__m256i*)&(buffer[(size_t)i*4]), vals);
+    }
+#endif
+    for (; i < n; i++)
+        COPY_ELEMENT(&(buffer[(size_t)i*4]), &(data[(size_t)indices[i]*4]), 4);
+}
+
+static void pack_8(char* buffer, const char* data, const int* indices, int n, int size)
+{
+    int i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i idx = _mm_loadu_si128((const __m128i*)&(indices[i]));
+        __m256i vals = _mm256_i32gather_epi64((const long long*)data, idx, 8);
+        _mm256_storeu_si256((__m256i*)&(buffer[(size_t)i*8]), vals);
+    }
+#endif
+    for (; i < n; i++)
+        COPY_ELEMENT(&(buffer[(size_t)i*8]), &(data[(size_t)indices[i]*8]), 8);
+}
+
+static void pack_16(char* buffer, const char* data, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        COPY_ELEMENT(&(buffer[(size_t)i*16]), &(data[(size_t)indices[i]*16]), 16);
+}
+
+// Element is a multiple of 8 bytes : copy 8-byte words
+static void pack_n8(char* buffer, const char* data, const int* indices, int n, int size)
+{
+    int n_words = size / 8;
+    for (int i = 0; i < n; i++)
+    {
+        char* dst = &(buffer[(size_t)i*size]);
+        const char* src = &(data[(size_t)indices[i]*size]);
+        for (int w = 0; w < n_words; w++)
+            COPY_ELEMENT(&(dst[w*8]), &(src[w*8]), 8);
+    }
+}
+
+void pack_generic(char* buffer, const char* data, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        memcpy(&(buffer[(size_t)i*size]), &(data[(size_t)indices[i]*size]), size);
+}
+
+static void unpack_4(char* data, const char* buffer, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        COPY_ELEMENT(&(data[(size_t)indices[i]*4]), &(buffer[(size_t)i*4]), 4);
+}
+
+static void unpack_8(char* data, const char* buffer, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        COPY_ELEMENT(&(data[(size_t)indices[i]*8]), &(buffer[(size_t)i*8]), 8);
+}
+
+static void unpack_16(char* data, const char* buffer, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        COPY_ELEMENT(&(data[(size_t)indices[i]*16]), &(buffer[(size_t)i*16]), 16);
+}
+
+static void unpack_n8(char* data, const char* buffer, const int* indices, int n, int size)
+{
+    int n_words = size / 8;
+    for (int i = 0; i < n; i++)
+    {
+        char* dst = &(data[(size_t)indices[i]*size]);
+        const char* src = &(buffer[(size_t)i*size]);
+        for (int w = 0; w < n_words; w++)
+            COPY_ELEMENT(&(dst[w*8]), &(src[w*8]), 8);
+    }
+}
+
+void unpack_generic(char* data, const char* buffer, const int* indices, int n, int size)
+{
+    for (int i = 0; i < n; i++)
+        memcpy(&(data[(size_t)indices[i]*size]), &(buffer[(size_t)i*size]), size);
+}
+
+// Copy the k values of each index in one pass (4 and 8 byte elements
+// use fixed-size copies)
+void pack_block(char* buffer, const char* data, const int* indices, int n,
+        int size, int k, int index_stride, int column_stride)
+{
+    size_t index_bytes = (size_t)index_stride*size;
+    size_t column_bytes = (size_t)column_stride*size;
+    for (int i = 0; i < n; i++)
+    {
+        char* dst = &(buffer[(size_t)i*k*size]);
+        const char* src = &(data[(size_t)indices[i]*index_bytes]);
+        if (size == 8)
+            for (int c = 0; c < k; c++)
+                COPY_ELEMENT(&(dst[c*8]), &(src[c*column_bytes]), 8);
+        else if (size == 4)
+            for (int c = 0; c < k; c++)
+                COPY_ELEMENT(&(dst[c*4]), &(src[c*column_bytes]), 4);
+        else
+            for (int c = 0; c < k; c++)
+                memcpy(&(dst[(size_t)c*size]), &(src[c*column_bytes]), size);
+    }
+}
+
+void unpack_block(char* data, const char* buffer, const int* indices, int n,
+        int size, int k, int index_stride, int column_stride)
+{
+    size_t index_bytes = (size_t)index_stride*size;
+    size_t column_bytes = (size_t)column_stride*size;
+    for (int i = 0; i < n; i++)
+    {
+        char* dst = &(data[(size_t)indices[i]*index_bytes]);
+        const char* src = &(buffer[(size_t)i*k*size]);
+        if (size == 8)
+            for (int c = 0; c < k; c++)
+                COPY_ELEMENT(&(dst[c*column_bytes]), &(src[c*8]), 8);
+        else if (size == 4)
+            for (int c = 0; c < k; c++)
+                COPY_ELEMENT(&(dst[c*column_bytes]), &(src[c*4]), 4);
+        else
+            for (int c = 0; c < k; c++)
+                memcpy(&(dst[c*column_bytes]), &(src[(size_t)c*size]), size);
+    }
+}
+
+void select_pack_kernels(int size, pack_func* pack, unpack_func* unpack)
+{
+    if (size == 4)
+    {
+        *pack = pack_4;
+        *unpack = unpack_4;
+    }
+    else if (size == 8)
+    {
+        *pack = pack_8;
+        *unpack = unpack_8;
+    }
+    else if (size == 16)
+    {
+        *pack = pack_16;
+        *unpack = unpack_16;
+    }
+    else if (size && size % 8 == 0)
+    {
+        *pack = pack_n8;
+        *unpack = unpack_n8;
+    }
+    else
+    {
+        *pack = pack_generic;
+        *unpack = unpack_generic;
+    }
+}
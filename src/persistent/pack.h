@@ -0,0 +1,39 @@
+#ifndef MPI_ADVANCE_PACK_H
+#define MPI_ADVANCE_PACK_H
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Pack : buffer[i] = data[indices[i]]
+// Unpack : data[indices[i]] = buffer[i]
+// for n elements of 'size' bytes each
+typedef void (*pack_func)(char* buffer, const char* data,
+        const int* indices, int n, int size);
+typedef void (*unpack_func)(char* data, const char* buffer,
+        const int* indices, int n, int size);
+
+// Select kernels specialized for the element size
+// (4, 8, 16 and multiples of 8 bytes, generic otherwise)
+void select_pack_kernels(int size, pack_func* pack, unpack_func* unpack);
+
+void pack_generic(char* buffer, const char* data, const int* indices, int n, int size);
+void unpack_generic(char* data, const char* buffer, const int* indices, int n, int size);
+
+// Block variants for k vectors of elements of 'size' bytes, where
+// vector c of index j is element j*index_stride + c*column_stride of
+// data, and buffer holds the k values of each index together
+// Pack : buffer[i*k + c] = data[indices[i]*index_stride + c*column_stride]
+void pack_block(char* buffer, const char* data, const int* indices, int n,
+        int size, int k, int index_stride, int column_stride);
+void unpack_block(char* data, const char* buffer, const int* indices, int n,
+        int size, int k, int index_stride, int column_stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
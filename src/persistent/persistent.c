@@ -1,170 +1,785 @@
 #include "persistent.h"
+#include <string.h>
 
-
-// Starting locality-aware requests
-// 1. Start Local_L
-// 2. Start and wait for local_S
-// 3. Start global
-int MPIX_Start(MPIX_Request* request)
+// Whether the block_size values of each index are contiguous, so
+// they can be copied as a single element
+static int block_interleaved(int k, int index_stride, int column_stride)
 {
-    if (request == NULL)
-        return 0;
+    return index_stride == k && (k == 1 || column_stride == 1);
+}
 
-    int ierr, idx;
+// Gather data[indices] into buffer, for buffer positions first to last
+// of comm_data (copies whole runs if indices were compressed)
+// data holds block_size vectors with index_stride and column_stride
+// Without a staging buffer, messages read data directly
+static void pack_comm_data_range(const MPIX_Request* request, CommData* comm_data,
+        char* buffer, const char* data, int index_stride, int column_stride,
+        int first, int last)
+{
+    if (buffer == NULL || first >= last)
+        return;
 
-    char* send_buffer = NULL;
-    int recv_size = 0;
-    if (request->recv_size)
+    int k = request->block_size;
+    int size = request->recv_size;
+    if (!block_interleaved(k, index_stride, column_stride))
     {
-        send_buffer = (char*)(request->sendbuf);
-        recv_size = request->recv_size;
+        pack_block(&(buffer[(size_t)first*k*size]), data, 
+                &(comm_data->indices[first]), last - first, size, k,
+                index_stride, column_stride);
+        return;
     }
+    size *= k;
 
-    // Local L sends sendbuf
-    if (request->local_L_n_msgs)
+    if (comm_data->num_runs)
     {
-        for (int i = 0; i < request->locality->local_L_comm->send_data->size_msgs; i++)
+        // Find run holding 'first'
+        int lo = 0, hi = comm_data->num_runs - 1, mid;
+        while (lo < hi)
+        {
+            mid = (lo + hi + 1) / 2;
+            if (comm_data->run_ptr[mid] <= first) lo = mid;
+            else hi = mid - 1;
+        }
+
+        int start, end;
+        for (int r = lo; r < comm_data->num_runs && comm_data->run_ptr[r] < last; r++)
         {
-            idx = request->locality->local_L_comm->send_data->indices[i];
-            for (int j = 0; j < recv_size; j++)
-                request->locality->local_L_comm->send_data->buffer[i*recv_size+j] = send_buffer[idx*recv_size+j];
+            start = comm_data->run_ptr[r] < first ? first : comm_data->run_ptr[r];
+            end = comm_data->run_ptr[r+1] > last ? last : comm_data->run_ptr[r+1];
+            memcpy(&(buffer[(size_t)start*size]),
+                    &(data[((size_t)comm_data->run_starts[r] + start - comm_data->run_ptr[r])*size]),
+                    (size_t)(end - start)*size);
         }
-        ierr = MPI_Startall(request->local_L_n_msgs, request->local_L_requests);
     }
+    else
+        request->pack(&(buffer[(size_t)first*size]), data, 
+                &(comm_data->indices[first]), last - first, size);
+}
+
+// Pack from sendbuf
+static void pack_comm_data(const MPIX_Request* request, CommData* comm_data,
+        char* buffer)
+{
+    pack_comm_data_range(request, comm_data, buffer, (const char*)(request->sendbuf),
+            request->send_index_stride, request->send_column_stride,
+            0, comm_data->size_msgs);
+}
 
+// Scatter positions first to last of buffer into recvbuf[indices]
+// Without a staging buffer, messages wrote recvbuf directly
+static void unpack_comm_data_range(const MPIX_Request* request, CommData* comm_data,
+        const char* buffer, int first, int last)
+{
+    if (buffer == NULL || first >= last)
+        return;
 
-    // Local S sends sendbuf
-    if (request->local_S_n_msgs)
+    char* data = (char*)(request->recvbuf);
+    int k = request->block_size;
+    int size = request->recv_size;
+    if (!block_interleaved(k, request->recv_index_stride, request->recv_column_stride))
+    {
+        unpack_block(data, &(buffer[(size_t)first*k*size]), 
+                &(comm_data->indices[first]), last - first, size, k,
+                request->recv_index_stride, request->recv_column_stride);
+        return;
+    }
+    size *= k;
+
+    if (comm_data->num_runs)
     {
-        for (int i = 0; i < request->locality->local_S_comm->send_data->size_msgs; i++)
+        // Find run holding 'first'
+        int lo = 0, hi = comm_data->num_runs - 1, mid;
+        while (lo < hi)
         {
-            idx = request->locality->local_S_comm->send_data->indices[i];
+            mid = (lo + hi + 1) / 2;
+            if (comm_data->run_ptr[mid] <= first) lo = mid;
+            else hi = mid - 1;
+        }
 
-            for (int j = 0; j < recv_size; j++)
-                request->locality->local_S_comm->send_data->buffer[i*recv_size+j] = send_buffer[idx*recv_size+j];
+        int start, end;
+        for (int r = lo; r < comm_data->num_runs && comm_data->run_ptr[r] < last; r++)
+        {
+            start = comm_data->run_ptr[r] < first ? first : comm_data->run_ptr[r];
+            end = comm_data->run_ptr[r+1] > last ? last : comm_data->run_ptr[r+1];
+            memcpy(&(data[((size_t)comm_data->run_starts[r] + start - comm_data->run_ptr[r])*size]),
+                    &(buffer[(size_t)start*size]),
+                    (size_t)(end - start)*size);
         }
+    }
+    else
+        request->unpack(data, &(buffer[(size_t)first*size]), 
+                &(comm_data->indices[first]), last - first, size);
+}
 
-        ierr = MPI_Startall(request->local_S_n_msgs, request->local_S_requests);
-        ierr = MPI_Waitall(request->local_S_n_msgs, request->local_S_requests, MPI_STATUSES_IGNORE);
+// Copy per-neighbor datatypes into (or out of) the packed byte streams
+static void pack_send_msg(PackedBuffers* packed, int i)
+{
+    int position = packed->send_offsets[i];
+    MPI_Pack(&(packed->sendbuf[packed->sdispls[i]]), packed->sendcounts[i],
+            packed->sendtypes[i], packed->packed_send, packed->send_offsets[i+1],
+            &position, MPI_COMM_SELF);
+}
 
+static void unpack_recv_source(PackedBuffers* packed, int i)
+{
+    int position = packed->recv_offsets[i];
+    MPI_Unpack(packed->packed_recv, packed->recv_offsets[i+1], &position,
+            &(packed->recvbuf[packed->rdispls[i]]), packed->recvcounts[i],
+            packed->recvtypes[i], MPI_COMM_SELF);
+}
 
-        // Copy into global->send_data->buffer
-        for (int i = 0; i < request->locality->global_comm->send_data->size_msgs; i++)
-        {
-            idx = request->locality->global_comm->send_data->indices[i];
-            for (int j = 0; j < recv_size; j++)
-                request->locality->global_comm->send_data->buffer[i*recv_size+j] = request->locality->local_S_comm->recv_data->buffer[idx*recv_size+j];
-        }
+// Record 'count' values arriving from source 'src', notifying the
+// callback once all of its data is in recvbuf
+static void recv_source_values(MPIX_Request* request, int src, int count)
+{
+    request->source_remaining[src] -= count;
+    if (request->source_remaining[src] == 0)
+    {
+        if (request->packed)
+            unpack_recv_source(request->packed, src);
+        request->callback(src, request->callback_data);
     }
+}
+
+// Unpack recv message 'msg' of a stage as soon as it arrives, and
+// notify the sources it completes
+static void unpack_recv_msg(MPIX_Request* request, CommPkg* comm_pkg, 
+        const char* buffer, int msg,
+        const int* src_ptr, const int* srcs, const int* src_counts)
+{
+    CommData* recv_data = comm_pkg->recv_data;
+    unpack_comm_data_range(request, recv_data, buffer, 
+            recv_data->indptr[msg], recv_data->indptr[msg+1]);
 
-    // Global sends buffer in locality, sendbuf in standard
-    if (request->global_n_msgs)
-        ierr = MPI_Startall(request->global_n_msgs, request->global_requests);
+    if (request->callback == NULL)
+        return;
 
-    return ierr;
+    for (int j = src_ptr[msg]; j < src_ptr[msg+1]; j++)
+        recv_source_values(request, srcs[j], src_counts[j]);
 }
 
+// Mark a request complete, unpacking per-neighbor datatypes if needed
+// (with a callback, each source was already unpacked on arrival)
+static void finish_request(MPIX_Request* request)
+{
+    request->active = 0;
 
-// Wait for locality-aware requests
-// 1. Wait for global
-// 2. Start and wait for local_R
-// 3. Wait for local_L
-// TODO : Currently ignores the status!
-int MPIX_Wait(MPIX_Request* request, MPI_Status* status)
+    if (request->packed && request->callback == NULL)
+        for (int i = 0; i < request->packed->n_recvs; i++)
+            unpack_recv_source(request->packed, i);
+}
+
+// Pack and start send message 'msg' of a stage whose requests are
+// laid out recvs first, then sends (data is a staging buffer)
+static int start_send_msg(MPIX_Request* request, CommPkg* comm_pkg, 
+        char* buffer, MPI_Request* requests, const char* data, int msg)
 {
-    if (request == NULL)
+    CommData* send_data = comm_pkg->send_data;
+    pack_comm_data_range(request, send_data, buffer, data, 
+            request->block_size, 1,
+            send_data->indptr[msg], send_data->indptr[msg+1]);
+    return MPI_Start(&(requests[comm_pkg->recv_data->num_msgs + msg]));
+}
+
+// Local L (shared) : once every rank of the node has written its values,
+// copy this rank's out of their owners' segments, then wait until all
+// ranks have copied theirs before segments may be rewritten
+static void progress_shared(MPIX_Request* request)
+{
+    SharedStaging* shared = request->shared;
+    if (shared->phase == 0)
+        return;
+
+    int flag;
+    MPI_Test(&(shared->barrier), &flag, MPI_STATUS_IGNORE);
+    if (!flag)
+        return;
+    if (shared->phase == 2)
+    {
+        shared->phase = 0;
+        return;
+    }
+
+    LocalityComm* locality = request->locality;
+    CommData* recv_data = locality->local_L_comm->recv_data;
+    char* data = (char*)(request->recvbuf);
+    int size = request->recv_size;
+    const char* segment;
+    MPI_Win_sync(shared->win);
+    for (int m = 0; m < recv_data->num_msgs; m++)
+    {
+        segment = shared->source_segments[m];
+        for (int k = recv_data->indptr[m]; k < recv_data->indptr[m+1]; k++)
+            memcpy(&(data[(size_t)recv_data->indices[k]*size]),
+                    &(segment[(size_t)shared->offsets[k]*size]), size);
+
+        if (request->callback == NULL)
+            continue;
+        for (int j = locality->local_L_src_ptr[m]; j < locality->local_L_src_ptr[m+1]; j++)
+            recv_source_values(request, locality->local_L_srcs[j],
+                    locality->local_L_src_counts[j]);
+    }
+
+    MPI_Ibarrier(shared->comm, &(shared->barrier));
+    shared->phase = 2;
+}
+
+static void init_progress(MPIX_Request* request)
+{
+    LocalityComm* locality = request->locality;
+    int n_global_sends = locality->global_comm->send_data->num_msgs;
+    int n_local_R_sends = locality->local_R_comm->send_data->num_msgs;
+
+    int max_n = request->local_L_n_msgs;
+    if (request->direct_n_msgs > max_n) max_n = request->direct_n_msgs;
+    if (request->local_S_n_msgs > max_n) max_n = request->local_S_n_msgs;
+    if (request->global_n_msgs > max_n) max_n = request->global_n_msgs;
+    if (request->local_R_n_msgs > max_n) max_n = request->local_R_n_msgs;
+
+    request->global_send_remaining = (int*)malloc((n_global_sends+1)*sizeof(int));
+    request->local_R_send_remaining = (int*)malloc((n_local_R_sends+1)*sizeof(int));
+    request->test_indices = (int*)malloc((max_n+1)*sizeof(int));
+}
+
+// Testsome over one stage, returning the number of newly completed
+// requests (their indices are in request->test_indices)
+static int test_stage(MPIX_Request* request, int n_msgs, MPI_Request* requests,
+        int* n_complete)
+{
+    if (*n_complete == n_msgs)
         return 0;
 
-    int ierr, idx;
+    int outcount;
+    MPI_Testsome(n_msgs, requests, &outcount, request->test_indices, MPI_STATUSES_IGNORE);
+    if (outcount == MPI_UNDEFINED)
+        return 0;
+
+    *n_complete += outcount;
+    return outcount;
+}
 
-    char* recv_buffer = NULL;
-    int recv_size = 0;
-    if (request->recv_size)
+// Advance a started locality-aware request without blocking
+// Global sends are started as soon as the local_S recvs they aggregate
+// arrive, and local_R sends as soon as their global recvs arrive
+// Returns 1 once every stage is complete
+static int progress_locality(MPIX_Request* request)
+{
+    LocalityComm* locality = request->locality;
+    int outcount, idx, msg, src;
+
+    // Direct : data lands in recvbuf, only notify sources
+    outcount = test_stage(request, request->direct_n_msgs, request->direct_requests,
+            &(request->direct_complete));
+    for (int i = 0; i < outcount && request->callback; i++)
     {
-        recv_buffer = (char*)(request->recvbuf); 
-        recv_size = request->recv_size;
+        idx = request->test_indices[i];
+        if (idx >= request->direct_n_recvs)
+            continue;
+        src = request->direct_sources[idx];
+        recv_source_values(request, src, locality->source_counts[src]);
     }
 
-    // Global waits for recvs
-    if (request->global_n_msgs)
+    // Local L : unpack each recv as it arrives
+    outcount = test_stage(request, request->local_L_n_msgs, request->local_L_requests,
+            &(request->local_L_complete));
+    for (int i = 0; i < outcount; i++)
     {
-        ierr = MPI_Waitall(request->global_n_msgs, request->global_requests, MPI_STATUSES_IGNORE);
+        idx = request->test_indices[i];
+        if (idx < locality->local_L_comm->recv_data->num_msgs)
+            unpack_recv_msg(request, locality->local_L_comm, request->local_L_buffers.recv,
+                    idx, locality->local_L_src_ptr,
+                    locality->local_L_srcs, locality->local_L_src_counts);
+    }
+    if (request->shared)
+        progress_shared(request);
 
-        if (request->local_R_n_msgs)
+    // Local S : forward to global sends
+    outcount = test_stage(request, request->local_S_n_msgs, request->local_S_requests,
+            &(request->local_S_complete));
+    for (int i = 0; i < outcount; i++)
+    {
+        idx = request->test_indices[i];
+        if (idx >= locality->local_S_comm->recv_data->num_msgs)
+            continue;
+        for (int j = locality->local_S_fwd_ptr[idx]; j < locality->local_S_fwd_ptr[idx+1]; j++)
         {
-            for (int i = 0; i < request->locality->local_R_comm->send_data->size_msgs; i++)
-            {
-                idx = request->locality->local_R_comm->send_data->indices[i];
-                for (int j = 0; j < recv_size; j++)
-                    request->locality->local_R_comm->send_data->buffer[i*recv_size+j] = request->locality->global_comm->recv_data->buffer[idx*recv_size+j];
-            }
+            msg = locality->local_S_fwd[j];
+            if (--request->global_send_remaining[msg] == 0)
+                start_send_msg(request, locality->global_comm, 
+                        request->global_buffers.send, request->global_requests,
+                        request->local_S_buffers.recv, msg);
         }
     }
 
-    // Wait for local_R recvs
-    if (request->local_R_n_msgs)
+    // Global : forward to local_R sends
+    outcount = test_stage(request, request->global_n_msgs, request->global_requests,
+            &(request->global_complete));
+    for (int i = 0; i < outcount; i++)
     {
-        ierr = MPI_Startall(request->local_R_n_msgs, request->local_R_requests);
-        ierr = MPI_Waitall(request->local_R_n_msgs, request->local_R_requests, MPI_STATUSES_IGNORE);
-
-        for (int i = 0; i < request->locality->local_R_comm->recv_data->size_msgs; i++)
+        idx = request->test_indices[i];
+        if (idx >= locality->global_comm->recv_data->num_msgs)
+            continue;
+        for (int j = locality->global_fwd_ptr[idx]; j < locality->global_fwd_ptr[idx+1]; j++)
         {
-            idx = request->locality->local_R_comm->recv_data->indices[i];
-            for (int j = 0; j < recv_size; j++)
-                recv_buffer[idx*recv_size+j] = request->locality->local_R_comm->recv_data->buffer[i*recv_size+j];
+            msg = locality->global_fwd[j];
+            if (--request->local_R_send_remaining[msg] == 0)
+                start_send_msg(request, locality->local_R_comm, 
+                        request->local_R_buffers.send, request->local_R_requests,
+                        request->global_buffers.recv, msg);
         }
     }
 
-    // Wait for local_L recvs
+    // Local R : unpack each recv as it arrives
+    outcount = test_stage(request, request->local_R_n_msgs, request->local_R_requests,
+            &(request->local_R_complete));
+    for (int i = 0; i < outcount; i++)
+    {
+        idx = request->test_indices[i];
+        if (idx < locality->local_R_comm->recv_data->num_msgs)
+            unpack_recv_msg(request, locality->local_R_comm, request->local_R_buffers.recv,
+                    idx, locality->local_R_src_ptr,
+                    locality->local_R_srcs, locality->local_R_src_counts);
+    }
+
+    return request->direct_complete == request->direct_n_msgs
+        && request->local_L_complete == request->local_L_n_msgs
+        && request->local_S_complete == request->local_S_n_msgs
+        && request->global_complete == request->global_n_msgs
+        && request->local_R_complete == request->local_R_n_msgs
+        && (request->shared == NULL || request->shared->phase == 0);
+}
+
+
+// Starting locality-aware requests posts everything that can be posted:
+// 1. Pack and start local_L and local_S
+// 2. Start global and local_R recvs
+// 3. Start any global or local_R sends without dependencies
+// Remaining sends are forwarded by MPIX_Test/MPIX_Wait
+int MPIX_Start(MPIX_Request* request)
+{
+    if (request == NULL)
+        return 0;
+
+    int ierr = 0;
+
+    request->active = 1;
+    request->local_L_complete = 0;
+    request->local_S_complete = 0;
+    request->global_complete = 0;
+    request->local_R_complete = 0;
+    request->direct_complete = 0;
+
+    // Standard : single stage
+    if (request->locality == NULL)
+    {
+        if (request->global_n_msgs)
+            ierr = MPI_Startall(request->global_n_msgs, request->global_requests);
+        return ierr;
+    }
+
+    LocalityComm* locality = request->locality;
+
+    if (request->packed)
+        for (int i = 0; i < request->packed->n_sends; i++)
+            pack_send_msg(request->packed, i);
+
+    if (request->test_indices == NULL)
+        init_progress(request);
+
+    if (request->callback)
+        for (int i = 0; i < locality->n_sources; i++)
+            request->source_remaining[i] = locality->source_counts[i];
+
+    // Direct messages bypass the locality-aware steps
+    if (request->direct_n_msgs)
+        ierr += MPI_Startall(request->direct_n_msgs, request->direct_requests);
+
+    // Local L sends sendbuf
     if (request->local_L_n_msgs)
     {
-        ierr = MPI_Waitall(request->local_L_n_msgs, request->local_L_requests, MPI_STATUSES_IGNORE);
+        pack_comm_data(request, locality->local_L_comm->send_data,
+                request->local_L_buffers.send);
+        ierr += MPI_Startall(request->local_L_n_msgs, request->local_L_requests);
+    }
 
-        for (int i = 0; i < request->locality->local_L_comm->recv_data->size_msgs; i++)
-        {
-            idx = request->locality->local_L_comm->recv_data->indices[i];
-            for (int j = 0; j < recv_size; j++)
-                recv_buffer[idx*recv_size+j] = request->locality->local_L_comm->recv_data->buffer[i*recv_size+j];
-        }
+    // Local L (shared) : write each value once, for every on-node reader
+    if (request->shared)
+    {
+        SharedStaging* shared = request->shared;
+        MPI_Win_sync(shared->win);
+        request->pack(shared->segment, (const char*)(request->sendbuf),
+                shared->indices, shared->n_values, request->recv_size);
+        MPI_Win_sync(shared->win);
+        ierr += MPI_Ibarrier(shared->comm, &(shared->barrier));
+        shared->phase = 1;
+    }
+
+    // Local S sends sendbuf
+    if (request->local_S_n_msgs)
+    {
+        pack_comm_data(request, locality->local_S_comm->send_data,
+                request->local_S_buffers.send);
+        ierr += MPI_Startall(request->local_S_n_msgs, request->local_S_requests);
+    }
+
+    // Global sends wait for local_S recvs
+    int n_recvs = locality->global_comm->recv_data->num_msgs;
+    if (n_recvs)
+        ierr += MPI_Startall(n_recvs, request->global_requests);
+    for (int i = 0; i < locality->global_comm->send_data->num_msgs; i++)
+    {
+        request->global_send_remaining[i] = locality->global_send_deps[i];
+        if (request->global_send_remaining[i] == 0)
+            ierr += start_send_msg(request, locality->global_comm, 
+                    request->global_buffers.send, request->global_requests,
+                    request->local_S_buffers.recv, i);
+    }
+
+    // Local R sends wait for global recvs
+    n_recvs = locality->local_R_comm->recv_data->num_msgs;
+    if (n_recvs)
+        ierr += MPI_Startall(n_recvs, request->local_R_requests);
+    for (int i = 0; i < locality->local_R_comm->send_data->num_msgs; i++)
+    {
+        request->local_R_send_remaining[i] = locality->local_R_send_deps[i];
+        if (request->local_R_send_remaining[i] == 0)
+            ierr += start_send_msg(request, locality->local_R_comm, 
+                    request->local_R_buffers.send, request->local_R_requests,
+                    request->global_buffers.recv, i);
     }
 
     return ierr;
 }
 
 
-int MPIX_Request_free(MPIX_Request* request)
+// Test a started request once, advancing locality-aware stages
+static int test_request(MPIX_Request* request)
 {
-    if (request->local_L_n_msgs)
+    int flag = 1;
+
+    if (request->locality == NULL && request->callback)
     {
-        for (int i = 0; i < request->local_L_n_msgs; i++)
-            MPI_Request_free(&(request->local_L_requests[i]));
-        free(request->local_L_requests);
+        // Standard : recv i is all data from source i (skipped if empty)
+        int outcount = test_stage(request, request->global_n_msgs, 
+                request->global_requests, &(request->global_complete));
+        int idx;
+        for (int i = 0; i < outcount; i++)
+        {
+            idx = request->test_indices[i];
+            if (idx < request->n_sources && request->global_msgs[idx].count)
+                request->callback(idx, request->callback_data);
+        }
+        flag = request->global_complete == request->global_n_msgs;
     }
-    if (request->local_S_n_msgs)
+    else if (request->locality == NULL)
     {
-        for (int i = 0; i < request->local_S_n_msgs; i++)
-            MPI_Request_free(&(request->local_S_requests[i]));
-        free(request->local_S_requests);
+        if (request->global_n_msgs)
+            MPI_Testall(request->global_n_msgs, request->global_requests,
+                    &flag, MPI_STATUSES_IGNORE);
     }
-    if (request->local_R_n_msgs)
+    else
+        flag = progress_locality(request);
+
+    return flag;
+}
+
+
+// Test for completion of a started request, advancing the
+// locality-aware stages that are ready
+// Inactive (not started or already completed) requests test as complete
+// TODO : Currently ignores the status!
+int MPIX_Test(MPIX_Request* request, int* flag, MPI_Status* status)
+{
+    *flag = 1;
+    if (request == NULL || !request->active)
+        return 0;
+
+    *flag = test_request(request);
+    if (*flag)
+        finish_request(request);
+
+    return 0;
+}
+
+
+// Wait for requests, advancing locality-aware stages as they complete
+// TODO : Currently ignores the status!
+int MPIX_Wait(MPIX_Request* request, MPI_Status* status)
+{
+    if (request == NULL || !request->active)
+        return 0;
+
+    int ierr = 0;
+    if (request->locality == NULL && request->callback == NULL)
     {
-        for (int i = 0; i < request->local_R_n_msgs; i++)
-            MPI_Request_free(&(request->local_R_requests[i]));
-        free(request->local_R_requests);
+        if (request->global_n_msgs)
+            ierr = MPI_Waitall(request->global_n_msgs, request->global_requests,
+                    MPI_STATUSES_IGNORE);
     }
-    if (request->global_n_msgs)
+    else
+        while (!test_request(request));
+
+    finish_request(request);
+
+    return ierr;
+}
+
+
+int MPIX_Startall(int count, MPIX_Request* requests[])
+{
+    int ierr = 0;
+    for (int i = 0; i < count; i++)
+        ierr += MPIX_Start(requests[i]);
+    return ierr;
+}
+
+
+// Progress every request in turn until all complete, so requests
+// finish in the order their messages arrive
+int MPIX_Waitall(int count, MPIX_Request* requests[], MPI_Status statuses[])
+{
+    int flag, n_active;
+    do
     {
-        for (int i = 0; i < request->global_n_msgs; i++)
-            MPI_Request_free(&(request->global_requests[i]));
-        free(request->global_requests);
+        n_active = 0;
+        for (int i = 0; i < count; i++)
+        {
+            MPIX_Test(requests[i], &flag, MPI_STATUS_IGNORE);
+            if (!flag) n_active++;
+        }
+    } while (n_active);
+
+    return 0;
+}
+
+
+// Progress every request once, flag is set if all are complete
+int MPIX_Testall(int count, MPIX_Request* requests[], int* flag, MPI_Status statuses[])
+{
+    int req_flag;
+    *flag = 1;
+    for (int i = 0; i < count; i++)
+    {
+        MPIX_Test(requests[i], &req_flag, MPI_STATUS_IGNORE);
+        if (!req_flag) *flag = 0;
     }
 
+    return 0;
+}
+
+
+// Wait until any active request completes, returning its position
+// (MPI_UNDEFINED if no request is active)
+int MPIX_Waitany(int count, MPIX_Request* requests[], int* index, MPI_Status* status)
+{
+    int n_active;
+    *index = MPI_UNDEFINED;
+    do
+    {
+        n_active = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (requests[i] == NULL || !requests[i]->active)
+                continue;
+            n_active++;
+            if (test_request(requests[i]))
+            {
+                finish_request(requests[i]);
+                *index = i;
+                return 0;
+            }
+        }
+    } while (n_active);
+
+    return 0;
+}
+
+
+void free_persistent_requests(int* n_requests, MPI_Request** requests)
+{
+    if (*n_requests)
+    {
+        for (int i = 0; i < *n_requests; i++)
+            MPI_Request_free(&((*requests)[i]));
+        free(*requests);
+    }
+    *n_requests = 0;
+    *requests = NULL;
+}
+
+void free_step_buffers(StepBuffers* buffers)
+{
+    free(buffers->send);
+    free(buffers->recv);
+    buffers->send = NULL;
+    buffers->recv = NULL;
+}
+
+int MPIX_Request_free(MPIX_Request* request)
+{
+    free_persistent_requests(&(request->local_L_n_msgs), &(request->local_L_requests));
+    free_persistent_requests(&(request->local_S_n_msgs), &(request->local_S_requests));
+    free_persistent_requests(&(request->local_R_n_msgs), &(request->local_R_requests));
+    free_persistent_requests(&(request->global_n_msgs), &(request->global_requests));
+    free_persistent_requests(&(request->direct_n_msgs), &(request->direct_requests));
+    free(request->direct_sources);
+    free(request->local_L_msgs);
+    free(request->local_S_msgs);
+    free(request->local_R_msgs);
+    free(request->global_msgs);
+    free(request->direct_msgs);
+
     // If Locality-Aware
     if (request->locality)
         destroy_locality_comm(request->locality);
+    free_step_buffers(&(request->local_L_buffers));
+    free_step_buffers(&(request->local_S_buffers));
+    free_step_buffers(&(request->local_R_buffers));
+    free_step_buffers(&(request->global_buffers));
+
+    for (int i = 0; i < request->n_datatypes; i++)
+        MPI_Type_free(&(request->datatypes[i]));
+    free(request->datatypes);
+
+    free(request->global_send_remaining);
+    free(request->local_R_send_remaining);
+    free(request->test_indices);
+    free(request->source_remaining);
+
+    if (request->packed)
+        destroy_packed_buffers(request->packed);
+    if (request->reverse)
+        destroy_reverse_comm(request->reverse);
+    if (request->shared)
+        destroy_shared_staging(request->shared);
 
     free(request);
 
     return 0;
 }
 
+
+// Sizes of packed messages are count * type size, which match between
+// sender and receiver (datatype signatures must match)
+void init_packed_buffers(PackedBuffers** packed_ptr,
+        int n_sends, const void* sendbuf, const int sendcounts[],
+        const MPI_Aint sdispls[], const MPI_Datatype sendtypes[],
+        int n_recvs, void* recvbuf, const int recvcounts[],
+        const MPI_Aint rdispls[], const MPI_Datatype recvtypes[])
+{
+    PackedBuffers* packed = (PackedBuffers*)malloc(sizeof(PackedBuffers));
+    int type_size;
+
+    packed->n_sends = n_sends;
+    packed->sendbuf = (const char*)sendbuf;
+    packed->sendcounts = (int*)malloc((n_sends+1)*sizeof(int));
+    packed->sdispls = (MPI_Aint*)malloc((n_sends+1)*sizeof(MPI_Aint));
+    packed->sendtypes = (MPI_Datatype*)malloc((n_sends+1)*sizeof(MPI_Datatype));
+    packed->send_offsets = (int*)malloc((n_sends+1)*sizeof(int));
+    packed->send_offsets[0] = 0;
+    for (int i = 0; i < n_sends; i++)
+    {
+        packed->sendcounts[i] = sendcounts[i];
+        packed->sdispls[i] = sdispls[i];
+        MPI_Type_dup(sendtypes[i], &(packed->sendtypes[i]));
+        MPI_Type_size(sendtypes[i], &type_size);
+        packed->send_offsets[i+1] = packed->send_offsets[i] + sendcounts[i]*type_size;
+    }
+    packed->packed_send = (char*)malloc(packed->send_offsets[n_sends]+1);
+
+    packed->n_recvs = n_recvs;
+    packed->recvbuf = (char*)recvbuf;
+    packed->recvcounts = (int*)malloc((n_recvs+1)*sizeof(int));
+    packed->rdispls = (MPI_Aint*)malloc((n_recvs+1)*sizeof(MPI_Aint));
+    packed->recvtypes = (MPI_Datatype*)malloc((n_recvs+1)*sizeof(MPI_Datatype));
+    packed->recv_offsets = (int*)malloc((n_recvs+1)*sizeof(int));
+    packed->recv_offsets[0] = 0;
+    for (int i = 0; i < n_recvs; i++)
+    {
+        packed->recvcounts[i] = recvcounts[i];
+        packed->rdispls[i] = rdispls[i];
+        MPI_Type_dup(recvtypes[i], &(packed->recvtypes[i]));
+        MPI_Type_size(recvtypes[i], &type_size);
+        packed->recv_offsets[i+1] = packed->recv_offsets[i] + recvcounts[i]*type_size;
+    }
+    packed->packed_recv = (char*)malloc(packed->recv_offsets[n_recvs]+1);
+
+    *packed_ptr = packed;
+}
+
+void destroy_packed_buffers(PackedBuffers* packed)
+{
+    for (int i = 0; i < packed->n_sends; i++)
+        MPI_Type_free(&(packed->sendtypes[i]));
+    for (int i = 0; i < packed->n_recvs; i++)
+        MPI_Type_free(&(packed->recvtypes[i]));
+
+    free(packed->sendcounts);
+    free(packed->sdispls);
+    free(packed->sendtypes);
+    free(packed->send_offsets);
+    free(packed->packed_send);
+    free(packed->recvcounts);
+    free(packed->rdispls);
+    free(packed->recvtypes);
+    free(packed->recv_offsets);
+    free(packed->packed_recv);
+
+    free(packed);
+}
+
+
+int MPIX_Request_set_callback(MPIX_Request* request, 
+        MPIX_Neighbor_callback callback, void* data)
+{
+    request->callback = callback;
+    request->callback_data = data;
+
+    if (request->source_remaining == NULL && request->n_sources)
+        request->source_remaining = (int*)malloc(request->n_sources*sizeof(int));
+    if (request->locality == NULL && request->test_indices == NULL)
+        request->test_indices = (int*)malloc((request->global_n_msgs+1)*sizeof(int));
+
+    return 0;
+}
+
+void destroy_reduce_rounds(ReduceRounds* rounds)
+{
+    free(rounds->round_ptr);
+    free(rounds->entries);
+    free(rounds->slots);
+}
+
+void destroy_reverse_comm(ReverseComm* reverse)
+{
+    destroy_reduce_rounds(&(reverse->local_L_rounds));
+    destroy_reduce_rounds(&(reverse->local_S_rounds));
+    destroy_reduce_rounds(&(reverse->global_rounds));
+    destroy_reduce_rounds(&(reverse->local_R_rounds));
+
+    free(reverse->local_L_send);
+    free(reverse->local_L_recv);
+    free(reverse->local_R_send);
+    free(reverse->local_R_recv);
+    free(reverse->global_values);
+    free(reverse->global_recv);
+    free(reverse->local_S_values);
+    free(reverse->local_S_recv);
+    free(reverse->reduce_in);
+    free(reverse->reduce_out);
+
+    free(reverse);
+}
+
+void destroy_shared_staging(SharedStaging* shared)
+{
+    MPI_Win_unlock_all(shared->win);
+    MPI_Win_free(&(shared->win));
+    MPI_Comm_free(&(shared->comm));
+
+    free(shared->indices);
+    free(shared->source_segments);
+    free(shared->offsets);
+
+    free(shared);
+}
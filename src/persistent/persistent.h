@@ -2,12 +2,128 @@
 #define MPI_ADVANCE_PERSISTENT_H
 
 #include "locality/locality_comm.h"
+#include "pack.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// Called once all data from a source (position in the neighbor
+// sources list) has been written to recvbuf
+typedef void (*MPIX_Neighbor_callback)(int source, void* data);
+
+// User buffers described by per-neighbor datatypes (alltoallw), packed
+// into contiguous byte streams that the request itself exchanges
+typedef struct _PackedBuffers
+{
+    int n_sends;
+    const char* sendbuf;
+    int* sendcounts;
+    MPI_Aint* sdispls; // bytes
+    MPI_Datatype* sendtypes;
+    int* send_offsets; // position of each message in packed_send
+    char* packed_send;
+
+    int n_recvs;
+    char* recvbuf;
+    int* recvcounts;
+    MPI_Aint* rdispls; // bytes
+    MPI_Datatype* recvtypes;
+    int* recv_offsets; // position of each message in packed_recv
+    char* packed_recv;
+} PackedBuffers;
+
+void init_packed_buffers(PackedBuffers** packed_ptr,
+        int n_sends, const void* sendbuf, const int sendcounts[],
+        const MPI_Aint sdispls[], const MPI_Datatype sendtypes[],
+        int n_recvs, void* recvbuf, const int recvcounts[],
+        const MPI_Aint rdispls[], const MPI_Datatype recvtypes[]);
+void destroy_packed_buffers(PackedBuffers* packed);
+
+// Values combined into the same position, in rounds (positions are
+// distinct within a round, so each round is one MPI_Reduce_local)
+typedef struct _ReduceRounds
+{
+    int n_rounds;
+    int* round_ptr;
+    int* entries; // position of each value in the received buffer
+    int* slots; // position it is combined into
+} ReduceRounds;
+
+void destroy_reduce_rounds(ReduceRounds* rounds);
+
+// Buffers of the reverse exchange (MPIX_Neighbor_reverse) of a
+// locality-aware request, named for the forward step each reverses
+typedef struct _ReverseComm
+{
+    ReduceRounds local_L_rounds; // into sendbuf
+    ReduceRounds local_S_rounds; // into sendbuf
+    ReduceRounds global_rounds; // into local_S_values
+    ReduceRounds local_R_rounds; // into global_values
+
+    char* local_L_send; // packed from recvbuf
+    char* local_L_recv;
+    char* local_R_send; // packed from recvbuf
+    char* local_R_recv;
+    char* global_values; // combined per global recv position
+    char* global_recv;
+    char* local_S_values; // combined per local_S recv position
+    char* local_S_recv;
+
+    char* reduce_in;
+    char* reduce_out;
+} ReverseComm;
+
+void destroy_reverse_comm(ReverseComm* reverse);
+
+// Local L through a segment shared by the ranks of a node : each rank
+// writes its distinct local_L values once, however many on-node ranks
+// need them, and each rank copies its values out of their owners'
+// segments (between two barriers of comm)
+typedef struct _SharedStaging
+{
+    MPI_Comm comm; // duplicate of the local communicator
+    MPI_Win win;
+    char* segment; // this rank's values
+    int n_values;
+    int* indices; // sendbuf position of each value
+    char** source_segments; // segment of the source of each local_L recv
+    int* offsets; // position of each local_L recv value in that segment
+    MPI_Request barrier;
+    int phase; // 1 : values being written, 2 : being read, 0 : idle
+} SharedStaging;
+
+void destroy_shared_staging(SharedStaging* shared);
+
+// Staging buffers of one locality-aware step
+// (NULL where messages use the user buffers directly)
+typedef struct _StepBuffers
+{
+    char* send;
+    char* recv;
+} StepBuffers;
+
+// Arguments of a persistent send or recv : count elements of type, at
+// byte offset of the user buffer (sendbuf for sends, recvbuf for recvs)
+// if user is set, of a staging buffer otherwise
+// Kept so requests can be rebuilt over new buffers (MPIX_Request_rebind)
+typedef struct _BufferMsg
+{
+    int send;
+    int user;
+    MPI_Aint offset;
+    int count;
+    MPI_Datatype type;
+    int peer;
+    int tag;
+    MPI_Comm comm;
+
+    // Type and offset bound (type and offset, unless in block mode)
+    MPI_Datatype block_type;
+    MPI_Aint block_offset;
+} BufferMsg;
+
 typedef struct _MPIX_Request
 {
     int local_L_n_msgs;
@@ -20,28 +136,116 @@ typedef struct _MPIX_Request
     MPI_Request* local_R_requests;
     MPI_Request* global_requests;
 
+    // Arguments of each of the requests above
+    BufferMsg* local_L_msgs;
+    BufferMsg* local_S_msgs;
+    BufferMsg* local_R_msgs;
+    BufferMsg* global_msgs;
+
+    // Locality-aware plan (shared with clones, see MPIX_Request_clone),
+    // and the staging buffers this request owns
     LocalityComm* locality;
+    StepBuffers local_L_buffers;
+    StepBuffers local_S_buffers;
+    StepBuffers local_R_buffers;
+    StepBuffers global_buffers;
+    int zero_copy;
+    int tag_offset; // added to the plan's tags (distinct for each request on a comm)
+
+    // Datatypes created for this request (freed with it)
+    int n_datatypes;
+    MPI_Datatype* datatypes;
 
     const void* sendbuf; // pointer to sendbuf (where original data begins)
     void* recvbuf; // pointer to recvbuf (where final data goes)
     int recv_size;
+
+    // Block mode : block_size vectors per index (MPIX_Request_set_block)
+    // Vector c of index i is element i*index_stride + c*column_stride
+    // Staging buffers and messages hold the block_size values of each
+    // index together
+    int block_size;
+    int send_index_stride;
+    int send_column_stride;
+    int recv_index_stride;
+    int recv_column_stride;
+
+    // Pack/unpack kernels for block_size*recv_size (selected at init)
+    pack_func pack;
+    unpack_func unpack;
+
+    // Started and not yet completed by MPIX_Test/MPIX_Wait
+    int active;
+
+    // Progress of a started locality-aware request
+    int local_L_complete;
+    int local_S_complete;
+    int global_complete;
+    int local_R_complete;
+    int* global_send_remaining; // local_S recvs each global send awaits
+    int* local_R_send_remaining; // global recvs each local_R send awaits
+    int* test_indices;
+
+    // Optional per-source completion callback
+    int n_sources;
+    int* source_remaining; // values still to arrive from each source
+    MPIX_Neighbor_callback callback;
+    void* callback_data;
+
+    // Alltoallw : sendbuf/recvbuf are packed copies of these (or NULL)
+    PackedBuffers* packed;
+
+    // Local L through node-shared memory (or NULL)
+    SharedStaging* shared;
+
+    // Reverse exchange, built on first use (or NULL)
+    ReverseComm* reverse;
+
+    // Hybrid : off-node messages above the size threshold bypass the
+    // locality-aware steps (direct recvs first, then sends)
+    int direct_n_msgs;
+    int direct_n_recvs;
+    MPI_Request* direct_requests;
+    BufferMsg* direct_msgs;
+    int* direct_sources; // source of each direct recv
+    int direct_complete;
 } MPIX_Request;
 
-// Starting locality-aware requests
-// 1. Start Local_L
-// 2. Start and wait for local_S
-// 3. Start global
+// Starting locality-aware requests (returns without waiting)
+// 1. Start Local_L and local_S
+// 2. Start global and local_R recvs
+// 3. Start global/local_R sends that depend on no recvs
 int MPIX_Start(MPIX_Request* request);
 
 
-// Wait for locality-aware requests
-// 1. Wait for global
-// 2. Start and wait for local_R
-// 3. Wait for local_L
+// Test for locality-aware requests, forwarding data between stages:
+// global sends start once the local_S recvs they aggregate arrive,
+// local_R sends once their global recvs arrive
+int MPIX_Test(MPIX_Request* request, int* flag, MPI_Status* status);
+
+
+// Wait for locality-aware requests (progresses as MPIX_Test)
 int MPIX_Wait(MPIX_Request* request, MPI_Status* status);
 
 
+// Operations on arrays of requests
+// Progress is interleaved across requests, so each completes as soon
+// as its own messages arrive (statuses are currently ignored)
+int MPIX_Startall(int count, MPIX_Request* requests[]);
+int MPIX_Waitall(int count, MPIX_Request* requests[], MPI_Status statuses[]);
+int MPIX_Testall(int count, MPIX_Request* requests[], int* flag, MPI_Status statuses[]);
+int MPIX_Waitany(int count, MPIX_Request* requests[], int* index, MPI_Status* status);
+
+
 int MPIX_Request_free(MPIX_Request* request);
+void free_persistent_requests(int* n_requests, MPI_Request** requests);
+void free_step_buffers(StepBuffers* buffers);
+
+
+// Invoke callback(source, data) during MPIX_Test/MPIX_Wait as soon as
+// each neighbor's data is in recvbuf (sources without data are skipped)
+int MPIX_Request_set_callback(MPIX_Request* request, 
+        MPIX_Neighbor_callback callback, void* data);
 
 
 #ifdef __cplusplus
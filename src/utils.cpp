@@ -1,5 +1,8 @@
 #include "utils.h"
 #include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cstdlib>
 
 void sort(int n_objects, int* object_indices, int* object_values)
 {
@@ -26,3 +29,76 @@ void reverse(void* recvbuf, int n_bytes, int var_bytes)
         for (int j = 0; j < var_bytes; j++)
             std::swap(recv_buffer[i*var_bytes+j], recv_buffer[(n_vars-i-1)*var_bytes+j]);
 }
+
+int large_count_type(MPI_Count count, MPI_Datatype type,
+        int* newcount, MPI_Datatype* newtype)
+{
+    if (count <= INT_MAX)
+    {
+        *newcount = (int)count;
+        *newtype = type;
+        return 0;
+    }
+
+    MPI_Count n_chunks = count / INT_MAX;
+    MPI_Count remainder = count % INT_MAX;
+
+    MPI_Datatype chunk, chunks;
+    MPI_Type_contiguous(INT_MAX, type, &chunk);
+    MPI_Type_contiguous((int)n_chunks, chunk, &chunks);
+
+    if (remainder)
+    {
+        MPI_Aint lb, extent;
+        MPI_Type_get_extent(type, &lb, &extent);
+
+        MPI_Datatype rem_type;
+        MPI_Type_contiguous((int)remainder, type, &rem_type);
+
+        int blocklens[2] = {1, 1};
+        MPI_Aint displs[2] = {0, (MPI_Aint)(n_chunks * INT_MAX) * extent};
+        MPI_Datatype types[2] = {chunks, rem_type};
+        MPI_Type_create_struct(2, blocklens, displs, types, newtype);
+
+        MPI_Type_free(&rem_type);
+        MPI_Type_free(&chunks);
+    }
+    else
+    {
+        *newtype = chunks;
+    }
+    MPI_Type_free(&chunk);
+
+    MPI_Type_commit(newtype);
+    *newcount = 1;
+
+    return 1;
+}
+
+int get_info_flag(MPI_Info info, const char* key)
+{
+    if (info == MPI_INFO_NULL)
+        return 0;
+
+    int flag;
+    char value[16];
+    MPI_Info_get(info, key, 15, value, &flag);
+    if (!flag)
+        return 0;
+
+    return strcmp(value, "true") == 0 || strcmp(value, "1") == 0;
+}
+
+long get_info_long(MPI_Info info, const char* key, long default_value)
+{
+    if (info == MPI_INFO_NULL)
+        return default_value;
+
+    int flag;
+    char value[32];
+    MPI_Info_get(info, key, 31, value, &flag);
+    if (!flag)
+        return default_value;
+
+    return strtol(value, NULL, 10);
+}
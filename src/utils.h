@@ -1,6 +1,8 @@
 #ifndef MPI_ADVANCE_UTILS_H
 #define MPI_ADVANCE_UTILS_H
 
+#include <mpi.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -10,6 +12,19 @@ void sort(int n_objects, int* object_indices, int* object_values);
 void rotate(void* ref, int new_start_byte, int end_byte);
 void reverse(void* recvbuf, int n_bytes, int var_bytes);
 
+// Describe 'count' elements of 'type' with an int count
+// If count exceeds INT_MAX, builds a committed datatype holding all
+// elements (returns 1, caller frees newtype), otherwise returns 0
+// and newtype is type
+int large_count_type(MPI_Count count, MPI_Datatype type,
+        int* newcount, MPI_Datatype* newtype);
+
+// Returns 1 if info holds key set to "true" or "1" (info may be MPI_INFO_NULL)
+int get_info_flag(MPI_Info info, const char* key);
+
+// Returns the integer value of key in info, or default_value if unset
+long get_info_long(MPI_Info info, const char* key, long default_value);
+
 #ifdef __cplusplus
 }
 #endif